@@ -2,11 +2,13 @@
 #define OPTIMAL_IMAGE_H
 
 #include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <stdexcept>
 #include <atomic>
 #include <vector>
+#include <utility>
 
 // 平台检测宏
 #if defined(_MSC_VER) // Windows with MSVC
@@ -21,6 +23,197 @@ namespace mylib
 {
     // 前向声明
     class ImageDataManager;
+    struct YUVImage;
+
+    /**
+     * @brief 图像缩放使用的插值方式
+     */
+    enum class Interpolation
+    {
+        Nearest,  // 最近邻插值
+        Bilinear, // 双线性插值
+        Area,     // 区域平均（适合缩小），放大时等价于双线性插值
+        Bicubic   // 双三次插值
+    };
+
+    /**
+     * @brief 两张图像差值的范数类型
+     */
+    enum class NormType
+    {
+        L1, // 绝对差之和
+        L2, // 差的平方和开方
+        Inf // 最大绝对差
+    };
+
+    /**
+     * @brief 阈值化类型，src > thresh时称为满足条件
+     */
+    enum class ThresholdType
+    {
+        Binary,    // 满足条件取maxValue，否则取0
+        BinaryInv, // 满足条件取0，否则取maxValue
+        Trunc,     // 满足条件取thresh，否则保持不变
+        ToZero,    // 满足条件保持不变，否则取0
+        ToZeroInv  // 满足条件取0，否则保持不变
+    };
+
+    /**
+     * @brief 自适应阈值的局部均值计算方式
+     */
+    enum class AdaptiveMethod
+    {
+        Mean,    // 窗口内均值（基于积分图，与窗口大小无关）
+        Gaussian // 窗口内高斯加权均值
+    };
+
+    /**
+     * @brief 拜耳阵列的排列，以左上角2x2像素的颜色命名
+     */
+    enum class BayerPattern
+    {
+        RGGB, // 第一行R G，第二行G B
+        BGGR, // 第一行B G，第二行G R
+        GRBG, // 第一行G R，第二行B G
+        GBRG  // 第一行G B，第二行R G
+    };
+
+    /**
+     * @brief 去马赛克算法
+     */
+    enum class DemosaicMethod
+    {
+        Bilinear,      // 相邻同色像素的平均
+        MalvarHeCutler // 5x5线性核，用中心通道的梯度校正双线性插值，边缘处伪色更少
+    };
+
+    /**
+     * @brief YUV 4:2:0格式（色度在水平和垂直方向各下采样一半）
+     */
+    enum class YUVFormat
+    {
+        NV12, // Y平面后跟U、V交错的色度平面
+        I420  // Y平面后依次为U平面和V平面
+    };
+
+    /**
+     * @brief 相位相关的结果
+     */
+    struct PhaseCorrelationResult
+    {
+        double shiftX;   // 第二张图像相对第一张图像的水平平移（亚像素精度）
+        double shiftY;   // 第二张图像相对第一张图像的垂直平移（亚像素精度）
+        double response; // 相关峰值，取值[0, 1]，越接近1说明两张图像越吻合
+    };
+
+    /**
+     * @brief 单个通道的最小值、最大值及其位置（按光栅顺序第一次出现的位置）
+     */
+    struct MinMaxLocation
+    {
+        int minValue = 0;
+        int maxValue = 0;
+        int minX = 0;
+        int minY = 0;
+        int maxX = 0;
+        int maxY = 0;
+    };
+
+    /**
+     * @brief 按位打包的二值掩码，每行stride字节，像素x位于第x / 8字节的第x % 8位（低位在前），内存为8位掩码的1/8
+     */
+    struct PackedMask
+    {
+        int width = 0;
+        int height = 0;
+        int stride = 0;
+        std::vector<uint8_t> bits;
+
+        PackedMask() = default;
+
+        PackedMask(int w, int h)
+            : width(w), height(h), stride((w + 7) / 8), bits(static_cast<size_t>((w + 7) / 8) * h, 0)
+        {
+        }
+
+        uint8_t *row(int y) { return bits.data() + static_cast<size_t>(y) * stride; }
+
+        const uint8_t *row(int y) const { return bits.data() + static_cast<size_t>(y) * stride; }
+
+        bool at(int x, int y) const { return (row(y)[x >> 3] >> (x & 7)) & 1; }
+    };
+
+    /**
+     * @brief 像素超出8位范围的结果缓冲区（积分图、梯度、局部统计量等），按行连续存储、通道交错
+     */
+    template <typename T>
+    struct ImageBuffer
+    {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        std::vector<T> data;
+
+        ImageBuffer() = default;
+
+        ImageBuffer(int w, int h, int c)
+            : width(w), height(h), channels(c), data(static_cast<size_t>(w) * h * c)
+        {
+        }
+
+        T *row(int y) { return data.data() + static_cast<size_t>(y) * width * channels; }
+
+        const T *row(int y) const { return data.data() + static_cast<size_t>(y) * width * channels; }
+
+        T &at(int x, int y, int c = 0) { return row(y)[static_cast<size_t>(x) * channels + c]; }
+
+        const T &at(int x, int y, int c = 0) const { return row(y)[static_cast<size_t>(x) * channels + c]; }
+    };
+
+    /**
+     * @brief 预计算的重映射表，可在多帧之间复用（例如固定相机的镜头畸变校正）
+     * 每个目标像素保存源坐标的定点数（5位小数），采样时不再做浮点运算
+     */
+    struct RemapTable
+    {
+        int width = 0;             // 目标图像宽度
+        int height = 0;            // 目标图像高度
+        std::vector<int32_t> mapX; // 源x坐标 × 32，按行存储
+        std::vector<int32_t> mapY; // 源y坐标 × 32，按行存储
+    };
+
+    /**
+     * @brief 连通域的统计信息
+     */
+    struct ComponentStats
+    {
+        long long area = 0;   // 像素数
+        int left = 0;         // 外接矩形左边界
+        int top = 0;          // 外接矩形上边界
+        int width = 0;        // 外接矩形宽度
+        int height = 0;       // 外接矩形高度
+        double centroidX = 0; // 质心x坐标
+        double centroidY = 0; // 质心y坐标
+    };
+
+    /**
+     * @brief 连通域标记的结果
+     */
+    struct ConnectedComponents
+    {
+        int count = 0;                     // 连通域个数（不含背景）
+        ImageBuffer<int32_t> labels;       // 标签图，背景为0，连通域按光栅顺序第一次出现的先后编号为1~count
+        std::vector<ComponentStats> stats; // 按标签索引，长度为count + 1；stats[0]为背景，其外接矩形为整幅图像
+    };
+
+    /**
+     * @brief 哈希索引的查询结果
+     */
+    struct HashMatch
+    {
+        size_t index = 0; // 命中哈希在索引中的下标（加入的顺序）
+        int distance = 0; // 与查询哈希的汉明距离
+    };
 
     /**
      * @brief 一个优化的图像处理类，参考OpenCV的设计理念，支持数据共享和SIMD加速
@@ -188,6 +381,25 @@ namespace mylib
          */
         OptimalImage clone() const;
 
+        /**
+         * @brief 只把掩码选中的像素拷贝到dst，未选中的像素保持dst原值
+         * 按SIMD宽度分段：掩码全为0的段跳过，全选中的段直接拷贝，其余段用blendv逐字节选择
+         * @param dst 目标图像；为空时创建同尺寸、全0的图像，否则尺寸和通道数必须与本图像一致
+         * @param mask 8位单通道掩码，非0表示选中，尺寸必须与本图像一致
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果掩码或dst的尺寸、通道数不符
+         */
+        void copyTo(OptimalImage &dst, const OptimalImage &mask) const;
+
+        /**
+         * @brief 只把按位打包的掩码选中的像素拷贝到dst，其余同8位掩码版本
+         * @param dst 目标图像；为空时创建同尺寸、全0的图像，否则尺寸和通道数必须与本图像一致
+         * @param mask 按位打包的掩码，尺寸必须与本图像一致
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果掩码或dst的尺寸、通道数不符
+         */
+        void copyTo(OptimalImage &dst, const PackedMask &mask) const;
+
         /**
          * @brief 确保数据独占访问权，如果数据被多个图像共享，则创建数据副本
          * 当需要修改图像数据时，应先调用此方法以避免影响其他引用相同数据的图像
@@ -207,6 +419,24 @@ namespace mylib
          */
         void adjustBrightness(int delta);
 
+        /**
+         * @brief 只在掩码选中的像素上调整亮度，掩码全为0的段不读写图像数据
+         * @param delta 亮度增量，取值范围[-255, 255]
+         * @param mask 8位单通道掩码，非0表示选中，尺寸必须与本图像一致
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果参数无效或掩码尺寸不符
+         */
+        void adjustBrightness(int delta, const OptimalImage &mask);
+
+        /**
+         * @brief 只在按位打包的掩码选中的像素上调整亮度
+         * @param delta 亮度增量，取值范围[-255, 255]
+         * @param mask 按位打包的掩码，尺寸必须与本图像一致
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果参数无效或掩码尺寸不符
+         */
+        void adjustBrightness(int delta, const PackedMask &mask);
+
         /**
          * @brief 静态方法：将两张图像混合，SIMD和OpenMP优化版
          * @param img1 第一张图像
@@ -217,6 +447,69 @@ namespace mylib
          */
         static OptimalImage blend(const OptimalImage &img1, const OptimalImage &img2, float alpha);
 
+        /**
+         * @brief 静态方法：只在掩码选中的像素上混合两张图像，未选中的像素取img1
+         * 混合与选择在同一趟中完成，权重量化为8位定点数：round((img1 × w + img2 × (256 - w)) / 256)，w = round(alpha × 256)
+         * @param img1 第一张图像
+         * @param img2 第二张图像
+         * @param alpha img1的权重，取值范围[0, 1]
+         * @param mask 8位单通道掩码，非0表示选中，尺寸必须与图像一致
+         * @return 混合后的新图像
+         * @throw mylib::InvalidArgumentException 如果参数无效、两张图像不一致或掩码尺寸不符
+         */
+        static OptimalImage blend(const OptimalImage &img1, const OptimalImage &img2, float alpha, const OptimalImage &mask);
+
+        /**
+         * @brief 静态方法：只在按位打包的掩码选中的像素上混合两张图像，其余同8位掩码版本
+         * @param img1 第一张图像
+         * @param img2 第二张图像
+         * @param alpha img1的权重，取值范围[0, 1]
+         * @param mask 按位打包的掩码，尺寸必须与图像一致
+         * @return 混合后的新图像
+         * @throw mylib::InvalidArgumentException 如果参数无效、两张图像不一致或掩码尺寸不符
+         */
+        static OptimalImage blend(const OptimalImage &img1, const OptimalImage &img2, float alpha, const PackedMask &mask);
+
+        /**
+         * @brief 静态方法：按逐像素alpha把四通道图像src叠加到dst上（Porter-Duff "over"），原地修改dst
+         * 定点SIMD实现，除以255使用乘高位技巧并正确舍入；src的alpha全为0或全为255的连续像素直接跳过或复制
+         * @param dst 目标RGBA图像，会被修改
+         * @param src 叠加的RGBA图像，可以小于dst，超出dst的部分被裁剪
+         * @param premultiplied 为true时两张图像都是预乘alpha格式，否则为直通（非预乘）alpha
+         * @param offsetX src左上角在dst中的x坐标
+         * @param offsetY src左上角在dst中的y坐标
+         * @throw mylib::InvalidArgumentException 如果图像为空或不是四通道
+         */
+        static void compositeOver(OptimalImage &dst, const OptimalImage &src, bool premultiplied = false,
+                                  int offsetX = 0, int offsetY = 0);
+
+        /**
+         * @brief 静态方法：N张图像按权重一次性混合，result = Σ weights[i] × images[i]
+         * 所有输入在同一趟SIMD循环中读取，权重转为16位定点数，每两张图像用一次madd累加到32位累加器
+         * @param images 输入图像，尺寸和通道数必须一致
+         * @param weights 每张图像的权重，个数与images相同，可以为负数，结果饱和到[0, 255]
+         * @return 混合后的新图像
+         * @throw mylib::InvalidArgumentException 如果输入为空、个数不一致、尺寸不一致或权重过大
+         */
+        static OptimalImage blendMany(const std::vector<OptimalImage> &images, const std::vector<float> &weights);
+
+        /**
+         * @brief 静态方法：滑动加权累加，accumulator = (1 - alpha) × accumulator + alpha × src，32位浮点累加器
+         * @param src 新的一帧
+         * @param accumulator 累加器；为空时用src初始化，否则尺寸和通道数必须与src一致
+         * @param alpha 新帧的权重，取值范围[0, 1]
+         * @throw mylib::InvalidArgumentException 如果参数无效
+         */
+        static void accumulateWeighted(const OptimalImage &src, ImageBuffer<float> &accumulator, float alpha);
+
+        /**
+         * @brief 静态方法：把浮点缓冲区（例如累加器、局部均值）四舍五入并饱和转换为8位图像
+         * @param buffer 浮点缓冲区
+         * @return 尺寸和通道数相同的新图像
+         * @throw mylib::InvalidArgumentException 如果缓冲区为空
+         */
+        static OptimalImage fromBuffer(const ImageBuffer<float> &buffer);
+
         /**
          * @brief 高斯模糊，使用SIMD和OpenMP优化
          * @param kernelSize 卷积核大小（必须是奇数，如3、5、7等）
@@ -226,6 +519,679 @@ namespace mylib
          */
         OptimalImage gaussianBlur(int kernelSize, double sigma) const;
 
+        /**
+         * @brief 只在掩码选中的像素上做高斯模糊，其余像素保持原值
+         * 只计算掩码外接矩形（及核半径范围内）的模糊结果，没有选中像素的行不做垂直滤波，结果与先整体模糊再按掩码合成相同
+         * @param kernelSize 卷积核大小（必须是奇数）
+         * @param sigma 高斯函数的标准差
+         * @param mask 8位单通道掩码，非0表示选中，尺寸必须与本图像一致
+         * @return 新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果参数无效或掩码尺寸不符
+         */
+        OptimalImage gaussianBlur(int kernelSize, double sigma, const OptimalImage &mask) const;
+
+        /**
+         * @brief 只在按位打包的掩码选中的像素上做高斯模糊，其余同8位掩码版本
+         * @param kernelSize 卷积核大小（必须是奇数）
+         * @param sigma 高斯函数的标准差
+         * @param mask 按位打包的掩码，尺寸必须与本图像一致
+         * @return 新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果参数无效或掩码尺寸不符
+         */
+        OptimalImage gaussianBlur(int kernelSize, double sigma, const PackedMask &mask) const;
+
+        /**
+         * @brief 缩放图像，可分离实现（预计算每列的系数表和偏移表），定点SIMD和OpenMP优化
+         * @param newWidth 目标宽度
+         * @param newHeight 目标高度
+         * @param interpolation 插值方式，默认为双线性插值
+         * @return 缩放后的新图像
+         * @throw mylib::InvalidArgumentException 如果目标尺寸无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage resize(int newWidth, int newHeight, Interpolation interpolation = Interpolation::Bilinear) const;
+
+        /**
+         * @brief 高斯金字塔下采样：5抽头二项式滤波[1 4 6 4 1]/16与2倍抽取融合为一次逐行SIMD扫描
+         * 只计算保留下来的像素，输出尺寸为((width+1)/2, (height+1)/2)，边界采用复制边缘像素
+         * @return 下采样后的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage pyrDown() const;
+
+        /**
+         * @brief 高斯金字塔上采样：插零上采样与二项式滤波融合，按偶数/奇数输出位置分别计算
+         * @param dstWidth 目标宽度，0表示2倍宽度，否则必须满足|dstWidth - 2*width| <= 1
+         * @param dstHeight 目标高度，0表示2倍高度，否则必须满足|dstHeight - 2*height| <= 1
+         * @return 上采样后的新图像
+         * @throw mylib::InvalidArgumentException 如果目标尺寸无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage pyrUp(int dstWidth = 0, int dstHeight = 0) const;
+
+        /**
+         * @brief 构建高斯金字塔
+         * @param levels 下采样的层数
+         * @return 共levels+1层，第0层与原图共享数据，第i层为第i-1层pyrDown的结果
+         * @throw mylib::InvalidArgumentException 如果层数为负
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        std::vector<OptimalImage> buildPyramid(int levels) const;
+
+        /**
+         * @brief 静态方法：多频段（拉普拉斯金字塔）融合，低频在大范围内平滑过渡，高频只在接缝附近过渡，用于无缝拼接
+         * 每层的拉普拉斯差分、按掩码金字塔混合与逐层重建融合为一次逐行SIMD扫描，不分配有符号的拉普拉斯层缓冲区；
+         * 各层上采样的高斯层互不依赖，较小的层在层间并行计算；上采样与重建缓冲区按最细层大小一次分配、各层复用
+         * @param img1 第一张图像
+         * @param img2 第二张图像，尺寸和通道数必须与img1一致
+         * @param mask 8位单通道掩码，表示img2的权重（0取img1，255取img2），尺寸必须与图像一致
+         * @param levels 金字塔下采样的层数，0表示直接按掩码逐像素混合
+         * @return 融合后的新图像（各层重建结果饱和到[0, 255]）
+         * @throw mylib::InvalidArgumentException 如果图像为空、尺寸或通道数不一致、掩码无效或层数为负
+         */
+        static OptimalImage blendMultiBand(const OptimalImage &img1, const OptimalImage &img2, const OptimalImage &mask, int levels);
+
+        /**
+         * @brief 任意二维卷积（相关运算，锚点为核中心，边界复制边缘像素），SIMD和OpenMP优化
+         * 3x3、5x5、7x7使用模板特化的全展开路径，其他尺寸使用通用路径；
+         * 秩为1的可分离核会被自动识别并转为sepFilter2D计算
+         * @param kernel 卷积核系数，按行优先存储，大小必须为kernelWidth * kernelHeight
+         * @param kernelWidth 卷积核宽度（正奇数）
+         * @param kernelHeight 卷积核高度（正奇数）
+         * @param delta 加到每个结果上的偏移量（例如浮雕效果常用128）
+         * @return 滤波后的新图像（结果四舍五入并饱和到[0, 255]）
+         * @throw mylib::InvalidArgumentException 如果卷积核参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage filter2D(const std::vector<float> &kernel, int kernelWidth, int kernelHeight, float delta = 0.0f) const;
+
+        /**
+         * @brief 可分离卷积：先用rowKernel做水平滤波，再用columnKernel做垂直滤波
+         * @param rowKernel 水平方向卷积核（长度为正奇数）
+         * @param columnKernel 垂直方向卷积核（长度为正奇数）
+         * @param delta 加到每个结果上的偏移量
+         * @return 滤波后的新图像（结果四舍五入并饱和到[0, 255]）
+         * @throw mylib::InvalidArgumentException 如果卷积核参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage sepFilter2D(const std::vector<float> &rowKernel, const std::vector<float> &columnKernel, float delta = 0.0f) const;
+
+        /**
+         * @brief USM锐化：out = src + amount × (src - blur)，只在|src - blur| > threshold处锐化
+         * 高斯模糊的水平结果放在行环形缓存中，垂直方向与锐化运算、阈值判断在同一趟SIMD循环中完成，模糊图像不单独生成
+         * @param sigma 高斯模糊的标准差，核半径为ceil(3 × sigma)
+         * @param amount 锐化强度，0表示不变
+         * @param threshold 阈值（8位灰度），取值范围[0, 255]，用于避免放大平坦区域的噪声
+         * @return 锐化后的新图像
+         * @throw mylib::InvalidArgumentException 如果参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage unsharpMask(double sigma, float amount = 1.0f, int threshold = 0) const;
+
+        /**
+         * @brief 基于FFT的卷积，结果与filter2D一致（边界复制边缘像素），适合非常大的卷积核
+         * 内部使用实数到复数的二维FFT（混合基数Stockham算法，旋转因子按长度缓存），行列变换均多线程执行
+         * @param kernel 卷积核系数，按行优先存储，大小必须为kernelWidth * kernelHeight
+         * @param kernelWidth 卷积核宽度（正奇数）
+         * @param kernelHeight 卷积核高度（正奇数）
+         * @param delta 加到每个结果上的偏移量
+         * @return 滤波后的新图像
+         * @throw mylib::InvalidArgumentException 如果卷积核参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage fftConvolve(const std::vector<float> &kernel, int kernelWidth, int kernelHeight, float delta = 0.0f) const;
+
+        /**
+         * @brief 频域高斯模糊：在频域乘以高斯传递函数，计算量与sigma无关
+         * @param sigma 高斯函数的标准差
+         * @return 模糊后的新图像
+         * @throw mylib::InvalidArgumentException 如果sigma不是正数
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage fftGaussianBlur(double sigma) const;
+
+        /**
+         * @brief 相位相关：估计img2相对img1的平移量，即img2(x, y) ≈ img1(x - shiftX, y - shiftY)
+         * 多通道图像先取各颜色通道的平均值，计算前会乘以Hanning窗以抑制边界效应
+         * @param img1 参考图像
+         * @param img2 平移后的图像，尺寸必须与img1相同
+         * @return 平移量与相关峰值
+         * @throw mylib::InvalidArgumentException 如果图像为空或尺寸不一致
+         */
+        static PhaseCorrelationResult phaseCorrelate(const OptimalImage &img1, const OptimalImage &img2);
+
+        /**
+         * @brief 获取不小于size的、FFT计算效率最高的长度（只含因子2、3、5）
+         * @param size 最小长度
+         * @return 最优长度
+         * @throw mylib::InvalidArgumentException 如果size不是正数
+         */
+        static int getOptimalDFTSize(int size);
+
+        /**
+         * @brief 中值滤波，使用常数时间的滑动直方图算法（Perreault-Hébert），每像素开销与半径无关
+         * 维护每列的直方图和粗/细两级核直方图，直方图加减使用SIMD，按水平条带并行，边界复制边缘像素
+         * @param radius 窗口半径，窗口大小为(2 * radius + 1)²，取值范围[0, 127]
+         * @return 滤波后的新图像
+         * @throw mylib::InvalidArgumentException 如果半径超出范围
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage medianBlur(int radius) const;
+
+        /**
+         * @brief 双边滤波，采用可分离近似：先垂直一维双边滤波，转置后再做一次，最后转置回来
+         * 颜色权重由前三个通道的绝对差之和查表得到（AVX2下用gather），四通道图像的alpha通道使用相同权重平滑，边界复制
+         * @param diameter 邻域直径，小于等于0时由sigmaSpace推算（半径取1.5 × sigmaSpace）
+         * @param sigmaColor 颜色空间的标准差，越大越多不同颜色被混合
+         * @param sigmaSpace 坐标空间的标准差
+         * @return 滤波后的新图像
+         * @throw mylib::InvalidArgumentException 如果sigma不是正数
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage bilateralFilter(int diameter, double sigmaColor, double sigmaSpace) const;
+
+        /**
+         * @brief 引导滤波（He et al.），均值、相关和系数平滑都用滑动窗口和计算，每像素开销与半径无关
+         * 第一阶段的窗口和由8位数据精确整数累加，按水平条带并行，边界复制
+         * @param guide 引导图像，尺寸与当前图像相同，通道数为1（所有通道共用）或与当前图像相同（逐通道引导）；传入自身即为保边平滑
+         * @param radius 窗口半径，窗口大小为(2 * radius + 1)²，取值范围[1, 16383]
+         * @param eps 正则化参数，以8位灰度的平方为单位，例如(0.1 × 255)²，越大越接近均值滤波
+         * @return 滤波后的新图像
+         * @throw mylib::InvalidArgumentException 如果引导图像或参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage guidedFilter(const OptimalImage &guide, int radius, double eps) const;
+
+        /**
+         * @brief 矩形结构元素腐蚀（窗口内取最小值），van Herk/Gil-Werman算法，每像素开销与结构元素大小无关
+         * 垂直方向逐行用SIMD同时处理整行，水平方向通过分块转置变为连续访问；窗口超出图像的部分不参与计算
+         * @param kernelWidth 结构元素宽度（正整数），锚点为kernelWidth / 2
+         * @param kernelHeight 结构元素高度（正整数），锚点为kernelHeight / 2
+         * @return 腐蚀后的新图像
+         * @throw mylib::InvalidArgumentException 如果结构元素尺寸无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage erode(int kernelWidth, int kernelHeight) const;
+
+        /**
+         * @brief 矩形结构元素膨胀（窗口内取最大值），实现方式同erode
+         * @param kernelWidth 结构元素宽度（正整数）
+         * @param kernelHeight 结构元素高度（正整数）
+         * @return 膨胀后的新图像
+         * @throw mylib::InvalidArgumentException 如果结构元素尺寸无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage dilate(int kernelWidth, int kernelHeight) const;
+
+        /**
+         * @brief 形态学开运算：先腐蚀再膨胀，去除小的亮噪点
+         * @param kernelWidth 结构元素宽度（正整数）
+         * @param kernelHeight 结构元素高度（正整数）
+         * @return 处理后的新图像
+         * @throw mylib::InvalidArgumentException 如果结构元素尺寸无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage morphOpen(int kernelWidth, int kernelHeight) const;
+
+        /**
+         * @brief 形态学闭运算：先膨胀再腐蚀，填充小的暗空洞
+         * @param kernelWidth 结构元素宽度（正整数）
+         * @param kernelHeight 结构元素高度（正整数）
+         * @return 处理后的新图像
+         * @throw mylib::InvalidArgumentException 如果结构元素尺寸无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage morphClose(int kernelWidth, int kernelHeight) const;
+
+        /**
+         * @brief 形态学梯度：膨胀结果减去腐蚀结果，突出物体边缘
+         * @param kernelWidth 结构元素宽度（正整数）
+         * @param kernelHeight 结构元素高度（正整数）
+         * @return 处理后的新图像
+         * @throw mylib::InvalidArgumentException 如果结构元素尺寸无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage morphGradient(int kernelWidth, int kernelHeight) const;
+
+        /**
+         * @brief 计算一个通道的灰度直方图，每个线程使用私有直方图（内部再拆成4个子直方图避免存储转发停顿），最后用SIMD合并
+         * @param channel 通道索引
+         * @return 256个桶的像素计数
+         * @throw mylib::OutOfRangeException 如果通道索引超出范围
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        std::vector<size_t> calcHist(int channel = 0) const;
+
+        /**
+         * @brief 直方图均衡化，多通道图像的每个通道分别均衡化
+         * @return 均衡化后的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage equalizeHist() const;
+
+        /**
+         * @brief 限制对比度的自适应直方图均衡化（CLAHE），每个通道分别处理
+         * 每个分块的直方图截断后生成查找表，像素值由相邻4个分块的查找表经SIMD gather与双线性插值得到
+         * @param clipLimit 截断阈值，相对于分块平均每个桶的像素数（例如2.0、4.0）
+         * @param tilesX 水平方向的分块数
+         * @param tilesY 垂直方向的分块数
+         * @return 处理后的新图像
+         * @throw mylib::InvalidArgumentException 如果参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage clahe(double clipLimit = 4.0, int tilesX = 8, int tilesY = 8) const;
+
+        /**
+         * @brief 固定阈值化，每个通道独立处理，SIMD比较后按类型与maxValue或原值做掩码运算
+         * @param thresh 阈值，src > thresh为满足条件
+         * @param maxValue Binary/BinaryInv的输出值，取值范围[0, 255]
+         * @param type 阈值化类型
+         * @return 阈值化后的新图像
+         * @throw mylib::InvalidArgumentException 如果maxValue超出范围
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage threshold(int thresh, int maxValue = 255, ThresholdType type = ThresholdType::Binary) const;
+
+        /**
+         * @brief 固定阈值化并输出按位打包的掩码，位为1表示src > thresh（invert为true时相反）
+         * @param thresh 阈值
+         * @param invert 是否取反
+         * @return 打包的掩码
+         * @throw mylib::InvalidArgumentException 如果图像不是单通道
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        PackedMask thresholdPacked(int thresh, bool invert = false) const;
+
+        /**
+         * @brief 用Otsu方法（最大类间方差）由直方图计算全局阈值，可直接传给threshold
+         * @return 阈值，前景为src > 阈值的像素
+         * @throw mylib::InvalidArgumentException 如果图像不是单通道
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        int otsuThreshold() const;
+
+        /**
+         * @brief 自适应阈值化：与窗口内的局部均值比较，Binary时src > mean - C取maxValue
+         * 均值窗口用积分图盒式滤波（与窗口大小无关）或可分离高斯滤波计算，边界复制
+         * @param maxValue 满足条件时的输出值，取值范围[0, 255]
+         * @param method 局部均值的计算方式
+         * @param type 只支持Binary和BinaryInv
+         * @param blockSize 窗口尺寸，必须为大于1的奇数
+         * @param C 从局部均值中减去的常数
+         * @return 阈值化后的新图像
+         * @throw mylib::InvalidArgumentException 如果图像不是单通道或参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage adaptiveThreshold(int maxValue, AdaptiveMethod method, ThresholdType type, int blockSize, double C) const;
+
+        /**
+         * @brief 自适应阈值化并输出按位打包的掩码，位为1表示满足Binary条件（invert为true时相反）
+         * @param method 局部均值的计算方式
+         * @param blockSize 窗口尺寸，必须为大于1的奇数
+         * @param C 从局部均值中减去的常数
+         * @param invert 是否取反
+         * @return 打包的掩码
+         * @throw mylib::InvalidArgumentException 如果图像不是单通道或参数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        PackedMask adaptiveThresholdPacked(AdaptiveMethod method, int blockSize, double C, bool invert = false) const;
+
+        /**
+         * @brief 二值图像（非0为前景）的连通域标记，同时统计面积、外接矩形和质心
+         * 基于行程的两遍扫描：按水平条带并行提取行程并用并查集合并等价标签，再合并条带交界处的等价关系，
+         * 最后并行写出标签图
+         * @param connectivity 连通性，4或8
+         * @return 标签图和每个连通域的统计信息
+         * @throw mylib::InvalidArgumentException 如果图像不是单通道或连通性无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        ConnectedComponents connectedComponents(int connectivity = 8) const;
+
+        /**
+         * @brief 计算积分图（summed-area table）：先逐行SIMD前缀和，再按列块多线程向下累加
+         * 结果尺寸为(width + 1) × (height + 1)，第0行和第0列为0，
+         * sum(x, y) = 源图像[0, x) × [0, y)区域内对应通道的像素和
+         * 32位结果在整幅图像的和超过2^32时会回绕，但只要窗口内的和不超过2^32，用四个角相减得到的窗口和仍然正确
+         * @return 32位积分图
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        ImageBuffer<uint32_t> integral() const;
+
+        /**
+         * @brief 计算64位积分图，适用于需要整幅图像精确累计和的场景
+         * @return 64位积分图，布局与integral()相同
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        ImageBuffer<uint64_t> integral64() const;
+
+        /**
+         * @brief 计算像素平方的积分图，与integral()配合可在O(1)时间内得到任意窗口的方差
+         * @return 64位平方积分图，布局与integral()相同
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        ImageBuffer<uint64_t> integralSquared() const;
+
+        /**
+         * @brief 均值滤波（盒式滤波），基于积分图，每个像素的开销与窗口大小无关，边界使用复制填充
+         * @param kernelWidth 窗口宽度
+         * @param kernelHeight 窗口高度
+         * @return 滤波后的新图像
+         * @throw mylib::InvalidArgumentException 如果窗口尺寸不是正数
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage boxFilter(int kernelWidth, int kernelHeight) const;
+
+        /**
+         * @brief 基于积分图计算每个像素邻域窗口内的均值和方差，每个像素O(1)，边界使用复制填充
+         * @param windowWidth 窗口宽度
+         * @param windowHeight 窗口高度
+         * @param mean 输出的局部均值，尺寸与图像相同
+         * @param variance 输出的局部方差，尺寸与图像相同
+         * @throw mylib::InvalidArgumentException 如果窗口尺寸不是正数
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        void localMeanVariance(int windowWidth, int windowHeight, ImageBuffer<float> &mean, ImageBuffer<float> &variance) const;
+
+        /**
+         * @brief 3x3 Sobel导数，16位SIMD可分离计算（先垂直后水平），边界使用复制填充
+         * @param dx x方向导数阶数（0或1）
+         * @param dy y方向导数阶数（0或1）
+         * @return 16位有符号导数，尺寸和通道数与图像相同
+         * @throw mylib::InvalidArgumentException 如果导数阶数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        ImageBuffer<int16_t> sobel(int dx, int dy) const;
+
+        /**
+         * @brief 3x3 Scharr导数，旋转对称性比Sobel更好，计算方式与sobel()相同
+         * @param dx x方向导数阶数（0或1）
+         * @param dy y方向导数阶数（0或1），dx + dy必须为1
+         * @return 16位有符号导数，尺寸和通道数与图像相同
+         * @throw mylib::InvalidArgumentException 如果导数阶数无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        ImageBuffer<int16_t> scharr(int dx, int dy) const;
+
+        /**
+         * @brief Canny边缘检测
+         * 按行流式计算Sobel梯度、幅值与方向并立即做非极大值抑制，各条带并行；
+         * 滞后阈值先在各条带内并行做队列扩展，再从条带边界继续扩展。多通道图像取梯度幅值最大的通道
+         * @param lowThreshold 低阈值
+         * @param highThreshold 高阈值
+         * @param L2gradient 为true时使用sqrt(gx^2 + gy^2)作为幅值，否则使用|gx| + |gy|
+         * @return 单通道边缘图，边缘为255，其余为0
+         * @throw mylib::InvalidArgumentException 如果阈值为负数
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage canny(double lowThreshold, double highThreshold, bool L2gradient = false) const;
+
+        /**
+         * @brief 转置图像：dst(x, y) = src(y, x)，按块并行，块内使用寄存器内转置（单通道16x16字节，三/四通道4x4像素）
+         * @return 宽高互换的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage transpose() const;
+
+        /**
+         * @brief 顺时针旋转90度，与转置共用分块SIMD实现
+         * @return 宽高互换的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage rotate90() const;
+
+        /**
+         * @brief 旋转180度
+         * @return 旋转后的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage rotate180() const;
+
+        /**
+         * @brief 顺时针旋转270度（逆时针旋转90度），与转置共用分块SIMD实现
+         * @return 宽高互换的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage rotate270() const;
+
+        /**
+         * @brief 水平翻转（左右镜像）
+         * @return 翻转后的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage flipH() const;
+
+        /**
+         * @brief 垂直翻转（上下镜像）
+         * @return 翻转后的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage flipV() const;
+
+        /**
+         * @brief 把交错存储的多通道图像拆成单通道平面，三/四通道用pshufb在寄存器内重排
+         * @return 每个通道一张单通道图像，顺序与通道顺序相同
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        std::vector<OptimalImage> split() const;
+
+        /**
+         * @brief 静态方法：把1~4张单通道平面交错合并为多通道图像，split的逆操作
+         * @param planes 单通道平面，尺寸必须相同
+         * @return 通道数等于平面数的新图像
+         * @throw mylib::InvalidArgumentException 如果平面数不在[1, 4]内、平面不是单通道或尺寸不一致
+         */
+        static OptimalImage merge(const std::vector<OptimalImage> &planes);
+
+        /**
+         * @brief 交换第0和第2通道（RGB <-> BGR，RGBA <-> BGRA），用于与按BGR存储的BMP代码或外部库交换数据
+         * @return 交换通道后的新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果图像不是三/四通道
+         */
+        OptimalImage swapRB() const;
+
+        /**
+         * @brief 三通道图像追加一个常数alpha通道
+         * @param alpha 填入的alpha值
+         * @return 四通道新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果图像不是三通道
+         */
+        OptimalImage addAlpha(unsigned char alpha = 255) const;
+
+        /**
+         * @brief 去掉四通道图像的alpha通道（不做预乘或合成）
+         * @return 三通道新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果图像不是四通道
+         */
+        OptimalImage dropAlpha() const;
+
+        /**
+         * @brief 均值哈希：缩小到8x8灰度后与均值比较
+         * @return 64位哈希，第(y * 8 + x)位（从最低位开始）表示该像素是否大于均值
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        uint64_t averageHash() const;
+
+        /**
+         * @brief 差值哈希：缩小到9x8灰度后比较每行相邻像素
+         * @return 64位哈希，第(y * 8 + x)位表示第x个像素是否比右侧像素亮
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        uint64_t dHash() const;
+
+        /**
+         * @brief 感知哈希：缩小到32x32灰度后做二维DCT，取左上角8x8低频系数与其中值比较
+         * @return 64位哈希，第(v * 8 + u)位表示频率(u, v)的系数是否大于中值
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        uint64_t pHash() const;
+
+        /**
+         * @brief 静态方法：两个64位哈希的汉明距离
+         * @param a 第一个哈希
+         * @param b 第二个哈希
+         * @return 不同的位数，取值[0, 64]
+         */
+        static int hammingDistance(uint64_t a, uint64_t b);
+
+        /**
+         * @brief Floyd-Steinberg误差扩散抖动，把每个像素量化为调色板中最近的颜色（欧氏距离）
+         * 按波前调度并行：每行只比上一行落后一小段，结果与串行逐行扫描完全相同；调色板查找使用SIMD
+         * @param palette 调色板，按颜色连续存放，每个颜色channels()个字节
+         * @return 只含调色板颜色的新图像，通道数不变
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果调色板为空或长度不是通道数的整数倍
+         */
+        OptimalImage ditherErrorDiffusion(const std::vector<unsigned char> &palette) const;
+
+        /**
+         * @brief 去马赛克：把单通道拜耳原始数据插值为RGB图像，按行流式计算并直接写出交错像素，按条带并行
+         * 边界按不重复边界像素的镜像扩展，保持拜耳阵列的奇偶性
+         * @param pattern 拜耳阵列的排列
+         * @param method 插值算法
+         * @return 三通道（RGB）新图像
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果图像不是单通道或小于2x2
+         */
+        OptimalImage demosaic(BayerPattern pattern, DemosaicMethod method = DemosaicMethod::Bilinear) const;
+
+        /**
+         * @brief 转为YUV 4:2:0图像（BT.601有限范围），每个色度样本取2x2像素的平均，按行对并行、SIMD计算
+         * @param format 色度平面的存储格式
+         * @return YUV图像，色度尺寸为((width + 1) / 2) × ((height + 1) / 2)
+         * @throw mylib::OperationFailedException 如果图像为空
+         * @throw mylib::InvalidArgumentException 如果图像不是三/四通道（RGB/RGBA，alpha被忽略）
+         */
+        YUVImage toYUV420(YUVFormat format) const;
+
+        /**
+         * @brief 静态方法：YUV 4:2:0图像转为RGB，色度上采样（每个样本复制到2x2像素）与颜色变换在同一遍中完成
+         * @param yuv YUV图像
+         * @return 三通道（RGB）新图像
+         * @throw mylib::InvalidArgumentException 如果YUV图像为空或平面尺寸与格式不符
+         */
+        static OptimalImage fromYUV420(const YUVImage &yuv);
+
+        /**
+         * @brief 仿射变换，源坐标用定点数按列增量计算，输出按块并行处理，超出源图像的区域填0
+         * @param matrix 2x3变换矩阵（行优先，6个元素），将源坐标映射到目标坐标
+         * @param dstWidth 目标图像宽度
+         * @param dstHeight 目标图像高度
+         * @param interpolation 插值方式，只支持Nearest和Bilinear
+         * @return 变换后的新图像
+         * @throw mylib::InvalidArgumentException 如果矩阵不可逆、尺寸或插值方式无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage warpAffine(const std::vector<double> &matrix, int dstWidth, int dstHeight,
+                                Interpolation interpolation = Interpolation::Bilinear) const;
+
+        /**
+         * @brief 透视变换，输出按块并行处理，超出源图像的区域填0
+         * @param matrix 3x3变换矩阵（行优先，9个元素），将源坐标映射到目标坐标
+         * @param dstWidth 目标图像宽度
+         * @param dstHeight 目标图像高度
+         * @param interpolation 插值方式，只支持Nearest和Bilinear
+         * @return 变换后的新图像
+         * @throw mylib::InvalidArgumentException 如果矩阵不可逆、尺寸或插值方式无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage warpPerspective(const std::vector<double> &matrix, int dstWidth, int dstHeight,
+                                     Interpolation interpolation = Interpolation::Bilinear) const;
+
+        /**
+         * @brief 由浮点映射构建定点重映射表，dst(x, y) = src(mapX(x, y), mapY(x, y))
+         * @param mapX 每个目标像素的源x坐标，单通道
+         * @param mapY 每个目标像素的源y坐标，单通道，尺寸与mapX相同
+         * @return 可复用的重映射表
+         * @throw mylib::InvalidArgumentException 如果映射为空、尺寸不一致或不是单通道
+         */
+        static RemapTable buildRemapTable(const ImageBuffer<float> &mapX, const ImageBuffer<float> &mapY);
+
+        /**
+         * @brief 按预计算的重映射表采样，AVX2下单通道和四通道使用gather，超出源图像的区域填0
+         * @param table 重映射表
+         * @param interpolation 插值方式，只支持Nearest和Bilinear
+         * @return 尺寸为table.width × table.height的新图像
+         * @throw mylib::InvalidArgumentException 如果重映射表无效或插值方式不支持
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage remap(const RemapTable &table, Interpolation interpolation = Interpolation::Bilinear) const;
+
+        /**
+         * @brief 按浮点映射采样，等价于remap(buildRemapTable(mapX, mapY), interpolation)；需要逐帧复用时应预先构建重映射表
+         * @param mapX 每个目标像素的源x坐标
+         * @param mapY 每个目标像素的源y坐标
+         * @param interpolation 插值方式，只支持Nearest和Bilinear
+         * @return 与映射尺寸相同的新图像
+         * @throw mylib::InvalidArgumentException 如果映射或插值方式无效
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        OptimalImage remap(const ImageBuffer<float> &mapX, const ImageBuffer<float> &mapY,
+                           Interpolation interpolation = Interpolation::Bilinear) const;
+
+        /**
+         * @brief 计算每个通道的像素和，按行条带并行，SIMD下用sad指令累加
+         * @return 长度为通道数的像素和
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        std::vector<double> sum() const;
+
+        /**
+         * @brief 计算每个通道的均值
+         * @return 长度为通道数的均值
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        std::vector<double> mean() const;
+
+        /**
+         * @brief 一次遍历同时计算每个通道的均值和（总体）标准差，和与平方和均用整数精确累加
+         * @param mean 输出的均值，长度为通道数
+         * @param stddev 输出的标准差，长度为通道数
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        void meanStdDev(std::vector<double> &mean, std::vector<double> &stddev) const;
+
+        /**
+         * @brief 一次遍历计算每个通道的最小值、最大值及其位置
+         * @return 长度为通道数的结果
+         * @throw mylib::OperationFailedException 如果图像为空
+         */
+        std::vector<MinMaxLocation> minMaxLoc() const;
+
+        /**
+         * @brief 静态方法：计算两张图像差值的范数（所有通道合计）
+         * @param a 第一张图像
+         * @param b 第二张图像，尺寸和通道数与a相同
+         * @param type 范数类型
+         * @return 范数
+         * @throw mylib::InvalidArgumentException 如果图像为空或尺寸、通道数不一致
+         */
+        static double norm(const OptimalImage &a, const OptimalImage &b, NormType type = NormType::L2);
+
+        /**
+         * @brief 静态方法：峰值信噪比，10 × log10(255² / MSE)
+         * @param a 第一张图像
+         * @param b 第二张图像，尺寸和通道数与a相同
+         * @return PSNR（dB），两张图像完全相同时返回正无穷
+         * @throw mylib::InvalidArgumentException 如果图像为空或尺寸、通道数不一致
+         */
+        static double psnr(const OptimalImage &a, const OptimalImage &b);
+
+        /**
+         * @brief 静态方法：结构相似度，窗口内的均值、方差和协方差用可分离窗口流式计算，边界复制
+         * @param a 第一张图像
+         * @param b 第二张图像，尺寸和通道数与a相同
+         * @param windowSize 窗口尺寸，必须为正奇数
+         * @param gaussian 为true时使用sigma = 1.5的高斯窗口，否则使用均值窗口
+         * @return 所有像素和通道上SSIM的平均值，取值[-1, 1]
+         * @throw mylib::InvalidArgumentException 如果图像为空、尺寸或通道数不一致、窗口尺寸无效
+         */
+        static double ssim(const OptimalImage &a, const OptimalImage &b, int windowSize = 11, bool gaussian = true);
+
         /**
          * @brief 检测CPU支持的SIMD指令集
          * @return 支持的SIMD指令集名称字符串
@@ -249,6 +1215,64 @@ namespace mylib
         void checkRange(int row, int col, int channel) const;
     };
 
+    /**
+     * @brief YUV 4:2:0图像，各平面都是OptimalImage，可以直接在亮度平面上调用任意单通道操作
+     * 拷贝时各平面共享数据（写时复制），只处理亮度平面的操作不会复制色度数据
+     */
+    struct YUVImage
+    {
+        YUVFormat format = YUVFormat::NV12; // 色度平面的存储格式
+        OptimalImage y;                     // 亮度平面，width × height单通道
+        OptimalImage u;                     // NV12为U、V交错的双通道平面，I420为U平面
+        OptimalImage v;                     // I420为V平面，NV12时为空
+
+        /**
+         * @brief 获取图像宽度
+         * @return 亮度平面的宽度
+         */
+        int width() const { return y.width(); }
+
+        /**
+         * @brief 获取图像高度
+         * @return 亮度平面的高度
+         */
+        int height() const { return y.height(); }
+
+        /**
+         * @brief 从紧密排列的帧缓冲区复制数据（例如视频解码器输出）
+         * @param data 帧数据，依次为Y平面和色度平面，没有行间填充
+         * @param width 图像宽度
+         * @param height 图像高度
+         * @param format 帧格式
+         * @return YUV图像
+         * @throw mylib::InvalidArgumentException 如果data为空或尺寸无效
+         */
+        static YUVImage fromBuffer(const unsigned char *data, int width, int height, YUVFormat format);
+
+        /**
+         * @brief 输出为紧密排列的帧缓冲区，fromBuffer的逆操作
+         * @return 帧数据，长度为width × height + 2 × ((width + 1) / 2) × ((height + 1) / 2)
+         * @throw mylib::InvalidArgumentException 如果平面尺寸与格式不符
+         */
+        std::vector<unsigned char> toBuffer() const;
+
+        /**
+         * @brief 只调整亮度平面，色度保持不变
+         * @param delta 亮度增量，取值范围[-255, 255]
+         * @throw std::invalid_argument 如果参数无效
+         */
+        void adjustBrightness(int delta);
+
+        /**
+         * @brief 只对亮度平面做高斯模糊，色度平面与原图像共享
+         * @param kernelSize 卷积核大小（必须是奇数）
+         * @param sigma 高斯函数的标准差
+         * @return 模糊后的YUV图像
+         * @throw std::invalid_argument 如果参数无效
+         */
+        YUVImage gaussianBlur(int kernelSize, double sigma) const;
+    };
+
     /**
      * @brief 图像数据管理类，负责图像数据的存储和引用计数
      */
@@ -307,6 +1331,81 @@ namespace mylib
         std::atomic<int> refCount_;             // 引用计数
     };
 
+    /**
+     * @brief 64位图像哈希的内存索引，按汉明距离查找近似重复项
+     * 查询是对全部哈希的线性扫描：AVX2下每次用查表法统计4个哈希的位数，数据量大时按条带并行
+     */
+    class HashIndex
+    {
+    public:
+        /**
+         * @brief 创建空索引
+         */
+        HashIndex() = default;
+
+        /**
+         * @brief 用已有的哈希创建索引，下标与数组顺序一致
+         * @param hashes 哈希数组
+         */
+        explicit HashIndex(std::vector<uint64_t> hashes);
+
+        /**
+         * @brief 加入一个哈希
+         * @param hash 哈希值
+         * @return 该哈希的下标
+         */
+        size_t add(uint64_t hash);
+
+        /**
+         * @brief 预留容量
+         * @param count 预计的哈希个数
+         */
+        void reserve(size_t count);
+
+        /**
+         * @brief 获取哈希个数
+         * @return 哈希个数
+         */
+        size_t size() const;
+
+        /**
+         * @brief 获取指定下标的哈希
+         * @param index 下标
+         * @return 哈希值
+         * @throw mylib::OutOfRangeException 如果下标越界
+         */
+        uint64_t hash(size_t index) const;
+
+        /**
+         * @brief 查找与给定哈希的汉明距离不超过maxDistance的所有项
+         * @param hash 查询哈希
+         * @param maxDistance 最大汉明距离，取值[0, 64]
+         * @return 命中项，按下标递增
+         * @throw mylib::InvalidArgumentException 如果maxDistance超出范围
+         */
+        std::vector<HashMatch> query(uint64_t hash, int maxDistance) const;
+
+        /**
+         * @brief 查找与给定哈希汉明距离最小的项（距离相同时取下标最小的）
+         * @param hash 查询哈希
+         * @return 最近的项
+         * @throw mylib::OperationFailedException 如果索引为空
+         */
+        HashMatch nearest(uint64_t hash) const;
+
+        /**
+         * @brief 找出索引内所有汉明距离不超过maxDistance的下标对(i, j)，i < j
+         * 两两比较的复杂度为O(n^2)，按块访问使被比较的哈希留在缓存中，多个块并行处理
+         * @param maxDistance 最大汉明距离，取值[0, 64]
+         * @return 下标对，按(i, j)字典序递增
+         * @throw mylib::InvalidArgumentException 如果maxDistance超出范围
+         */
+        std::vector<std::pair<size_t, size_t>> findDuplicates(int maxDistance) const;
+
+    private:
+        std::vector<uint64_t> hashes_; // 按加入顺序存储的哈希
+    };
+
     /**
      * @brief 图像处理库异常基类
      */
@@ -0,0 +1,453 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        /**
+         * @brief 交换一行中每个像素的第0和第2通道（RGB <-> BGR，RGBA <-> BGRA）
+         */
+        void swapRBRow(const unsigned char *src, unsigned char *dst, int width, int cn)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+            if (cn == 3)
+            {
+#if defined(__SSSE3__)
+                // 每次读16字节、交换5个像素，第16个字节原样写出，它属于下一次迭代才写入的像素，会被正确的值覆盖
+                const __m128i swap = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+                for (; x + 6 <= width; x += 5)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 3), _mm_shuffle_epi8(v, swap));
+                }
+#endif
+            }
+            else if (cn == 4)
+            {
+#if defined(__AVX2__)
+                const __m256i swap = _mm256_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+                                                      2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+                for (; x <= width - 8; x += 8)
+                {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), _mm256_shuffle_epi8(v, swap));
+                }
+#elif defined(__SSSE3__)
+                const __m128i swap = _mm_setr_epi8(2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+                for (; x <= width - 4; x += 4)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_shuffle_epi8(v, swap));
+                }
+#endif
+            }
+#endif
+            for (; x < width; ++x)
+            {
+                const unsigned char *s = src + x * cn;
+                unsigned char *d = dst + x * cn;
+                unsigned char r = s[0];
+                d[0] = s[2];
+                d[1] = s[1];
+                d[2] = r;
+                if (cn == 4)
+                {
+                    d[3] = s[3];
+                }
+            }
+        }
+
+        /**
+         * @brief 三通道行扩展为四通道并填入常数alpha
+         */
+        void addAlphaRow(const unsigned char *src, unsigned char *dst, int width, unsigned char alpha)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            // 两个128位通道各从12字节（4个像素）扩展出16字节，读取时每个通道多读4字节，因此要求后面还有像素
+            const __m256i expand = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+                                                    0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+            for (; x + 10 <= width; x += 8)
+            {
+                const unsigned char *p = src + x * 3;
+                __m256i v = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))),
+                                                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 12)), 1);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 4), _mm256_or_si256(_mm256_shuffle_epi8(v, expand), alphaMask));
+            }
+#elif defined(__SSSE3__)
+            const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(static_cast<uint32_t>(alpha) << 24));
+            for (; x + 6 <= width; x += 4)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 3));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x * 4), _mm_or_si128(_mm_shuffle_epi8(v, expand), alphaMask));
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                dst[x * 4] = src[x * 3];
+                dst[x * 4 + 1] = src[x * 3 + 1];
+                dst[x * 4 + 2] = src[x * 3 + 2];
+                dst[x * 4 + 3] = alpha;
+            }
+        }
+
+        /**
+         * @brief 四通道行去掉alpha得到三通道
+         */
+        void dropAlphaRow(const unsigned char *src, unsigned char *dst, int width)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            // 每个128位通道压缩出12字节，再用跨通道置换拼成连续的24字节；
+            // 写出32字节时多出的8字节属于下一次迭代才写入的像素，会被正确的值覆盖
+            const __m256i compact = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                                     0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            const __m256i join = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7);
+            for (; x + 11 <= width; x += 8)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+                v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, compact), join);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x * 3), v);
+            }
+#elif defined(__SSSE3__)
+            // 每次16个像素：4个寄存器各压缩出12字节，再用字节移位拼成3个完整的输出寄存器
+            const __m128i compact = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            for (; x <= width - 16; x += 16)
+            {
+                const unsigned char *p = src + x * 4;
+                __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), compact);
+                __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16)), compact);
+                __m128i c = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32)), compact);
+                __m128i d = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 48)), compact);
+                unsigned char *q = dst + x * 3;
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(q), _mm_or_si128(a, _mm_slli_si128(b, 12)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 16), _mm_or_si128(_mm_srli_si128(b, 4), _mm_slli_si128(c, 8)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(q + 32), _mm_or_si128(_mm_srli_si128(c, 8), _mm_slli_si128(d, 4)));
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                dst[x * 3] = src[x * 4];
+                dst[x * 3 + 1] = src[x * 4 + 1];
+                dst[x * 3 + 2] = src[x * 4 + 2];
+            }
+        }
+    } // namespace
+
+    namespace detail
+    {
+        /**
+         * @brief 把一行交错像素拆成cn个平面行
+         * 三通道每次处理16个像素：3个输入寄存器各用pshufb取出属于某个通道的字节，再按位或拼成一个平面寄存器；
+         * 四通道每次处理4x4个像素：先在寄存器内按通道分组，再做4x4的32位转置
+         */
+        void splitRow(const unsigned char *src, unsigned char *const *dst, int width, int cn)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__SSSE3__)
+            if (cn == 3)
+            {
+                const __m128i m00 = _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+                const __m128i m01 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1);
+                const __m128i m02 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13);
+                const __m128i m10 = _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+                const __m128i m11 = _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1);
+                const __m128i m12 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14);
+                const __m128i m20 = _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+                const __m128i m21 = _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1);
+                const __m128i m22 = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15);
+                for (; x <= width - 16; x += 16)
+                {
+                    const unsigned char *p = src + x * 3;
+                    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+                    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+                    __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32));
+                    __m128i c0 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m00), _mm_shuffle_epi8(b, m01)), _mm_shuffle_epi8(c, m02));
+                    __m128i c1 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m10), _mm_shuffle_epi8(b, m11)), _mm_shuffle_epi8(c, m12));
+                    __m128i c2 = _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a, m20), _mm_shuffle_epi8(b, m21)), _mm_shuffle_epi8(c, m22));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[0] + x), c0);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[1] + x), c1);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[2] + x), c2);
+                }
+            }
+            else if (cn == 4)
+            {
+                // 每个寄存器内把4个像素按通道分组：[c0 x4, c1 x4, c2 x4, c3 x4]
+                const __m128i group = _mm_setr_epi8(0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14, 3, 7, 11, 15);
+                for (; x <= width - 16; x += 16)
+                {
+                    const unsigned char *p = src + x * 4;
+                    __m128i r0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), group);
+                    __m128i r1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16)), group);
+                    __m128i r2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 32)), group);
+                    __m128i r3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 48)), group);
+                    __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+                    __m128i t1 = _mm_unpackhi_epi32(r0, r1);
+                    __m128i t2 = _mm_unpacklo_epi32(r2, r3);
+                    __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[0] + x), _mm_unpacklo_epi64(t0, t2));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[1] + x), _mm_unpackhi_epi64(t0, t2));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[2] + x), _mm_unpacklo_epi64(t1, t3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst[3] + x), _mm_unpackhi_epi64(t1, t3));
+                }
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    dst[c][x] = src[x * cn + c];
+                }
+            }
+        }
+
+        /**
+         * @brief 把cn个平面行交错成一行像素，splitRow的逆操作
+         * 三通道每个输出寄存器由3个平面寄存器各pshufb一次后按位或得到；四通道用两级unpack交错
+         */
+        void mergeRow(const unsigned char *const *src, unsigned char *dst, int width, int cn)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__SSSE3__)
+            if (cn == 3)
+            {
+                const __m128i m00 = _mm_setr_epi8(0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1, 5);
+                const __m128i m01 = _mm_setr_epi8(-1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1, -1);
+                const __m128i m02 = _mm_setr_epi8(-1, -1, 0, -1, -1, 1, -1, -1, 2, -1, -1, 3, -1, -1, 4, -1);
+                const __m128i m10 = _mm_setr_epi8(-1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10, -1);
+                const __m128i m11 = _mm_setr_epi8(5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1, 10);
+                const __m128i m12 = _mm_setr_epi8(-1, 5, -1, -1, 6, -1, -1, 7, -1, -1, 8, -1, -1, 9, -1, -1);
+                const __m128i m20 = _mm_setr_epi8(-1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1, -1);
+                const __m128i m21 = _mm_setr_epi8(-1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15, -1);
+                const __m128i m22 = _mm_setr_epi8(10, -1, -1, 11, -1, -1, 12, -1, -1, 13, -1, -1, 14, -1, -1, 15);
+                for (; x <= width - 16; x += 16)
+                {
+                    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[0] + x));
+                    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[1] + x));
+                    __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[2] + x));
+                    unsigned char *p = dst + x * 3;
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(p),
+                                     _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, m00), _mm_shuffle_epi8(p1, m01)), _mm_shuffle_epi8(p2, m02)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 16),
+                                     _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, m10), _mm_shuffle_epi8(p1, m11)), _mm_shuffle_epi8(p2, m12)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 32),
+                                     _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(p0, m20), _mm_shuffle_epi8(p1, m21)), _mm_shuffle_epi8(p2, m22)));
+                }
+            }
+#endif
+#if defined(__SSE2__)
+            if (cn == 4)
+            {
+                for (; x <= width - 16; x += 16)
+                {
+                    __m128i p0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[0] + x));
+                    __m128i p1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[1] + x));
+                    __m128i p2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[2] + x));
+                    __m128i p3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src[3] + x));
+                    __m128i lo01 = _mm_unpacklo_epi8(p0, p1);
+                    __m128i hi01 = _mm_unpackhi_epi8(p0, p1);
+                    __m128i lo23 = _mm_unpacklo_epi8(p2, p3);
+                    __m128i hi23 = _mm_unpackhi_epi8(p2, p3);
+                    unsigned char *p = dst + x * 4;
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm_unpacklo_epi16(lo01, lo23));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 16), _mm_unpackhi_epi16(lo01, lo23));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 32), _mm_unpacklo_epi16(hi01, hi23));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(p + 48), _mm_unpackhi_epi16(hi01, hi23));
+                }
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    dst[x * cn + c] = src[c][x];
+                }
+            }
+        }
+    } // namespace detail
+
+    std::vector<OptimalImage> OptimalImage::split() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot split an empty image");
+        }
+
+        std::vector<OptimalImage> planes;
+        planes.reserve(channels_);
+        for (int c = 0; c < channels_; ++c)
+        {
+            planes.emplace_back(width_, height_, 1);
+        }
+
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            // 通道数没有上限，行指针表不能放在固定大小的数组里
+            std::vector<unsigned char *> dstRows(channels_);
+            for (int c = 0; c < channels_; ++c)
+            {
+                dstRows[c] = planes[c].data() + y * planes[c].step();
+            }
+            detail::splitRow(data() + y * step(), dstRows.data(), width_, channels_);
+        }
+
+        return planes;
+    }
+
+    OptimalImage OptimalImage::merge(const std::vector<OptimalImage> &planes)
+    {
+        if (planes.empty() || planes.size() > 4)
+        {
+            std::stringstream ss;
+            ss << "Merge requires 1 to 4 planes, but got " << planes.size();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        int width = planes[0].width();
+        int height = planes[0].height();
+        for (size_t c = 0; c < planes.size(); ++c)
+        {
+            if (planes[c].empty() || planes[c].channels() != 1)
+            {
+                std::stringstream ss;
+                ss << "Plane " << c << " must be a non-empty single-channel image";
+                throw InvalidArgumentException(ss.str());
+            }
+            if (planes[c].width() != width || planes[c].height() != height)
+            {
+                std::stringstream ss;
+                ss << "Plane " << c << " size " << planes[c].width() << "x" << planes[c].height()
+                   << " does not match plane 0 size " << width << "x" << height;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        int cn = static_cast<int>(planes.size());
+        OptimalImage result(width, height, cn);
+        int pixelCount = width * height;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char *srcRows[4];
+            for (int c = 0; c < cn; ++c)
+            {
+                srcRows[c] = planes[c].data() + y * planes[c].step();
+            }
+            detail::mergeRow(srcRows, result.data() + y * result.step(), width, cn);
+        }
+
+        return result;
+    }
+
+    OptimalImage OptimalImage::swapRB() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot swap channels of an empty image");
+        }
+
+        if (channels_ != 3 && channels_ != 4)
+        {
+            std::stringstream ss;
+            ss << "swapRB requires a 3- or 4-channel image, but got " << channels_ << " channels";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        OptimalImage result(width_, height_, channels_);
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            swapRBRow(data() + y * step(), result.data() + y * result.step(), width_, channels_);
+        }
+
+        return result;
+    }
+
+    OptimalImage OptimalImage::addAlpha(unsigned char alpha) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot add alpha to an empty image");
+        }
+
+        if (channels_ != 3)
+        {
+            std::stringstream ss;
+            ss << "addAlpha requires a 3-channel image, but got " << channels_ << " channels";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        OptimalImage result(width_, height_, 4);
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            addAlphaRow(data() + y * step(), result.data() + y * result.step(), width_, alpha);
+        }
+
+        return result;
+    }
+
+    OptimalImage OptimalImage::dropAlpha() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot drop alpha of an empty image");
+        }
+
+        if (channels_ != 4)
+        {
+            std::stringstream ss;
+            ss << "dropAlpha requires a 4-channel image, but got " << channels_ << " channels";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        OptimalImage result(width_, height_, 3);
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            dropAlphaRow(data() + y * step(), result.data() + y * result.step(), width_);
+        }
+
+        return result;
+    }
+
+} // namespace mylib
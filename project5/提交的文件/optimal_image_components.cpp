@@ -0,0 +1,375 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cstdint>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        /**
+         * @brief 一行中连续的前景像素[x0, x1)，label为临时标签
+         */
+        struct Run
+        {
+            int x0;
+            int x1;
+            int32_t label;
+        };
+
+        /**
+         * @brief 一个水平条带的行程和条带内的并查集
+         */
+        struct Strip
+        {
+            int y0 = 0;
+            int y1 = 0;
+            std::vector<Run> runs;
+            std::vector<int> rowStart;   // 第y0 + k行的行程为runs[rowStart[k], rowStart[k + 1])
+            std::vector<int32_t> parent; // 条带内的临时标签从0开始
+        };
+
+        /**
+         * @brief 并查集查找，路径减半
+         */
+        inline int32_t findRoot(int32_t *parent, int32_t x)
+        {
+            while (parent[x] != x)
+            {
+                parent[x] = parent[parent[x]];
+                x = parent[x];
+            }
+            return x;
+        }
+
+        /**
+         * @brief 合并两个集合，总是把较大的根挂到较小的根下，使根为集合中光栅顺序最早的标签
+         */
+        inline int32_t unite(int32_t *parent, int32_t a, int32_t b)
+        {
+            a = findRoot(parent, a);
+            b = findRoot(parent, b);
+            if (a < b)
+            {
+                parent[b] = a;
+                return a;
+            }
+            parent[a] = b;
+            return b;
+        }
+
+        /**
+         * @brief 提取一行的前景行程，SIMD下每次比较32/16个像素得到前景位图，全背景或全前景的块直接跳过
+         */
+        void extractRuns(const unsigned char *row, int width, std::vector<Run> &runs)
+        {
+            int x = 0;
+            bool inRun = false;
+            int start = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i zero = _mm256_setzero_si256();
+            constexpr int VEC = 32;
+            for (; x <= width - VEC; x += VEC)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + x));
+                uint32_t fg = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, zero)));
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            constexpr int VEC = 16;
+            for (; x <= width - VEC; x += VEC)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + x));
+                uint32_t fg = static_cast<uint32_t>(~_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero))) & 0xFFFFu;
+#endif
+#if defined(__AVX2__) || defined(__SSE2__)
+                const uint32_t full = VEC == 32 ? 0xFFFFFFFFu : 0xFFFFu;
+                if (fg == (inRun ? full : 0u))
+                {
+                    continue;
+                }
+
+                // 依次找行程的起点（下一个1）和终点（下一个0）
+                int pos = 0;
+                while (pos < VEC)
+                {
+                    uint32_t rest = (inRun ? ~fg & full : fg) >> pos;
+                    if (rest == 0)
+                    {
+                        break;
+                    }
+                    pos += detail::countTrailingZeros(rest);
+                    if (inRun)
+                    {
+                        runs.push_back({start, x + pos, 0});
+                    }
+                    else
+                    {
+                        start = x + pos;
+                    }
+                    inRun = !inRun;
+                }
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                bool fg = row[x] != 0;
+                if (fg && !inRun)
+                {
+                    start = x;
+                }
+                else if (!fg && inRun)
+                {
+                    runs.push_back({start, x, 0});
+                }
+                inRun = fg;
+            }
+            if (inRun)
+            {
+                runs.push_back({start, width, 0});
+            }
+        }
+
+        /**
+         * @brief 两个相邻行的行程是否连通：4连通要求列区间重叠，8连通允许对角相邻
+         */
+        inline bool runsTouch(const Run &a, const Run &b, int slack)
+        {
+            return b.x0 < a.x1 + slack && a.x0 < b.x1 + slack;
+        }
+
+        /**
+         * @brief 对cur行的每个行程，与prev行中所有相连的行程合并（两个行程数组都按x0递增）
+         */
+        void linkRows(Run *cur, int curCount, const Run *prev, int prevCount, int slack, int32_t *parent)
+        {
+            int j = 0;
+            for (int i = 0; i < curCount; ++i)
+            {
+                Run &a = cur[i];
+                // 完全在a左侧的行程也在后续行程的左侧，可以永久跳过
+                while (j < prevCount && prev[j].x1 + slack <= a.x0)
+                {
+                    ++j;
+                }
+                for (int k = j; k < prevCount && prev[k].x0 < a.x1 + slack; ++k)
+                {
+                    a.label = unite(parent, a.label, prev[k].label);
+                }
+            }
+        }
+
+        /**
+         * @brief 第一遍扫描一个条带：提取行程、分配临时标签并在条带内合并
+         */
+        void scanStrip(const OptimalImage &img, Strip &strip, int slack)
+        {
+            int rows = strip.y1 - strip.y0;
+            strip.rowStart.assign(rows + 1, 0);
+            for (int k = 0; k < rows; ++k)
+            {
+                int y = strip.y0 + k;
+                size_t first = strip.runs.size();
+                extractRuns(img.data() + y * img.step(), img.width(), strip.runs);
+                strip.rowStart[k + 1] = static_cast<int>(strip.runs.size());
+
+                // 每个行程先分配一个新标签，再与上一行相连的行程合并
+                for (size_t r = first; r < strip.runs.size(); ++r)
+                {
+                    strip.runs[r].label = static_cast<int32_t>(strip.parent.size());
+                    strip.parent.push_back(strip.runs[r].label);
+                }
+                if (k > 0)
+                {
+                    linkRows(strip.runs.data() + first, static_cast<int>(strip.runs.size() - first),
+                             strip.runs.data() + strip.rowStart[k - 1], strip.rowStart[k] - strip.rowStart[k - 1],
+                             slack, strip.parent.data());
+                }
+            }
+        }
+    } // namespace
+
+    ConnectedComponents OptimalImage::connectedComponents(int connectivity) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot label connected components of an empty image");
+        }
+
+        if (channels_ != 1)
+        {
+            std::stringstream ss;
+            ss << "Connected component labeling requires a single-channel image, but got " << channels_ << " channels";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (connectivity != 4 && connectivity != 8)
+        {
+            std::stringstream ss;
+            ss << "Connectivity must be 4 or 8, but got " << connectivity;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        int slack = connectivity == 8 ? 1 : 0;
+        int pixelCount = width_ * height_;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height_) : 1;
+        std::vector<Strip> strips(stripes);
+
+        // 第一遍：各条带独立提取行程并合并条带内的等价标签
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            strips[s].y0 = detail::stripeBegin(height_, stripes, s);
+            strips[s].y1 = detail::stripeBegin(height_, stripes, s + 1);
+            scanStrip(*this, strips[s], slack);
+        }
+
+        // 把条带内的标签平移到全局编号，全局编号仍按光栅顺序递增
+        std::vector<int32_t> offset(stripes + 1, 0);
+        for (int s = 0; s < stripes; ++s)
+        {
+            offset[s + 1] = offset[s] + static_cast<int32_t>(strips[s].parent.size());
+        }
+        std::vector<int32_t> parent(offset[stripes]);
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            Strip &strip = strips[s];
+            for (size_t l = 0; l < strip.parent.size(); ++l)
+            {
+                parent[offset[s] + l] = offset[s] + findRoot(strip.parent.data(), static_cast<int32_t>(l));
+            }
+            for (Run &run : strip.runs)
+            {
+                run.label += offset[s];
+            }
+            std::vector<int32_t>().swap(strip.parent);
+        }
+
+        // 合并条带交界处的等价关系：上一条带的最后一行与本条带的第一行
+        for (int s = 1; s < stripes; ++s)
+        {
+            const Strip &above = strips[s - 1];
+            Strip &below = strips[s];
+            if (above.y1 == above.y0 || below.y1 == below.y0)
+            {
+                continue;
+            }
+            int aboveRows = above.y1 - above.y0;
+            const Run *prev = above.runs.data() + above.rowStart[aboveRows - 1];
+            int prevCount = above.rowStart[aboveRows] - above.rowStart[aboveRows - 1];
+            // linkRows会改写cur的标签，这里用副本，条带内的行程标签保持为各自的临时标签
+            std::vector<Run> first(below.runs.begin(), below.runs.begin() + below.rowStart[1]);
+            linkRows(first.data(), static_cast<int>(first.size()), prev, prevCount, slack, parent.data());
+        }
+
+        // 压缩为连续的最终标签：合并时总是挂到较小的根下，所以parent[l] <= l，
+        // 按递增顺序处理时父节点的最终标签已经确定，组件按光栅顺序首次出现的位置编号，与线程数无关
+        int count = 0;
+        std::vector<int32_t> finalLabel(parent.size());
+        for (size_t l = 0; l < parent.size(); ++l)
+        {
+            finalLabel[l] = parent[l] == static_cast<int32_t>(l) ? ++count : finalLabel[parent[l]];
+        }
+        parent.swap(finalLabel);
+
+        ConnectedComponents result;
+        result.count = count;
+        result.labels = ImageBuffer<int32_t>(width_, height_, 1);
+
+        // 第二遍：并行写出标签图
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            const Strip &strip = strips[s];
+            for (int k = 0; k < strip.y1 - strip.y0; ++k)
+            {
+                int32_t *row = result.labels.row(strip.y0 + k);
+                for (int r = strip.rowStart[k]; r < strip.rowStart[k + 1]; ++r)
+                {
+                    const Run &run = strip.runs[r];
+                    std::fill(row + run.x0, row + run.x1, parent[run.label]);
+                }
+            }
+        }
+
+        // 统计量直接由行程得到，开销与行程数成正比而不是与像素数成正比
+        result.stats.assign(count + 1, ComponentStats());
+        std::vector<double> sumX(count + 1, 0.0), sumY(count + 1, 0.0);
+        std::vector<int> right(count + 1, -1), bottom(count + 1, -1);
+        for (int l = 1; l <= count; ++l)
+        {
+            result.stats[l].left = width_;
+            result.stats[l].top = height_;
+        }
+        long long foreground = 0;
+        for (const Strip &strip : strips)
+        {
+            for (int k = 0; k < strip.y1 - strip.y0; ++k)
+            {
+                int y = strip.y0 + k;
+                for (int r = strip.rowStart[k]; r < strip.rowStart[k + 1]; ++r)
+                {
+                    const Run &run = strip.runs[r];
+                    int label = parent[run.label];
+                    ComponentStats &st = result.stats[label];
+                    long long length = run.x1 - run.x0;
+                    st.area += length;
+                    st.left = std::min(st.left, run.x0);
+                    st.top = std::min(st.top, y);
+                    right[label] = std::max(right[label], run.x1 - 1);
+                    bottom[label] = std::max(bottom[label], y);
+                    sumX[label] += static_cast<double>(run.x0 + run.x1 - 1) * 0.5 * length;
+                    sumY[label] += static_cast<double>(y) * length;
+                    foreground += length;
+                }
+            }
+        }
+
+        double totalSumX = 0.0, totalSumY = 0.0;
+        for (int l = 1; l <= count; ++l)
+        {
+            ComponentStats &st = result.stats[l];
+            st.width = right[l] - st.left + 1;
+            st.height = bottom[l] - st.top + 1;
+            st.centroidX = sumX[l] / static_cast<double>(st.area);
+            st.centroidY = sumY[l] / static_cast<double>(st.area);
+            totalSumX += sumX[l];
+            totalSumY += sumY[l];
+        }
+
+        // 背景：面积和质心由整幅图像减去前景得到
+        ComponentStats &bg = result.stats[0];
+        bg.area = static_cast<long long>(width_) * height_ - foreground;
+        bg.width = width_;
+        bg.height = height_;
+        if (bg.area > 0)
+        {
+            double allX = static_cast<double>(width_ - 1) * 0.5 * width_ * height_;
+            double allY = static_cast<double>(height_ - 1) * 0.5 * height_ * width_;
+            bg.centroidX = (allX - totalSumX) / static_cast<double>(bg.area);
+            bg.centroidY = (allY - totalSumY) / static_cast<double>(bg.area);
+        }
+
+        return result;
+    }
+
+} // namespace mylib
@@ -0,0 +1,522 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        /**
+         * @brief 四舍五入的x / 255，x取值[0, 255 × 255]
+         */
+        inline int div255(int x)
+        {
+            x += 128;
+            return (x + (x >> 8)) >> 8;
+        }
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+        // 乘高位技巧：((x + 128) × 257) >> 16 等于round(x / 255)，对[0, 255 × 255]内的x精确成立
+        inline __m256i div255Epu16(__m256i x)
+        {
+            return _mm256_mulhi_epu16(_mm256_add_epi16(x, _mm256_set1_epi16(128)), _mm256_set1_epi16(257));
+        }
+#elif defined(__SSSE3__)
+        inline __m128i div255Epu16(__m128i x)
+        {
+            return _mm_mulhi_epu16(_mm_add_epi16(x, _mm_set1_epi16(128)), _mm_set1_epi16(257));
+        }
+#endif
+#endif
+
+        /**
+         * @brief 单个像素的over运算
+         * 预乘：out = s + d × (255 - sa) / 255
+         * 直通：t = da × (255 - sa) / 255，outA = sa + t，outC = (sc × sa + dc × t) / outA
+         */
+        inline void compositePixel(unsigned char *d, const unsigned char *s, bool premultiplied)
+        {
+            int sa = s[3];
+            if (sa == 0)
+            {
+                return;
+            }
+            if (sa == 255)
+            {
+                std::memcpy(d, s, 4);
+                return;
+            }
+
+            int inv = 255 - sa;
+            if (premultiplied)
+            {
+                for (int c = 0; c < 4; ++c)
+                {
+                    d[c] = static_cast<unsigned char>(std::min(255, s[c] + div255(d[c] * inv)));
+                }
+                return;
+            }
+
+            int t = div255(d[3] * inv);
+            int outA = sa + t;
+            for (int c = 0; c < 3; ++c)
+            {
+                int num = s[c] * sa + d[c] * t;
+                d[c] = static_cast<unsigned char>(static_cast<int>(static_cast<float>(num) / static_cast<float>(outA) + 0.5f));
+            }
+            d[3] = static_cast<unsigned char>(outA);
+        }
+
+        /**
+         * @brief 一段连续像素的over运算
+         * SIMD路径按组判断：src全透明跳过、全不透明直接复制；预乘格式和dst不透明的直通格式用16位定点计算，
+         * dst半透明的直通格式需要逐像素除以outA，退回标量
+         */
+        void compositeSpan(unsigned char *d, const unsigned char *s, int n, bool premultiplied)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i alphaMask = _mm256_set1_epi32(static_cast<int>(0xFF000000u));
+            const __m256i broadcastAlpha = _mm256_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15,
+                                                            3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+            const __m256i allOnes = _mm256_set1_epi8(-1);
+            const __m256i zero = _mm256_setzero_si256();
+            for (; i <= n - 8; i += 8)
+            {
+                __m256i sv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + i * 4));
+                __m256i sa = _mm256_and_si256(sv, alphaMask);
+                if (_mm256_testz_si256(sa, sa))
+                {
+                    continue;
+                }
+                if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(sa, alphaMask)) == -1)
+                {
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i * 4), sv);
+                    continue;
+                }
+
+                __m256i dv = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(d + i * 4));
+                __m256i a = _mm256_shuffle_epi8(sv, broadcastAlpha);
+                __m256i inv = _mm256_xor_si256(a, allOnes);
+                __m256i invLo = _mm256_unpacklo_epi8(inv, zero);
+                __m256i invHi = _mm256_unpackhi_epi8(inv, zero);
+                __m256i dLo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(dv, zero), invLo);
+                __m256i dHi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(dv, zero), invHi);
+
+                if (premultiplied)
+                {
+                    __m256i r = _mm256_packus_epi16(div255Epu16(dLo), div255Epu16(dHi));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i * 4), _mm256_adds_epu8(sv, r));
+                }
+                else if (_mm256_movemask_epi8(_mm256_cmpeq_epi32(_mm256_and_si256(dv, alphaMask), alphaMask)) == -1)
+                {
+                    // dst不透明：outA = 255，颜色退化为线性插值
+                    __m256i sLo = _mm256_mullo_epi16(_mm256_unpacklo_epi8(sv, zero), _mm256_unpacklo_epi8(a, zero));
+                    __m256i sHi = _mm256_mullo_epi16(_mm256_unpackhi_epi8(sv, zero), _mm256_unpackhi_epi8(a, zero));
+                    __m256i r = _mm256_packus_epi16(div255Epu16(_mm256_add_epi16(sLo, dLo)), div255Epu16(_mm256_add_epi16(sHi, dHi)));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i * 4), _mm256_or_si256(r, alphaMask));
+                }
+                else
+                {
+                    for (int k = i; k < i + 8; ++k)
+                    {
+                        compositePixel(d + k * 4, s + k * 4, false);
+                    }
+                }
+            }
+#elif defined(__SSSE3__)
+            const __m128i alphaMask = _mm_set1_epi32(static_cast<int>(0xFF000000u));
+            const __m128i broadcastAlpha = _mm_setr_epi8(3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15);
+            const __m128i allOnes = _mm_set1_epi8(-1);
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= n - 4; i += 4)
+            {
+                __m128i sv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + i * 4));
+                __m128i sa = _mm_and_si128(sv, alphaMask);
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, zero)) == 0xFFFF)
+                {
+                    continue;
+                }
+                if (_mm_movemask_epi8(_mm_cmpeq_epi32(sa, alphaMask)) == 0xFFFF)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + i * 4), sv);
+                    continue;
+                }
+
+                __m128i dv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(d + i * 4));
+                __m128i a = _mm_shuffle_epi8(sv, broadcastAlpha);
+                __m128i inv = _mm_xor_si128(a, allOnes);
+                __m128i dLo = _mm_mullo_epi16(_mm_unpacklo_epi8(dv, zero), _mm_unpacklo_epi8(inv, zero));
+                __m128i dHi = _mm_mullo_epi16(_mm_unpackhi_epi8(dv, zero), _mm_unpackhi_epi8(inv, zero));
+
+                if (premultiplied)
+                {
+                    __m128i r = _mm_packus_epi16(div255Epu16(dLo), div255Epu16(dHi));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + i * 4), _mm_adds_epu8(sv, r));
+                }
+                else if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(dv, alphaMask), alphaMask)) == 0xFFFF)
+                {
+                    __m128i sLo = _mm_mullo_epi16(_mm_unpacklo_epi8(sv, zero), _mm_unpacklo_epi8(a, zero));
+                    __m128i sHi = _mm_mullo_epi16(_mm_unpackhi_epi8(sv, zero), _mm_unpackhi_epi8(a, zero));
+                    __m128i r = _mm_packus_epi16(div255Epu16(_mm_add_epi16(sLo, dLo)), div255Epu16(_mm_add_epi16(sHi, dHi)));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(d + i * 4), _mm_or_si128(r, alphaMask));
+                }
+                else
+                {
+                    for (int k = i; k < i + 4; ++k)
+                    {
+                        compositePixel(d + k * 4, s + k * 4, false);
+                    }
+                }
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                compositePixel(d + i * 4, s + i * 4, premultiplied);
+            }
+        }
+
+        // blendMany权重定点化的最大小数位数
+        constexpr int BLEND_MAX_BITS = 14;
+
+        /**
+         * @brief 把浮点权重转为16位定点数，选择尽量多的小数位，同时保证单个权重不超过int16、
+         * 累加和 255 × Σ|w| 加上舍入量不超过int32
+         * @param weights 浮点权重
+         * @param fixed 输出的定点权重
+         * @return 小数位数；权重过大无法表示时返回-1
+         */
+        int quantizeWeights(const std::vector<float> &weights, std::vector<int16_t> &fixed)
+        {
+            double maxAbs = 0.0;
+            double sumAbs = 0.0;
+            for (float w : weights)
+            {
+                maxAbs = std::max(maxAbs, std::fabs(static_cast<double>(w)));
+                sumAbs += std::fabs(static_cast<double>(w));
+            }
+
+            for (int bits = BLEND_MAX_BITS; bits >= 0; --bits)
+            {
+                double scale = static_cast<double>(1 << bits);
+                // 每个权重的舍入误差不超过0.5，按N × 0.5放宽总和的上界
+                double bound = 255.0 * (sumAbs * scale + 0.5 * static_cast<double>(weights.size())) + scale;
+                if (maxAbs * scale + 0.5 <= 32767.0 && bound <= 2147483647.0)
+                {
+                    fixed.resize(weights.size());
+                    for (size_t i = 0; i < weights.size(); ++i)
+                    {
+                        fixed[i] = static_cast<int16_t>(std::lrint(static_cast<double>(weights[i]) * scale));
+                    }
+                    return bits;
+                }
+            }
+            return -1;
+        }
+
+        /**
+         * @brief 一行的N路加权和：dst[i] = saturate((Σ w[k] × rows[k][i] + round) >> bits)
+         * 两张图像的像素按16位交错后与(w[k], w[k + 1])做一次madd，累加器常驻寄存器，每个输入只读一次
+         */
+        void blendManyRow(const unsigned char *const *rows, const int16_t *weights, int n, int bits,
+                          unsigned char *dst, int count)
+        {
+            const int round = bits > 0 ? 1 << (bits - 1) : 0;
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i vRound = _mm256_set1_epi32(round);
+            const __m256i zero = _mm256_setzero_si256();
+            for (; i <= count - 16; i += 16)
+            {
+                __m256i accLo = vRound;
+                __m256i accHi = vRound;
+                for (int k = 0; k < n; k += 2)
+                {
+                    __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + i)));
+                    __m256i b = zero;
+                    int16_t wb = 0;
+                    if (k + 1 < n)
+                    {
+                        b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k + 1] + i)));
+                        wb = weights[k + 1];
+                    }
+                    __m256i w = _mm256_set1_epi32(static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(wb)) << 16) |
+                                                                   static_cast<uint16_t>(weights[k])));
+                    accLo = _mm256_add_epi32(accLo, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), w));
+                    accHi = _mm256_add_epi32(accHi, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), w));
+                }
+                // unpacklo/hi在每个128位通道内交错，packs后恢复原顺序
+                __m256i packed = _mm256_packs_epi32(_mm256_srai_epi32(accLo, bits), _mm256_srai_epi32(accHi, bits));
+                packed = _mm256_packus_epi16(packed, packed);
+                packed = _mm256_permute4x64_epi64(packed, 0x08);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(packed));
+            }
+#elif defined(__SSE2__)
+            const __m128i vRound = _mm_set1_epi32(round);
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 8; i += 8)
+            {
+                __m128i accLo = vRound;
+                __m128i accHi = vRound;
+                for (int k = 0; k < n; k += 2)
+                {
+                    __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[k] + i)), zero);
+                    __m128i b = zero;
+                    int16_t wb = 0;
+                    if (k + 1 < n)
+                    {
+                        b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[k + 1] + i)), zero);
+                        wb = weights[k + 1];
+                    }
+                    __m128i w = _mm_set1_epi32(static_cast<int>((static_cast<uint32_t>(static_cast<uint16_t>(wb)) << 16) |
+                                                                static_cast<uint16_t>(weights[k])));
+                    accLo = _mm_add_epi32(accLo, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w));
+                    accHi = _mm_add_epi32(accHi, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w));
+                }
+                __m128i packed = _mm_packs_epi32(_mm_srai_epi32(accLo, bits), _mm_srai_epi32(accHi, bits));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(packed, zero));
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                int acc = round;
+                for (int k = 0; k < n; ++k)
+                {
+                    acc += weights[k] * rows[k][i];
+                }
+                dst[i] = static_cast<unsigned char>(std::clamp(acc >> bits, 0, 255));
+            }
+        }
+
+        /**
+         * @brief 一行的滑动加权累加：acc[i] += alpha × (src[i] - acc[i])
+         */
+        void accumulateRow(const unsigned char *src, float *acc, float alpha, int count)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256 vAlpha = _mm256_set1_ps(alpha);
+            for (; i <= count - 8; i += 8)
+            {
+                __m256 s = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i))));
+                __m256 a = _mm256_loadu_ps(acc + i);
+                a = _mm256_add_ps(a, _mm256_mul_ps(vAlpha, _mm256_sub_ps(s, a)));
+                _mm256_storeu_ps(acc + i, a);
+            }
+#elif defined(__SSE2__)
+            const __m128 vAlpha = _mm_set1_ps(alpha);
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 8; i += 8)
+            {
+                __m128i pix = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)), zero);
+                __m128 s0 = _mm_cvtepi32_ps(_mm_unpacklo_epi16(pix, zero));
+                __m128 s1 = _mm_cvtepi32_ps(_mm_unpackhi_epi16(pix, zero));
+                __m128 a0 = _mm_loadu_ps(acc + i);
+                __m128 a1 = _mm_loadu_ps(acc + i + 4);
+                _mm_storeu_ps(acc + i, _mm_add_ps(a0, _mm_mul_ps(vAlpha, _mm_sub_ps(s0, a0))));
+                _mm_storeu_ps(acc + i + 4, _mm_add_ps(a1, _mm_mul_ps(vAlpha, _mm_sub_ps(s1, a1))));
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                acc[i] += alpha * (static_cast<float>(src[i]) - acc[i]);
+            }
+        }
+    } // namespace
+
+    void OptimalImage::compositeOver(OptimalImage &dst, const OptimalImage &src, bool premultiplied, int offsetX, int offsetY)
+    {
+        if (dst.empty() || src.empty())
+        {
+            throw InvalidArgumentException("Cannot composite empty images");
+        }
+
+        if (dst.channels() != 4 || src.channels() != 4)
+        {
+            std::stringstream ss;
+            ss << "Alpha compositing requires 4-channel images, but got "
+               << src.channels() << " channels over " << dst.channels() << " channels";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        // 裁剪到dst范围内
+        int x0 = std::max(0, offsetX);
+        int y0 = std::max(0, offsetY);
+        int x1 = static_cast<int>(std::min<long long>(dst.width(), static_cast<long long>(offsetX) + src.width()));
+        int y1 = static_cast<int>(std::min<long long>(dst.height(), static_cast<long long>(offsetY) + src.height()));
+        if (x0 >= x1 || y0 >= y1)
+        {
+            return;
+        }
+
+        dst.copyOnWrite();
+        int spanWidth = x1 - x0;
+        int pixelCount = spanWidth * (y1 - y0);
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = y0; y < y1; ++y)
+        {
+            unsigned char *d = dst.data() + y * dst.step() + static_cast<size_t>(x0) * 4;
+            const unsigned char *s = src.data() + (y - offsetY) * src.step() + static_cast<size_t>(x0 - offsetX) * 4;
+            compositeSpan(d, s, spanWidth, premultiplied);
+        }
+    }
+
+    OptimalImage OptimalImage::blendMany(const std::vector<OptimalImage> &images, const std::vector<float> &weights)
+    {
+        if (images.empty())
+        {
+            throw InvalidArgumentException("Cannot blend an empty image list");
+        }
+
+        if (weights.size() != images.size())
+        {
+            std::stringstream ss;
+            ss << "Weight count must match image count, but got " << weights.size()
+               << " weights for " << images.size() << " images";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        const OptimalImage &first = images.front();
+        for (size_t k = 0; k < images.size(); ++k)
+        {
+            if (images[k].empty())
+            {
+                throw InvalidArgumentException("Cannot blend empty images");
+            }
+            if (images[k].width() != first.width() || images[k].height() != first.height() ||
+                images[k].channels() != first.channels())
+            {
+                std::stringstream ss;
+                ss << "Images must have the same dimensions and channels, but image " << k << " is "
+                   << images[k].width() << "x" << images[k].height() << "x" << images[k].channels()
+                   << " while image 0 is " << first.width() << "x" << first.height() << "x" << first.channels();
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        std::vector<int16_t> fixed;
+        int bits = quantizeWeights(weights, fixed);
+        if (bits < 0)
+        {
+            throw InvalidArgumentException("Blend weights are too large to be represented in fixed point");
+        }
+
+        int width = first.width();
+        int height = first.height();
+        int n = static_cast<int>(images.size());
+        int count = width * first.channels();
+        int pixelCount = width * height;
+        OptimalImage result(width, height, first.channels());
+        unsigned char *dstData = result.data();
+        size_t dstStep = result.step();
+
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<const unsigned char *> rows(n);
+            int yEnd = detail::stripeBegin(height, stripes, s + 1);
+            for (int y = detail::stripeBegin(height, stripes, s); y < yEnd; ++y)
+            {
+                for (int k = 0; k < n; ++k)
+                {
+                    rows[k] = images[k].data() + y * images[k].step();
+                }
+                blendManyRow(rows.data(), fixed.data(), n, bits, dstData + y * dstStep, count);
+            }
+        }
+
+        return result;
+    }
+
+    void OptimalImage::accumulateWeighted(const OptimalImage &src, ImageBuffer<float> &accumulator, float alpha)
+    {
+        if (src.empty())
+        {
+            throw InvalidArgumentException("Cannot accumulate an empty image");
+        }
+
+        if (!(alpha >= 0.0f && alpha <= 1.0f))
+        {
+            std::stringstream ss;
+            ss << "Accumulation weight must be in [0, 1], but got " << alpha;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        int width = src.width();
+        int height = src.height();
+        int count = width * src.channels();
+        int pixelCount = width * height;
+
+        if (accumulator.data.empty())
+        {
+            // 空累加器以第一帧初始化：零缓冲区上alpha = 1的更新正好得到src
+            accumulator = ImageBuffer<float>(width, height, src.channels());
+            alpha = 1.0f;
+        }
+        else if (accumulator.width != width || accumulator.height != height || accumulator.channels != src.channels())
+        {
+            std::stringstream ss;
+            ss << "Accumulator is " << accumulator.width << "x" << accumulator.height << "x" << accumulator.channels
+               << " but the image is " << width << "x" << height << "x" << src.channels();
+            throw InvalidArgumentException(ss.str());
+        }
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height; ++y)
+        {
+            accumulateRow(src.data() + y * src.step(), accumulator.row(y), alpha, count);
+        }
+    }
+
+    OptimalImage OptimalImage::fromBuffer(const ImageBuffer<float> &buffer)
+    {
+        if (buffer.data.empty())
+        {
+            throw InvalidArgumentException("Cannot convert an empty buffer");
+        }
+
+        OptimalImage result(buffer.width, buffer.height, buffer.channels);
+        int count = buffer.width * buffer.channels;
+        int pixelCount = buffer.width * buffer.height;
+        unsigned char *dstData = result.data();
+        size_t dstStep = result.step();
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < buffer.height; ++y)
+        {
+            detail::storeRow(buffer.row(y), dstData + y * dstStep, count);
+        }
+
+        return result;
+    }
+
+} // namespace mylib
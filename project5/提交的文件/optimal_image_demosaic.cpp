@@ -0,0 +1,319 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <cstdint>
+#include <sstream>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 5x5邻域的半径
+        constexpr int BAYER_RADIUS = 2;
+
+        // 每次处理的像素数，行缓冲区在末尾多留这么多元素，SIMD不需要标量尾部
+#if defined(USE_SIMD) && defined(__AVX2__)
+        constexpr int BAYER_VEC = 16;
+#else
+        constexpr int BAYER_VEC = 8;
+#endif
+
+        /**
+         * @brief 不重复边界像素的镜像（abc|dcb），保持拜耳阵列的奇偶性，要求n >= 2
+         */
+        inline int reflect101(int i, int n)
+        {
+            while (i < 0 || i >= n)
+            {
+                i = i < 0 ? -i : 2 * (n - 1) - i;
+            }
+            return i;
+        }
+
+        /**
+         * @brief 把源图像的一行扩展为左右各BAYER_RADIUS个镜像像素的int16行，末尾的SIMD余量填0
+         */
+        void loadBayerRow(const unsigned char *src, int width, int16_t *dst)
+        {
+            for (int x = -BAYER_RADIUS; x < 0; ++x)
+            {
+                dst[x + BAYER_RADIUS] = src[reflect101(x, width)];
+            }
+            for (int x = 0; x < width; ++x)
+            {
+                dst[x + BAYER_RADIUS] = src[x];
+            }
+            for (int x = width; x < width + BAYER_RADIUS; ++x)
+            {
+                dst[x + BAYER_RADIUS] = src[reflect101(x, width)];
+            }
+            std::fill(dst + width + 2 * BAYER_RADIUS, dst + width + 2 * BAYER_RADIUS + BAYER_VEC, static_cast<int16_t>(0));
+        }
+
+        /**
+         * @brief 一行的拜耳排列：siteParity为该行非绿色像素所在列的奇偶性，redRow表示非绿色像素是红色
+         */
+        struct BayerRow
+        {
+            int siteParity;
+            bool redRow;
+        };
+
+        BayerRow bayerRow(BayerPattern pattern, int y)
+        {
+            // 第0行的排列，第1行的非绿色像素颜色相反、列奇偶性相反
+            BayerRow row0;
+            switch (pattern)
+            {
+            case BayerPattern::RGGB:
+                row0 = {0, true};
+                break;
+            case BayerPattern::BGGR:
+                row0 = {0, false};
+                break;
+            case BayerPattern::GRBG:
+                row0 = {1, true};
+                break;
+            default: // GBRG
+                row0 = {1, false};
+                break;
+            }
+            if (y % 2 == 0)
+            {
+                return row0;
+            }
+            return {1 - row0.siteParity, !row0.redRow};
+        }
+
+        /**
+         * @brief 计算一行的三个颜色平面
+         * 所有核放大16倍后为整数：
+         *   C：中心像素（16c）
+         *   G：非绿色位置的绿色
+         *   H：绿色位置上、在本行左右相邻的颜色
+         *   V：绿色位置上、在上下行相邻的颜色
+         *   D：非绿色位置上的另一种颜色（对角相邻）
+         * 双线性为相邻像素的平均；Malvar-He-Cutler在此基础上加入中心通道的拉普拉斯校正。
+         * 非绿色位置输出(C, G, D)，绿色位置输出(H, C, V)，最后按redRow分配到R和B
+         * @param rows 5个int16行，指向x = 0，左右各有BAYER_RADIUS个镜像像素
+         */
+        void demosaicRow(const int16_t *const *rows, int width, BayerRow layout, bool mhc,
+                         unsigned char *red, unsigned char *green, unsigned char *blue)
+        {
+            const int16_t *r0 = rows[0];
+            const int16_t *r1 = rows[1];
+            const int16_t *r2 = rows[2];
+            const int16_t *r3 = rows[3];
+            const int16_t *r4 = rows[4];
+            unsigned char *primary = layout.redRow ? red : blue;
+            unsigned char *other = layout.redRow ? blue : red;
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            auto load = [](const int16_t *p)
+            { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); };
+            auto store = [](unsigned char *p, __m256i v)
+            {
+                // (v + 8) >> 4 后饱和到[0, 255]；packus按128位通道打包，再把两个低64位拼在一起
+                v = _mm256_srai_epi16(_mm256_add_epi16(v, _mm256_set1_epi16(8)), 4);
+                v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(p), _mm256_castsi256_si128(v));
+            };
+            const __m256i site = layout.siteParity == 0 ? _mm256_set1_epi32(0x0000FFFF) : _mm256_set1_epi32(static_cast<int>(0xFFFF0000u));
+            for (; x < width; x += 16)
+            {
+                __m256i c = load(r2 + x);
+                __m256i ns = _mm256_add_epi16(load(r1 + x), load(r3 + x));
+                __m256i we = _mm256_add_epi16(load(r2 + x - 1), load(r2 + x + 1));
+                __m256i diag = _mm256_add_epi16(_mm256_add_epi16(load(r1 + x - 1), load(r1 + x + 1)),
+                                                _mm256_add_epi16(load(r3 + x - 1), load(r3 + x + 1)));
+                __m256i vC = _mm256_slli_epi16(c, 4);
+                __m256i vG, vH, vV, vD;
+                if (mhc)
+                {
+                    __m256i nnss = _mm256_add_epi16(load(r0 + x), load(r4 + x));
+                    __m256i wwee = _mm256_add_epi16(load(r2 + x - 2), load(r2 + x + 2));
+                    __m256i c8 = _mm256_slli_epi16(c, 3);
+                    __m256i c10 = _mm256_add_epi16(c8, _mm256_add_epi16(c, c));
+                    __m256i diag2 = _mm256_add_epi16(diag, diag);
+                    __m256i far = _mm256_add_epi16(nnss, wwee);
+                    vG = _mm256_sub_epi16(_mm256_add_epi16(c8, _mm256_slli_epi16(_mm256_add_epi16(ns, we), 2)), _mm256_add_epi16(far, far));
+                    vH = _mm256_add_epi16(_mm256_sub_epi16(_mm256_add_epi16(c10, _mm256_slli_epi16(we, 3)), _mm256_add_epi16(diag2, _mm256_add_epi16(wwee, wwee))), nnss);
+                    vV = _mm256_add_epi16(_mm256_sub_epi16(_mm256_add_epi16(c10, _mm256_slli_epi16(ns, 3)), _mm256_add_epi16(diag2, _mm256_add_epi16(nnss, nnss))), wwee);
+                    vD = _mm256_sub_epi16(_mm256_add_epi16(_mm256_add_epi16(c8, _mm256_slli_epi16(c, 2)), _mm256_slli_epi16(diag, 2)),
+                                          _mm256_add_epi16(far, _mm256_add_epi16(far, far)));
+                }
+                else
+                {
+                    vG = _mm256_slli_epi16(_mm256_add_epi16(ns, we), 2);
+                    vH = _mm256_slli_epi16(we, 3);
+                    vV = _mm256_slli_epi16(ns, 3);
+                    vD = _mm256_slli_epi16(diag, 2);
+                }
+                store(primary + x, _mm256_blendv_epi8(vH, vC, site));
+                store(green + x, _mm256_blendv_epi8(vC, vG, site));
+                store(other + x, _mm256_blendv_epi8(vV, vD, site));
+            }
+#elif defined(__SSE2__)
+            auto load = [](const int16_t *p)
+            { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); };
+            auto store = [](unsigned char *p, __m128i v)
+            {
+                v = _mm_srai_epi16(_mm_add_epi16(v, _mm_set1_epi16(8)), 4);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(p), _mm_packus_epi16(v, v));
+            };
+            auto select = [](__m128i mask, __m128i a, __m128i b)
+            { return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b)); };
+            const __m128i site = layout.siteParity == 0 ? _mm_set1_epi32(0x0000FFFF) : _mm_set1_epi32(static_cast<int>(0xFFFF0000u));
+            for (; x < width; x += 8)
+            {
+                __m128i c = load(r2 + x);
+                __m128i ns = _mm_add_epi16(load(r1 + x), load(r3 + x));
+                __m128i we = _mm_add_epi16(load(r2 + x - 1), load(r2 + x + 1));
+                __m128i diag = _mm_add_epi16(_mm_add_epi16(load(r1 + x - 1), load(r1 + x + 1)),
+                                             _mm_add_epi16(load(r3 + x - 1), load(r3 + x + 1)));
+                __m128i vC = _mm_slli_epi16(c, 4);
+                __m128i vG, vH, vV, vD;
+                if (mhc)
+                {
+                    __m128i nnss = _mm_add_epi16(load(r0 + x), load(r4 + x));
+                    __m128i wwee = _mm_add_epi16(load(r2 + x - 2), load(r2 + x + 2));
+                    __m128i c8 = _mm_slli_epi16(c, 3);
+                    __m128i c10 = _mm_add_epi16(c8, _mm_add_epi16(c, c));
+                    __m128i diag2 = _mm_add_epi16(diag, diag);
+                    __m128i far = _mm_add_epi16(nnss, wwee);
+                    vG = _mm_sub_epi16(_mm_add_epi16(c8, _mm_slli_epi16(_mm_add_epi16(ns, we), 2)), _mm_add_epi16(far, far));
+                    vH = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(c10, _mm_slli_epi16(we, 3)), _mm_add_epi16(diag2, _mm_add_epi16(wwee, wwee))), nnss);
+                    vV = _mm_add_epi16(_mm_sub_epi16(_mm_add_epi16(c10, _mm_slli_epi16(ns, 3)), _mm_add_epi16(diag2, _mm_add_epi16(nnss, nnss))), wwee);
+                    vD = _mm_sub_epi16(_mm_add_epi16(_mm_add_epi16(c8, _mm_slli_epi16(c, 2)), _mm_slli_epi16(diag, 2)),
+                                       _mm_add_epi16(far, _mm_add_epi16(far, far)));
+                }
+                else
+                {
+                    vG = _mm_slli_epi16(_mm_add_epi16(ns, we), 2);
+                    vH = _mm_slli_epi16(we, 3);
+                    vV = _mm_slli_epi16(ns, 3);
+                    vD = _mm_slli_epi16(diag, 2);
+                }
+                store(primary + x, select(site, vC, vH));
+                store(green + x, select(site, vG, vC));
+                store(other + x, select(site, vD, vV));
+            }
+#endif
+#endif
+            // 向量循环处理到行缓冲区的余量里，不留尾部
+            for (; x < width; ++x)
+            {
+                int c = r2[x];
+                int ns = r1[x] + r3[x];
+                int we = r2[x - 1] + r2[x + 1];
+                int diag = r1[x - 1] + r1[x + 1] + r3[x - 1] + r3[x + 1];
+                int vG, vH, vV, vD;
+                if (mhc)
+                {
+                    int nnss = r0[x] + r4[x];
+                    int wwee = r2[x - 2] + r2[x + 2];
+                    vG = 8 * c + 4 * (ns + we) - 2 * (nnss + wwee);
+                    vH = 10 * c + 8 * we - 2 * diag - 2 * wwee + nnss;
+                    vV = 10 * c + 8 * ns - 2 * diag - 2 * nnss + wwee;
+                    vD = 12 * c + 4 * diag - 3 * (nnss + wwee);
+                }
+                else
+                {
+                    vG = 4 * (ns + we);
+                    vH = 8 * we;
+                    vV = 8 * ns;
+                    vD = 4 * diag;
+                }
+                auto round = [](int v)
+                { return static_cast<unsigned char>(std::clamp((v + 8) >> 4, 0, 255)); };
+                bool isSite = (x & 1) == layout.siteParity;
+                primary[x] = round(isSite ? 16 * c : vH);
+                green[x] = round(isSite ? vG : 16 * c);
+                other[x] = round(isSite ? vD : vV);
+            }
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::demosaic(BayerPattern pattern, DemosaicMethod method) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot demosaic an empty image");
+        }
+
+        if (channels_ != 1)
+        {
+            std::stringstream ss;
+            ss << "Demosaicing requires a single-channel Bayer image, but got " << channels_ << " channels";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (width_ < 2 || height_ < 2)
+        {
+            std::stringstream ss;
+            ss << "Bayer image must be at least 2x2, but got " << width_ << "x" << height_;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        OptimalImage result(width_, height_, 3);
+        bool mhc = method == DemosaicMethod::MalvarHeCutler;
+        int pixelCount = width_ * height_;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height_) : 1;
+        int rowLength = width_ + 2 * BAYER_RADIUS + BAYER_VEC;
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            int y0 = detail::stripeBegin(height_, stripes, s);
+            int y1 = detail::stripeBegin(height_, stripes, s + 1);
+
+            // 5行环形缓冲区，按虚拟行号（可以超出图像，读取时镜像）取模存放
+            constexpr int RING = 2 * BAYER_RADIUS + 1;
+            std::vector<int16_t> ring(static_cast<size_t>(RING) * rowLength);
+            std::vector<unsigned char> planes(static_cast<size_t>(3) * (width_ + BAYER_VEC));
+            unsigned char *red = planes.data();
+            unsigned char *green = red + width_ + BAYER_VEC;
+            unsigned char *blue = green + width_ + BAYER_VEC;
+            auto slot = [&](int v)
+            { return ring.data() + static_cast<size_t>(((v % RING) + RING) % RING) * rowLength; };
+            auto load = [&](int v)
+            { loadBayerRow(data() + reflect101(v, height_) * step(), width_, slot(v)); };
+
+            for (int v = y0 - BAYER_RADIUS; v < y0 + BAYER_RADIUS; ++v)
+            {
+                load(v);
+            }
+            for (int y = y0; y < y1; ++y)
+            {
+                load(y + BAYER_RADIUS);
+                const int16_t *rows[RING];
+                for (int k = 0; k < RING; ++k)
+                {
+                    rows[k] = slot(y - BAYER_RADIUS + k) + BAYER_RADIUS;
+                }
+
+                demosaicRow(rows, width_, bayerRow(pattern, y), mhc, red, green, blue);
+                const unsigned char *planeRows[3] = {red, green, blue};
+                detail::mergeRow(planeRows, result.data() + y * result.step(), width_, 3);
+            }
+        }
+
+        return result;
+    }
+
+} // namespace mylib
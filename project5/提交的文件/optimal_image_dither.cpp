@@ -0,0 +1,315 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 波前调度中每处理这么多像素发布一次进度，太小则同步开销大，太大则下一行等待时间长
+        constexpr int DITHER_BLOCK = 64;
+
+        /**
+         * @brief 按SIMD友好的布局存储的调色板
+         * 每个颜色的第0、1通道和第2、3通道各打包成一个32位整数（两个int16），
+         * 像素与颜色的差用sub_epi16得到，madd_epi16一次算出两个通道的平方和
+         */
+        struct Palette
+        {
+            int count = 0;                     // 颜色数
+            int cn = 0;                        // 通道数
+            std::vector<unsigned char> colors; // 原始颜色，count × cn
+            std::vector<int32_t> pair01;       // 第0、1通道，长度补齐到8的倍数
+            std::vector<int32_t> pair23;       // 第2、3通道，长度补齐到8的倍数
+            std::vector<int> lookup;           // 单通道时每个灰度值对应的最近颜色，查表代替搜索
+        };
+
+        /**
+         * @brief 单独占一个缓存行的行进度，相邻行的进度由不同线程频繁写入，避免伪共享
+         */
+        struct alignas(64) RowProgress
+        {
+            std::atomic<int> done; // 已完成的像素数
+        };
+
+        Palette buildPalette(const std::vector<unsigned char> &colors, int cn)
+        {
+            Palette palette;
+            palette.count = static_cast<int>(colors.size()) / cn;
+            palette.cn = cn;
+            palette.colors = colors;
+
+            // 补齐的位置重复第0个颜色：距离相同时保留下标较小的，不会被选中
+            int padded = (palette.count + 7) / 8 * 8;
+            palette.pair01.resize(padded);
+            palette.pair23.resize(padded);
+            for (int e = 0; e < padded; ++e)
+            {
+                const unsigned char *c = colors.data() + static_cast<size_t>(e < palette.count ? e : 0) * cn;
+                int v[4] = {0, 0, 0, 0};
+                for (int k = 0; k < std::min(cn, 4); ++k)
+                {
+                    v[k] = c[k];
+                }
+                palette.pair01[e] = v[0] | (v[1] << 16);
+                palette.pair23[e] = v[2] | (v[3] << 16);
+            }
+            return palette;
+        }
+
+        /**
+         * @brief 查找与像素颜色（各通道已饱和到[0, 255]）欧氏距离最近的调色板下标，距离相同时取下标最小的
+         */
+        int nearestColor(const Palette &palette, const int *value)
+        {
+            int cn = palette.cn;
+#ifdef USE_SIMD
+#if defined(__AVX2__) || defined(__SSE2__)
+            if (cn <= 4)
+            {
+                int32_t pix01 = value[0] | (cn > 1 ? value[1] << 16 : 0);
+                int32_t pix23 = cn > 2 ? value[2] | (cn > 3 ? value[3] << 16 : 0) : 0;
+                int padded = static_cast<int>(palette.pair01.size());
+                alignas(32) int32_t dist[8];
+                alignas(32) int32_t index[8];
+#if defined(__AVX2__)
+                constexpr int LANES = 8;
+                const __m256i p01 = _mm256_set1_epi32(pix01);
+                const __m256i p23 = _mm256_set1_epi32(pix23);
+                __m256i best = _mm256_set1_epi32(INT_MAX);
+                __m256i bestIndex = _mm256_setzero_si256();
+                __m256i idx = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+                const __m256i step = _mm256_set1_epi32(8);
+                for (int e = 0; e < padded; e += 8)
+                {
+                    __m256i d = _mm256_sub_epi16(p01, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(palette.pair01.data() + e)));
+                    __m256i sq = _mm256_madd_epi16(d, d);
+                    if (cn > 2)
+                    {
+                        d = _mm256_sub_epi16(p23, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(palette.pair23.data() + e)));
+                        sq = _mm256_add_epi32(sq, _mm256_madd_epi16(d, d));
+                    }
+                    // 严格小于才替换，每个通道内保留先出现的下标
+                    __m256i closer = _mm256_cmpgt_epi32(best, sq);
+                    best = _mm256_min_epi32(best, sq);
+                    bestIndex = _mm256_blendv_epi8(bestIndex, idx, closer);
+                    idx = _mm256_add_epi32(idx, step);
+                }
+                _mm256_store_si256(reinterpret_cast<__m256i *>(dist), best);
+                _mm256_store_si256(reinterpret_cast<__m256i *>(index), bestIndex);
+#else
+                constexpr int LANES = 4;
+                const __m128i p01 = _mm_set1_epi32(pix01);
+                const __m128i p23 = _mm_set1_epi32(pix23);
+                __m128i best = _mm_set1_epi32(INT_MAX);
+                __m128i bestIndex = _mm_setzero_si128();
+                __m128i idx = _mm_setr_epi32(0, 1, 2, 3);
+                const __m128i step = _mm_set1_epi32(4);
+                for (int e = 0; e < padded; e += 4)
+                {
+                    __m128i d = _mm_sub_epi16(p01, _mm_loadu_si128(reinterpret_cast<const __m128i *>(palette.pair01.data() + e)));
+                    __m128i sq = _mm_madd_epi16(d, d);
+                    if (cn > 2)
+                    {
+                        d = _mm_sub_epi16(p23, _mm_loadu_si128(reinterpret_cast<const __m128i *>(palette.pair23.data() + e)));
+                        sq = _mm_add_epi32(sq, _mm_madd_epi16(d, d));
+                    }
+                    __m128i closer = _mm_cmpgt_epi32(best, sq);
+                    best = _mm_or_si128(_mm_and_si128(closer, sq), _mm_andnot_si128(closer, best));
+                    bestIndex = _mm_or_si128(_mm_and_si128(closer, idx), _mm_andnot_si128(closer, bestIndex));
+                    idx = _mm_add_epi32(idx, step);
+                }
+                _mm_store_si128(reinterpret_cast<__m128i *>(dist), best);
+                _mm_store_si128(reinterpret_cast<__m128i *>(index), bestIndex);
+#endif
+                int result = index[0];
+                int resultDist = dist[0];
+                for (int k = 1; k < LANES; ++k)
+                {
+                    if (dist[k] < resultDist || (dist[k] == resultDist && index[k] < result))
+                    {
+                        result = index[k];
+                        resultDist = dist[k];
+                    }
+                }
+                return result;
+            }
+#endif
+#endif
+            int result = 0;
+            long long resultDist = LLONG_MAX;
+            for (int e = 0; e < palette.count; ++e)
+            {
+                const unsigned char *c = palette.colors.data() + static_cast<size_t>(e) * cn;
+                long long d = 0;
+                for (int k = 0; k < cn; ++k)
+                {
+                    long long diff = value[k] - c[k];
+                    d += diff * diff;
+                }
+                if (d < resultDist)
+                {
+                    resultDist = d;
+                    result = e;
+                }
+            }
+            return result;
+        }
+
+        /**
+         * @brief Floyd-Steinberg误差扩散的共享状态
+         * 误差以1/16为单位存成整数。第y行从errors[y & 1]读取上一行扩散来的误差（读完清零），
+         * 并向errors[(y + 1) & 1]写入下一行的误差。两个缓冲区足够：第y行读errors[y & 1]时，
+         * 第y - 1行只写在它前面的位置，第y + 1行（为第y + 2行）只写在它已经读过并清零的位置
+         */
+        struct DitherState
+        {
+            const OptimalImage *src = nullptr;
+            OptimalImage *dst = nullptr;
+            const Palette *palette = nullptr;
+            std::vector<int> errors[2];
+            std::unique_ptr<RowProgress[]> progress;
+        };
+
+        /**
+         * @brief 处理一行：每DITHER_BLOCK个像素前等待上一行至少领先到块尾之后一个像素（左下、正下、右下的误差都已到齐），
+         * 处理完后发布本行进度
+         */
+        void ditherRow(DitherState &state, int y)
+        {
+            const OptimalImage &src = *state.src;
+            const Palette &palette = *state.palette;
+            int width = src.width();
+            int cn = src.channels();
+            const unsigned char *in = src.data() + y * src.step();
+            unsigned char *out = state.dst->data() + y * state.dst->step();
+            int *incoming = state.errors[y & 1].data();
+            int *outgoing = state.errors[(y + 1) & 1].data();
+            bool hasNext = y + 1 < src.height();
+
+            std::vector<int> carry(cn, 0);
+            std::vector<int> value(cn);
+            for (int x0 = 0; x0 < width; x0 += DITHER_BLOCK)
+            {
+                int x1 = std::min(width, x0 + DITHER_BLOCK);
+                if (y > 0)
+                {
+                    int need = std::min(width, x1 + 1);
+                    while (state.progress[y - 1].done.load(std::memory_order_acquire) < need)
+                    {
+                        std::this_thread::yield();
+                    }
+                }
+
+                for (int x = x0; x < x1; ++x)
+                {
+                    int *acc = incoming + static_cast<size_t>(x) * cn;
+                    for (int c = 0; c < cn; ++c)
+                    {
+                        // 算术右移对负误差向下取整，各平台结果一致
+                        value[c] = std::clamp(in[x * cn + c] + ((acc[c] + carry[c] + 8) >> 4), 0, 255);
+                        acc[c] = 0;
+                    }
+
+                    int e = cn == 1 ? palette.lookup[value[0]] : nearestColor(palette, value.data());
+                    const unsigned char *color = palette.colors.data() + static_cast<size_t>(e) * cn;
+                    std::copy(color, color + cn, out + x * cn);
+
+                    // 右7/16，左下3/16，正下5/16，右下1/16；超出图像边界的部分丢弃
+                    int *below = outgoing + static_cast<size_t>(x) * cn;
+                    for (int c = 0; c < cn; ++c)
+                    {
+                        int err = value[c] - color[c];
+                        carry[c] = x + 1 < width ? 7 * err : 0;
+                        if (hasNext)
+                        {
+                            if (x > 0)
+                            {
+                                below[c - cn] += 3 * err;
+                            }
+                            below[c] += 5 * err;
+                            if (x + 1 < width)
+                            {
+                                below[c + cn] += err;
+                            }
+                        }
+                    }
+                }
+
+                state.progress[y].done.store(x1, std::memory_order_release);
+            }
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::ditherErrorDiffusion(const std::vector<unsigned char> &palette) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot dither an empty image");
+        }
+
+        if (palette.empty() || palette.size() % channels_ != 0)
+        {
+            std::stringstream ss;
+            ss << "Palette size must be a positive multiple of the channel count " << channels_
+               << ", but got " << palette.size();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        Palette packed = buildPalette(palette, channels_);
+        if (channels_ == 1)
+        {
+            packed.lookup.resize(256);
+            for (int v = 0; v < 256; ++v)
+            {
+                packed.lookup[v] = nearestColor(packed, &v);
+            }
+        }
+        OptimalImage result(width_, height_, channels_);
+
+        DitherState state;
+        state.src = this;
+        state.dst = &result;
+        state.palette = &packed;
+        state.errors[0].assign(static_cast<size_t>(width_) * channels_, 0);
+        state.errors[1].assign(static_cast<size_t>(width_) * channels_, 0);
+        state.progress.reset(new RowProgress[height_]);
+        for (int y = 0; y < height_; ++y)
+        {
+            state.progress[y].done.store(0, std::memory_order_relaxed);
+        }
+
+        // 波前调度：行轮流分给各线程，每行只比上一行落后约一个块，所有线程同时在相邻的行上推进。
+        // 每行只依赖上一行，上一行总能先完成，因此不会死锁；结果与串行扫描逐位相同
+        int pixelCount = width_ * height_;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height_) : 1;
+
+#pragma omp parallel for schedule(static, 1) num_threads(stripes) if (stripes > 1)
+        for (int y = 0; y < height_; ++y)
+        {
+            ditherRow(state, y);
+        }
+
+        return result;
+    }
+
+} // namespace mylib
@@ -0,0 +1,524 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        /**
+         * @brief 3抽头核：out = k0 * p[-1] + k1 * p[0] + k2 * p[1]
+         */
+        struct Kernel3
+        {
+            short k0;
+            short k1;
+            short k2;
+        };
+
+        constexpr Kernel3 SOBEL_SMOOTH = {1, 2, 1};
+        constexpr Kernel3 SCHARR_SMOOTH = {3, 10, 3};
+        constexpr Kernel3 DERIVATIVE = {-1, 0, 1};
+
+        // 方向量化：tan(22.5°)的Q15定点值
+        constexpr int CANNY_SHIFT = 15;
+        constexpr int CANNY_TG22 = static_cast<int>(0.4142135623730950488 * (1 << CANNY_SHIFT) + 0.5);
+
+        // 非极大值抑制的结果
+        constexpr unsigned char EDGE_NONE = 0;
+        constexpr unsigned char EDGE_WEAK = 1;
+        constexpr unsigned char EDGE_STRONG = 2;
+
+        /**
+         * @brief 垂直方向3抽头：dst[i] = k0 * r0[i] + k1 * r1[i] + k2 * r2[i]，结果不超出16位
+         */
+        void verticalPass(const unsigned char *r0, const unsigned char *r1, const unsigned char *r2, int n,
+                          Kernel3 k, int16_t *dst)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            __m256i k0 = _mm256_set1_epi16(k.k0);
+            __m256i k1 = _mm256_set1_epi16(k.k1);
+            __m256i k2 = _mm256_set1_epi16(k.k2);
+            for (; i <= n - 16; i += 16)
+            {
+                __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + i)));
+                __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + i)));
+                __m256i c = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r2 + i)));
+                __m256i s = _mm256_add_epi16(_mm256_mullo_epi16(a, k0), _mm256_mullo_epi16(c, k2));
+                s = _mm256_add_epi16(s, _mm256_mullo_epi16(b, k1));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), s);
+            }
+#elif defined(__SSE2__)
+            __m128i zero = _mm_setzero_si128();
+            __m128i k0 = _mm_set1_epi16(k.k0);
+            __m128i k1 = _mm_set1_epi16(k.k1);
+            __m128i k2 = _mm_set1_epi16(k.k2);
+            for (; i <= n - 8; i += 8)
+            {
+                __m128i a = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r0 + i)), zero);
+                __m128i b = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r1 + i)), zero);
+                __m128i c = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r2 + i)), zero);
+                __m128i s = _mm_add_epi16(_mm_mullo_epi16(a, k0), _mm_mullo_epi16(c, k2));
+                s = _mm_add_epi16(s, _mm_mullo_epi16(b, k1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), s);
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                dst[i] = static_cast<int16_t>(k.k0 * r0[i] + k.k1 * r1[i] + k.k2 * r2[i]);
+            }
+        }
+
+        /**
+         * @brief 水平方向3抽头：dst[i] = k0 * src[i - cn] + k1 * src[i] + k2 * src[i + cn]
+         * @param src 第一个元素的地址，src[-cn]和src[n - 1 + cn]必须可读
+         */
+        void horizontalPass(const int16_t *src, int n, int cn, Kernel3 k, int16_t *dst)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            __m256i k0 = _mm256_set1_epi16(k.k0);
+            __m256i k1 = _mm256_set1_epi16(k.k1);
+            __m256i k2 = _mm256_set1_epi16(k.k2);
+            for (; i <= n - 16; i += 16)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i - cn));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + cn));
+                __m256i s = _mm256_add_epi16(_mm256_mullo_epi16(a, k0), _mm256_mullo_epi16(c, k2));
+                s = _mm256_add_epi16(s, _mm256_mullo_epi16(b, k1));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), s);
+            }
+#elif defined(__SSE2__)
+            __m128i k0 = _mm_set1_epi16(k.k0);
+            __m128i k1 = _mm_set1_epi16(k.k1);
+            __m128i k2 = _mm_set1_epi16(k.k2);
+            for (; i <= n - 8; i += 8)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i - cn));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + cn));
+                __m128i s = _mm_add_epi16(_mm_mullo_epi16(a, k0), _mm_mullo_epi16(c, k2));
+                s = _mm_add_epi16(s, _mm_mullo_epi16(b, k1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), s);
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                dst[i] = static_cast<int16_t>(k.k0 * src[i - cn] + k.k1 * src[i] + k.k2 * src[i + cn]);
+            }
+        }
+
+        /**
+         * @brief 计算一行的可分离3x3滤波结果，上下左右边界复制填充
+         * @param tmp 垂直方向的中间结果，大小至少(width + 2) × channels
+         * @param dst 输出行，width × channels
+         */
+        void filterRow3(const OptimalImage &src, int y, Kernel3 kv, Kernel3 kh, int16_t *tmp, int16_t *dst)
+        {
+            int cn = src.channels();
+            int n = src.width() * cn;
+            int last = src.height() - 1;
+            const unsigned char *r0 = src.data() + std::max(y - 1, 0) * src.step();
+            const unsigned char *r1 = src.data() + y * src.step();
+            const unsigned char *r2 = src.data() + std::min(y + 1, last) * src.step();
+
+            verticalPass(r0, r1, r2, n, kv, tmp + cn);
+            for (int c = 0; c < cn; ++c)
+            {
+                tmp[c] = tmp[cn + c];
+                tmp[n + cn + c] = tmp[n + c];
+            }
+            horizontalPass(tmp + cn, n, cn, kh, dst);
+        }
+
+        ImageBuffer<int16_t> derivative(const OptimalImage &src, int dx, int dy, Kernel3 smooth)
+        {
+            Kernel3 kv = dy ? DERIVATIVE : smooth;
+            Kernel3 kh = dx ? DERIVATIVE : smooth;
+
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            ImageBuffer<int16_t> result(width, height, cn);
+            int stripes = detail::stripeCount(height);
+            int pixelCount = width * height;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int s = 0; s < stripes; ++s)
+            {
+                int y0 = detail::stripeBegin(height, stripes, s);
+                int y1 = detail::stripeBegin(height, stripes, s + 1);
+                std::vector<int16_t> tmp(static_cast<size_t>(width + 2) * cn);
+                for (int y = y0; y < y1; ++y)
+                {
+                    filterRow3(src, y, kv, kh, tmp.data(), result.row(y));
+                }
+            }
+
+            return result;
+        }
+
+        void checkDerivativeOrder(const OptimalImage &img, int dx, int dy, bool firstOrderOnly, const char *operation)
+        {
+            if (img.empty())
+            {
+                std::stringstream ss;
+                ss << "Cannot apply " << operation << " to an empty image";
+                throw OperationFailedException(ss.str());
+            }
+
+            bool valid = dx >= 0 && dy >= 0 && dx <= 1 && dy <= 1 && dx + dy >= 1;
+            if (!valid || (firstOrderOnly && dx + dy != 1))
+            {
+                std::stringstream ss;
+                ss << "Unsupported derivative order for " << operation << ": dx=" << dx << ", dy=" << dy;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        /**
+         * @brief Canny的一行梯度：每个像素的gx、gy和幅值（多通道取幅值最大的通道）
+         * @param mag 幅值行，mag[-1]和mag[width]保持为0，作为非极大值抑制的左右边界
+         */
+        void cannyGradientRow(const OptimalImage &src, int y, bool L2gradient,
+                              int16_t *tmp, int16_t *gxRow, int16_t *gyRow, int16_t *pixelGx, int16_t *pixelGy, int *mag)
+        {
+            int width = src.width();
+            int cn = src.channels();
+            filterRow3(src, y, SOBEL_SMOOTH, DERIVATIVE, tmp, gxRow);
+            filterRow3(src, y, DERIVATIVE, SOBEL_SMOOTH, tmp, gyRow);
+
+            if (cn > 1)
+            {
+                for (int x = 0; x < width; ++x)
+                {
+                    int best = -1;
+                    for (int c = 0; c < cn; ++c)
+                    {
+                        int gx = gxRow[x * cn + c];
+                        int gy = gyRow[x * cn + c];
+                        int m = L2gradient ? gx * gx + gy * gy : std::abs(gx) + std::abs(gy);
+                        if (m > best)
+                        {
+                            best = m;
+                            pixelGx[x] = static_cast<int16_t>(gx);
+                            pixelGy[x] = static_cast<int16_t>(gy);
+                        }
+                    }
+                    mag[x] = best;
+                }
+                return;
+            }
+
+            std::memcpy(pixelGx, gxRow, width * sizeof(int16_t));
+            std::memcpy(pixelGy, gyRow, width * sizeof(int16_t));
+
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; x <= width - 16; x += 16)
+            {
+                __m256i gx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(gxRow + x));
+                __m256i gy = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(gyRow + x));
+                __m256i lo, hi;
+                if (L2gradient)
+                {
+                    // 交错(gx, gy)后与自身madd得到gx^2 + gy^2
+                    __m256i a = _mm256_unpacklo_epi16(gx, gy);
+                    __m256i b = _mm256_unpackhi_epi16(gx, gy);
+                    lo = _mm256_madd_epi16(a, a);
+                    hi = _mm256_madd_epi16(b, b);
+                }
+                else
+                {
+                    __m256i m = _mm256_add_epi16(_mm256_abs_epi16(gx), _mm256_abs_epi16(gy));
+                    lo = _mm256_unpacklo_epi16(m, _mm256_setzero_si256());
+                    hi = _mm256_unpackhi_epi16(m, _mm256_setzero_si256());
+                }
+                // unpack在128位通道内交错，重新排列回像素顺序
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(mag + x), _mm256_permute2x128_si256(lo, hi, 0x20));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(mag + x + 8), _mm256_permute2x128_si256(lo, hi, 0x31));
+            }
+#elif defined(__SSE2__)
+            __m128i zero = _mm_setzero_si128();
+            for (; x <= width - 8; x += 8)
+            {
+                __m128i gx = _mm_loadu_si128(reinterpret_cast<const __m128i *>(gxRow + x));
+                __m128i gy = _mm_loadu_si128(reinterpret_cast<const __m128i *>(gyRow + x));
+                __m128i lo, hi;
+                if (L2gradient)
+                {
+                    __m128i a = _mm_unpacklo_epi16(gx, gy);
+                    __m128i b = _mm_unpackhi_epi16(gx, gy);
+                    lo = _mm_madd_epi16(a, a);
+                    hi = _mm_madd_epi16(b, b);
+                }
+                else
+                {
+                    __m128i ax = _mm_max_epi16(gx, _mm_sub_epi16(zero, gx));
+                    __m128i ay = _mm_max_epi16(gy, _mm_sub_epi16(zero, gy));
+                    __m128i m = _mm_add_epi16(ax, ay);
+                    lo = _mm_unpacklo_epi16(m, zero);
+                    hi = _mm_unpackhi_epi16(m, zero);
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(mag + x), lo);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(mag + x + 4), hi);
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                int gx = gxRow[x];
+                int gy = gyRow[x];
+                mag[x] = L2gradient ? gx * gx + gy * gy : std::abs(gx) + std::abs(gy);
+            }
+        }
+
+        /**
+         * @brief 从栈中的强边缘像素出发，沿8邻域把弱边缘提升为强边缘
+         * 只修改索引范围[lo, hi)内的像素，范围外的邻居记录到outbox，留给后续阶段处理
+         */
+        void hysteresisGrow(std::vector<unsigned char> &map, int mapStep, std::vector<int> &stack,
+                            int lo, int hi, std::vector<int> &outbox)
+        {
+            const int offsets[8] = {-mapStep - 1, -mapStep, -mapStep + 1, -1, 1, mapStep - 1, mapStep, mapStep + 1};
+            while (!stack.empty())
+            {
+                int p = stack.back();
+                stack.pop_back();
+                for (int k = 0; k < 8; ++k)
+                {
+                    int q = p + offsets[k];
+                    if (q < lo || q >= hi)
+                    {
+                        outbox.push_back(q);
+                    }
+                    else if (map[q] == EDGE_WEAK)
+                    {
+                        map[q] = EDGE_STRONG;
+                        stack.push_back(q);
+                    }
+                }
+            }
+        }
+    } // namespace
+
+    ImageBuffer<int16_t> OptimalImage::sobel(int dx, int dy) const
+    {
+        checkDerivativeOrder(*this, dx, dy, false, "Sobel operator");
+        return derivative(*this, dx, dy, SOBEL_SMOOTH);
+    }
+
+    ImageBuffer<int16_t> OptimalImage::scharr(int dx, int dy) const
+    {
+        checkDerivativeOrder(*this, dx, dy, true, "Scharr operator");
+        return derivative(*this, dx, dy, SCHARR_SMOOTH);
+    }
+
+    OptimalImage OptimalImage::canny(double lowThreshold, double highThreshold, bool L2gradient) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply Canny edge detection to an empty image");
+        }
+
+        if (lowThreshold < 0 || highThreshold < 0)
+        {
+            std::stringstream ss;
+            ss << "Canny thresholds must be non-negative, but got " << lowThreshold << " and " << highThreshold;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (lowThreshold > highThreshold)
+        {
+            std::swap(lowThreshold, highThreshold);
+        }
+
+        // L2幅值以平方形式比较，避免开方
+        if (L2gradient)
+        {
+            lowThreshold = std::min(lowThreshold * lowThreshold, 1e9);
+            highThreshold = std::min(highThreshold * highThreshold, 1e9);
+        }
+        int low = static_cast<int>(std::floor(lowThreshold));
+        int high = static_cast<int>(std::floor(highThreshold));
+
+        // 边缘标记图四周各留一圈0，扩展时不需要判断越界
+        int mapStep = width_ + 2;
+        std::vector<unsigned char> map(static_cast<size_t>(mapStep) * (height_ + 2), EDGE_NONE);
+
+        int stripes = detail::stripeCount(height_);
+        std::vector<std::vector<int>> outboxes(stripes);
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int s = 0; s < stripes; ++s)
+        {
+            int y0 = detail::stripeBegin(height_, stripes, s);
+            int y1 = detail::stripeBegin(height_, stripes, s + 1);
+
+            std::vector<int16_t> tmp(static_cast<size_t>(width_ + 2) * channels_);
+            std::vector<int16_t> gxRow(static_cast<size_t>(width_) * channels_);
+            std::vector<int16_t> gyRow(static_cast<size_t>(width_) * channels_);
+
+            // 3行环形缓冲：像素梯度与幅值（幅值行两端各有一个0）
+            std::vector<int16_t> pixelGx(3 * static_cast<size_t>(width_));
+            std::vector<int16_t> pixelGy(3 * static_cast<size_t>(width_));
+            std::vector<int> mag(3 * static_cast<size_t>(width_ + 2), 0);
+            auto slot = [](int y) { return (y + 3) % 3; };
+
+            auto computeRow = [&](int y)
+            {
+                int k = slot(y);
+                int *m = mag.data() + k * (width_ + 2) + 1;
+                if (y < 0 || y >= height_)
+                {
+                    std::fill(m, m + width_, 0);
+                    return;
+                }
+                cannyGradientRow(*this, y, L2gradient, tmp.data(), gxRow.data(), gyRow.data(),
+                                 pixelGx.data() + k * width_, pixelGy.data() + k * width_, m);
+            };
+
+            std::vector<int> stack;
+            computeRow(y0 - 1);
+            computeRow(y0);
+            for (int y = y0; y < y1; ++y)
+            {
+                computeRow(y + 1);
+
+                const int *prev = mag.data() + slot(y - 1) * (width_ + 2) + 1;
+                const int *cur = mag.data() + slot(y) * (width_ + 2) + 1;
+                const int *next = mag.data() + slot(y + 1) * (width_ + 2) + 1;
+                const int16_t *gxs = pixelGx.data() + slot(y) * width_;
+                const int16_t *gys = pixelGy.data() + slot(y) * width_;
+                unsigned char *mapRow = map.data() + static_cast<size_t>(y + 1) * mapStep + 1;
+
+                for (int x = 0; x < width_; ++x)
+                {
+                    int m = cur[x];
+                    if (m <= low)
+                    {
+                        continue;
+                    }
+
+                    // 按梯度方向量化为水平、垂直和两个对角方向，只与该方向上的两个邻居比较
+                    int gx = gxs[x];
+                    int gy = gys[x];
+                    int ax = std::abs(gx);
+                    int ay = std::abs(gy) << CANNY_SHIFT;
+                    int tg22x = ax * CANNY_TG22;
+                    bool isMax;
+                    if (ay < tg22x)
+                    {
+                        isMax = m > cur[x - 1] && m >= cur[x + 1];
+                    }
+                    else
+                    {
+                        int tg67x = tg22x + (ax << (CANNY_SHIFT + 1));
+                        if (ay > tg67x)
+                        {
+                            isMax = m > prev[x] && m >= next[x];
+                        }
+                        else
+                        {
+                            int sgn = (gx ^ gy) < 0 ? -1 : 1;
+                            isMax = m > prev[x - sgn] && m > next[x + sgn];
+                        }
+                    }
+
+                    if (isMax)
+                    {
+                        if (m > high)
+                        {
+                            mapRow[x] = EDGE_STRONG;
+                            stack.push_back(static_cast<int>((y + 1) * mapStep + x + 1));
+                        }
+                        else
+                        {
+                            mapRow[x] = EDGE_WEAK;
+                        }
+                    }
+                }
+            }
+
+            // 条带内的滞后扩展：只修改本条带的行，越过条带边界的邻居留到下一阶段
+            hysteresisGrow(map, mapStep, stack, (y0 + 1) * mapStep, (y1 + 1) * mapStep, outboxes[s]);
+        }
+
+        // 从条带边界继续扩展，此时各条带内部已经处理完，剩余的工作量很小
+        std::vector<int> stack;
+        std::vector<int> unused;
+        int mapSize = static_cast<int>(map.size());
+        for (int s = 0; s < stripes; ++s)
+        {
+            for (int q : outboxes[s])
+            {
+                if (map[q] == EDGE_WEAK)
+                {
+                    map[q] = EDGE_STRONG;
+                    stack.push_back(q);
+                    hysteresisGrow(map, mapStep, stack, 0, mapSize, unused);
+                }
+            }
+        }
+
+        OptimalImage result(width_, height_, 1);
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            const unsigned char *src = map.data() + static_cast<size_t>(y + 1) * mapStep + 1;
+            unsigned char *dst = result.data() + y * result.step();
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            __m256i strong = _mm256_set1_epi8(EDGE_STRONG);
+            for (; x <= width_ - 32; x += 32)
+            {
+                __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + x), _mm256_cmpeq_epi8(v, strong));
+            }
+#elif defined(__SSE2__)
+            __m128i strong = _mm_set1_epi8(EDGE_STRONG);
+            for (; x <= width_ - 16; x += 16)
+            {
+                __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_cmpeq_epi8(v, strong));
+            }
+#endif
+#endif
+            for (; x < width_; ++x)
+            {
+                dst[x] = src[x] == EDGE_STRONG ? 255 : 0;
+            }
+        }
+
+        return result;
+    }
+
+} // namespace mylib
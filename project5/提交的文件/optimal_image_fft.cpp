@@ -0,0 +1,802 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        const double PI = 3.14159265358979323846;
+
+        // 列变换时每次处理的列数，保证一个列块的工作集能放进L2缓存
+        constexpr int FFT_COLUMN_BLOCK = 16;
+
+        // 相位相关中归一化互功率谱时防止除零的下限
+        constexpr float PHASE_EPS = 1e-12f;
+
+        /**
+         * @brief 交错存储的单精度复数，与SIMD寄存器中的(re, im)布局一致
+         */
+        struct Complex
+        {
+            float re;
+            float im;
+        };
+
+        inline Complex cmul(Complex a, Complex b)
+        {
+            return {a.re * b.re - a.im * b.im, a.re * b.im + a.im * b.re};
+        }
+
+        inline Complex cconj(Complex a)
+        {
+            return {a.re, -a.im};
+        }
+
+        /**
+         * @brief 混合基数FFT的一级：基数radix以及该级所有旋转因子 twiddles[p * radix + j] = exp(-2πi * j * p / n)
+         */
+        struct FFTStage
+        {
+            int radix;
+            std::vector<Complex> twiddles;
+            std::vector<Complex> roots; // radix点DFT的单位根 exp(-2πi * k / radix)
+        };
+
+        /**
+         * @brief 长度为n的FFT计划，按4、2、3、5及其余素数分解
+         */
+        struct FFTPlan
+        {
+            int n;
+            std::vector<FFTStage> stages;
+        };
+
+        std::shared_ptr<const FFTPlan> createPlan(int n)
+        {
+            auto plan = std::make_shared<FFTPlan>();
+            plan->n = n;
+
+            std::vector<int> radices;
+            int rest = n;
+            while (rest % 4 == 0)
+            {
+                radices.push_back(4);
+                rest /= 4;
+            }
+            while (rest % 2 == 0)
+            {
+                radices.push_back(2);
+                rest /= 2;
+            }
+            for (int p = 3; p * p <= rest; p += 2)
+            {
+                while (rest % p == 0)
+                {
+                    radices.push_back(p);
+                    rest /= p;
+                }
+            }
+            if (rest > 1)
+            {
+                radices.push_back(rest);
+            }
+
+            int length = n;
+            for (int radix : radices)
+            {
+                FFTStage stage;
+                stage.radix = radix;
+                int m = length / radix;
+                stage.twiddles.resize(static_cast<size_t>(m) * radix);
+                for (int p = 0; p < m; ++p)
+                {
+                    for (int j = 0; j < radix; ++j)
+                    {
+                        double angle = -2.0 * PI * static_cast<double>(j) * p / length;
+                        stage.twiddles[static_cast<size_t>(p) * radix + j] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+                    }
+                }
+                stage.roots.resize(radix);
+                for (int k = 0; k < radix; ++k)
+                {
+                    double angle = -2.0 * PI * k / radix;
+                    stage.roots[k] = {static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle))};
+                }
+                plan->stages.push_back(std::move(stage));
+                length = m;
+            }
+            return plan;
+        }
+
+        /**
+         * @brief 获取长度为n的FFT计划，旋转因子按长度缓存，多线程下安全
+         */
+        std::shared_ptr<const FFTPlan> getPlan(int n)
+        {
+            static std::mutex mutex;
+            static std::map<int, std::shared_ptr<const FFTPlan>> cache;
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = cache.find(n);
+            if (it != cache.end())
+            {
+                return it->second;
+            }
+            auto plan = createPlan(n);
+            cache.emplace(n, plan);
+            return plan;
+        }
+
+#if defined(USE_SIMD) && defined(__AVX2__)
+        // 4个交错复数的SIMD运算
+        inline __m256 cmulBroadcast(__m256 v, Complex w)
+        {
+            __m256 t1 = _mm256_mul_ps(v, _mm256_set1_ps(w.re));
+            __m256 t2 = _mm256_mul_ps(_mm256_permute_ps(v, 0xB1), _mm256_set1_ps(w.im));
+            return _mm256_addsub_ps(t1, t2);
+        }
+
+        // 乘以-i：(re, im) -> (im, -re)
+        inline __m256 mulNegI(__m256 v)
+        {
+            const __m256 sign = _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f);
+            return _mm256_xor_ps(_mm256_permute_ps(v, 0xB1), sign);
+        }
+#endif
+
+        /**
+         * @brief 基2蝶形：对u∈[0, count)，a_k = in[k * inStride + u]，输出 out[j * outStride + u] = DFT_j * tw[j]
+         */
+        void butterfly2(const Complex *in, size_t inStride, Complex *out, size_t outStride, int count, Complex w)
+        {
+            int u = 0;
+#if defined(USE_SIMD) && defined(__AVX2__)
+            for (; u <= count - 4; u += 4)
+            {
+                __m256 a = _mm256_loadu_ps(reinterpret_cast<const float *>(in + u));
+                __m256 b = _mm256_loadu_ps(reinterpret_cast<const float *>(in + inStride + u));
+                _mm256_storeu_ps(reinterpret_cast<float *>(out + u), _mm256_add_ps(a, b));
+                _mm256_storeu_ps(reinterpret_cast<float *>(out + outStride + u), cmulBroadcast(_mm256_sub_ps(a, b), w));
+            }
+#endif
+            for (; u < count; ++u)
+            {
+                Complex a = in[u];
+                Complex b = in[inStride + u];
+                out[u] = {a.re + b.re, a.im + b.im};
+                out[outStride + u] = cmul({a.re - b.re, a.im - b.im}, w);
+            }
+        }
+
+        /**
+         * @brief 基4蝶形，正变换中的旋转使用-i，逆变换使用+i
+         */
+        void butterfly4(const Complex *in, size_t inStride, Complex *out, size_t outStride, int count,
+                        const Complex *tw, bool inverse)
+        {
+            int u = 0;
+#if defined(USE_SIMD) && defined(__AVX2__)
+            for (; u <= count - 4; u += 4)
+            {
+                __m256 a0 = _mm256_loadu_ps(reinterpret_cast<const float *>(in + u));
+                __m256 a1 = _mm256_loadu_ps(reinterpret_cast<const float *>(in + inStride + u));
+                __m256 a2 = _mm256_loadu_ps(reinterpret_cast<const float *>(in + 2 * inStride + u));
+                __m256 a3 = _mm256_loadu_ps(reinterpret_cast<const float *>(in + 3 * inStride + u));
+
+                __m256 s02 = _mm256_add_ps(a0, a2);
+                __m256 d02 = _mm256_sub_ps(a0, a2);
+                __m256 s13 = _mm256_add_ps(a1, a3);
+                __m256 d13 = mulNegI(_mm256_sub_ps(a1, a3));
+                if (inverse)
+                {
+                    d13 = _mm256_sub_ps(_mm256_setzero_ps(), d13);
+                }
+
+                _mm256_storeu_ps(reinterpret_cast<float *>(out + u), _mm256_add_ps(s02, s13));
+                _mm256_storeu_ps(reinterpret_cast<float *>(out + outStride + u), cmulBroadcast(_mm256_add_ps(d02, d13), tw[1]));
+                _mm256_storeu_ps(reinterpret_cast<float *>(out + 2 * outStride + u), cmulBroadcast(_mm256_sub_ps(s02, s13), tw[2]));
+                _mm256_storeu_ps(reinterpret_cast<float *>(out + 3 * outStride + u), cmulBroadcast(_mm256_sub_ps(d02, d13), tw[3]));
+            }
+#endif
+            for (; u < count; ++u)
+            {
+                Complex a0 = in[u];
+                Complex a1 = in[inStride + u];
+                Complex a2 = in[2 * inStride + u];
+                Complex a3 = in[3 * inStride + u];
+
+                Complex s02 = {a0.re + a2.re, a0.im + a2.im};
+                Complex d02 = {a0.re - a2.re, a0.im - a2.im};
+                Complex s13 = {a1.re + a3.re, a1.im + a3.im};
+                // d13 = -i * (a1 - a3)（逆变换为 +i）
+                Complex d13 = {a1.im - a3.im, a3.re - a1.re};
+                if (inverse)
+                {
+                    d13 = {-d13.re, -d13.im};
+                }
+
+                out[u] = {s02.re + s13.re, s02.im + s13.im};
+                out[outStride + u] = cmul({d02.re + d13.re, d02.im + d13.im}, tw[1]);
+                out[2 * outStride + u] = cmul({s02.re - s13.re, s02.im - s13.im}, tw[2]);
+                out[3 * outStride + u] = cmul({d02.re - d13.re, d02.im - d13.im}, tw[3]);
+            }
+        }
+
+        /**
+         * @brief 通用基数蝶形（3、5及其他素数），直接计算radix点DFT
+         */
+        void butterflyGeneric(const Complex *in, size_t inStride, Complex *out, size_t outStride, int count,
+                              const Complex *tw, const std::vector<Complex> &roots, bool inverse, Complex *scratch)
+        {
+            int radix = static_cast<int>(roots.size());
+            for (int u = 0; u < count; ++u)
+            {
+                for (int k = 0; k < radix; ++k)
+                {
+                    scratch[k] = in[k * inStride + u];
+                }
+                for (int j = 0; j < radix; ++j)
+                {
+                    Complex sum = scratch[0];
+                    for (int k = 1; k < radix; ++k)
+                    {
+                        Complex root = roots[(static_cast<long long>(j) * k) % radix];
+                        if (inverse)
+                        {
+                            root = cconj(root);
+                        }
+                        Complex t = cmul(scratch[k], root);
+                        sum.re += t.re;
+                        sum.im += t.im;
+                    }
+                    out[j * outStride + u] = cmul(sum, tw[j]);
+                }
+            }
+        }
+
+        /**
+         * @brief 批量复数FFT（Stockham自动排序算法，输出为自然顺序，无需位反转）
+         * 第i个元素占据data[i * batch, (i + 1) * batch)，batch列同时变换，最内层循环连续且可向量化
+         * @param work 与data同样大小的工作缓冲区
+         * @param inverse 是否为逆变换（不做1/n缩放）
+         */
+        void fftTransform(const FFTPlan &plan, Complex *data, Complex *work, int batch, bool inverse)
+        {
+            Complex *src = data;
+            Complex *dst = work;
+            size_t stride = static_cast<size_t>(batch);
+            int length = plan.n;
+            std::vector<Complex> twiddles;
+            std::vector<Complex> scratch;
+
+            for (const FFTStage &stage : plan.stages)
+            {
+                int radix = stage.radix;
+                int m = length / radix;
+                twiddles.resize(radix);
+                scratch.resize(radix);
+
+                for (int p = 0; p < m; ++p)
+                {
+                    const Complex *tw = stage.twiddles.data() + static_cast<size_t>(p) * radix;
+                    for (int j = 0; j < radix; ++j)
+                    {
+                        twiddles[j] = inverse ? cconj(tw[j]) : tw[j];
+                    }
+
+                    const Complex *in = src + stride * p;
+                    Complex *out = dst + stride * radix * p;
+                    int count = static_cast<int>(stride);
+                    if (radix == 4)
+                    {
+                        butterfly4(in, stride * m, out, stride, count, twiddles.data(), inverse);
+                    }
+                    else if (radix == 2)
+                    {
+                        butterfly2(in, stride * m, out, stride, count, twiddles[1]);
+                    }
+                    else
+                    {
+                        butterflyGeneric(in, stride * m, out, stride, count, twiddles.data(), stage.roots, inverse, scratch.data());
+                    }
+                }
+
+                std::swap(src, dst);
+                stride *= radix;
+                length = m;
+            }
+
+            if (src != data)
+            {
+                std::memcpy(data, src, sizeof(Complex) * plan.n * batch);
+            }
+        }
+
+        /**
+         * @brief 实数到复数的二维FFT
+         * 行变换把两行实数打包成一个复数序列同时计算，再拆分出各自的半谱；列变换按列块批量进行
+         * @param in 实数输入，height行 × width列
+         * @param spectrum 输出半谱，height行 × (width / 2 + 1)列
+         */
+        void rfft2D(const float *in, int width, int height, Complex *spectrum)
+        {
+            int cols = width / 2 + 1;
+            int pairs = (height + 1) / 2;
+            auto rowPlan = getPlan(width);
+            auto colPlan = getPlan(height);
+            int pixelCount = width * height;
+
+#pragma omp parallel if (pixelCount > OPTIMIZATION_THRESHOLD)
+            {
+                std::vector<Complex> buffer(width);
+                std::vector<Complex> work(width);
+
+#pragma omp for
+                for (int pair = 0; pair < pairs; ++pair)
+                {
+                    int r0 = 2 * pair;
+                    int r1 = r0 + 1;
+                    const float *a = in + static_cast<size_t>(r0) * width;
+                    const float *b = r1 < height ? in + static_cast<size_t>(r1) * width : nullptr;
+                    for (int x = 0; x < width; ++x)
+                    {
+                        buffer[x] = {a[x], b ? b[x] : 0.0f};
+                    }
+                    fftTransform(*rowPlan, buffer.data(), work.data(), 1, false);
+
+                    // 分离：A_k = (Z_k + conj(Z_{n-k})) / 2，B_k = (Z_k - conj(Z_{n-k})) / 2i
+                    Complex *outA = spectrum + static_cast<size_t>(r0) * cols;
+                    Complex *outB = b ? spectrum + static_cast<size_t>(r1) * cols : nullptr;
+                    for (int k = 0; k < cols; ++k)
+                    {
+                        Complex zk = buffer[k];
+                        Complex zn = buffer[(width - k) % width];
+                        outA[k] = {0.5f * (zk.re + zn.re), 0.5f * (zk.im - zn.im)};
+                        if (outB)
+                        {
+                            outB[k] = {0.5f * (zk.im + zn.im), 0.5f * (zn.re - zk.re)};
+                        }
+                    }
+                }
+
+                std::vector<Complex> block(static_cast<size_t>(height) * FFT_COLUMN_BLOCK);
+                std::vector<Complex> blockWork(block.size());
+                int blocks = (cols + FFT_COLUMN_BLOCK - 1) / FFT_COLUMN_BLOCK;
+
+#pragma omp for
+                for (int blk = 0; blk < blocks; ++blk)
+                {
+                    int c0 = blk * FFT_COLUMN_BLOCK;
+                    int bw = std::min(FFT_COLUMN_BLOCK, cols - c0);
+                    for (int y = 0; y < height; ++y)
+                    {
+                        std::memcpy(block.data() + static_cast<size_t>(y) * bw, spectrum + static_cast<size_t>(y) * cols + c0, sizeof(Complex) * bw);
+                    }
+                    fftTransform(*colPlan, block.data(), blockWork.data(), bw, false);
+                    for (int y = 0; y < height; ++y)
+                    {
+                        std::memcpy(spectrum + static_cast<size_t>(y) * cols + c0, block.data() + static_cast<size_t>(y) * bw, sizeof(Complex) * bw);
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 复数到实数的二维逆FFT（结果已除以width * height），spectrum的内容会被破坏
+         */
+        void irfft2D(Complex *spectrum, int width, int height, float *out)
+        {
+            int cols = width / 2 + 1;
+            int pairs = (height + 1) / 2;
+            auto rowPlan = getPlan(width);
+            auto colPlan = getPlan(height);
+            float scale = 1.0f / (static_cast<float>(width) * height);
+            int pixelCount = width * height;
+
+#pragma omp parallel if (pixelCount > OPTIMIZATION_THRESHOLD)
+            {
+                std::vector<Complex> block(static_cast<size_t>(height) * FFT_COLUMN_BLOCK);
+                std::vector<Complex> blockWork(block.size());
+                int blocks = (cols + FFT_COLUMN_BLOCK - 1) / FFT_COLUMN_BLOCK;
+
+#pragma omp for
+                for (int blk = 0; blk < blocks; ++blk)
+                {
+                    int c0 = blk * FFT_COLUMN_BLOCK;
+                    int bw = std::min(FFT_COLUMN_BLOCK, cols - c0);
+                    for (int y = 0; y < height; ++y)
+                    {
+                        std::memcpy(block.data() + static_cast<size_t>(y) * bw, spectrum + static_cast<size_t>(y) * cols + c0, sizeof(Complex) * bw);
+                    }
+                    fftTransform(*colPlan, block.data(), blockWork.data(), bw, true);
+                    for (int y = 0; y < height; ++y)
+                    {
+                        std::memcpy(spectrum + static_cast<size_t>(y) * cols + c0, block.data() + static_cast<size_t>(y) * bw, sizeof(Complex) * bw);
+                    }
+                }
+
+                std::vector<Complex> buffer(width);
+                std::vector<Complex> work(width);
+
+#pragma omp for
+                for (int pair = 0; pair < pairs; ++pair)
+                {
+                    int r0 = 2 * pair;
+                    int r1 = r0 + 1;
+                    const Complex *specA = spectrum + static_cast<size_t>(r0) * cols;
+                    const Complex *specB = r1 < height ? spectrum + static_cast<size_t>(r1) * cols : nullptr;
+
+                    // 由埃尔米特对称性恢复完整频谱，并合成 Z = A + iB
+                    for (int k = 0; k < width; ++k)
+                    {
+                        Complex a = k < cols ? specA[k] : cconj(specA[width - k]);
+                        Complex b = {0.0f, 0.0f};
+                        if (specB)
+                        {
+                            b = k < cols ? specB[k] : cconj(specB[width - k]);
+                        }
+                        buffer[k] = {a.re - b.im, a.im + b.re};
+                    }
+                    fftTransform(*rowPlan, buffer.data(), work.data(), 1, true);
+
+                    float *outA = out + static_cast<size_t>(r0) * width;
+                    for (int x = 0; x < width; ++x)
+                    {
+                        outA[x] = buffer[x].re * scale;
+                    }
+                    if (specB)
+                    {
+                        float *outB = out + static_cast<size_t>(r1) * width;
+                        for (int x = 0; x < width; ++x)
+                        {
+                            outB[x] = buffer[x].im * scale;
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 将图像的一个通道复制到paddedWidth × paddedHeight的浮点缓冲区，
+         * 缓冲区坐标(x, y)对应原图(x - offsetX, y - offsetY)，越界坐标取最近的边缘像素
+         */
+        void extractChannelPadded(const OptimalImage &img, int channel, int offsetX, int offsetY,
+                                  int paddedWidth, int paddedHeight, float *dst)
+        {
+            const unsigned char *src = img.data();
+            size_t step = img.step();
+            int cn = img.channels();
+            int width = img.width();
+            int height = img.height();
+
+            std::vector<int> xofs(paddedWidth);
+            for (int x = 0; x < paddedWidth; ++x)
+            {
+                xofs[x] = std::clamp(x - offsetX, 0, width - 1) * cn + channel;
+            }
+
+#pragma omp parallel for if (paddedWidth * paddedHeight > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < paddedHeight; ++y)
+            {
+                const unsigned char *row = src + std::clamp(y - offsetY, 0, height - 1) * step;
+                float *out = dst + static_cast<size_t>(y) * paddedWidth;
+                for (int x = 0; x < paddedWidth; ++x)
+                {
+                    out[x] = row[xofs[x]];
+                }
+            }
+        }
+
+        /**
+         * @brief 将浮点缓冲区中从(offsetX, offsetY)开始的区域四舍五入写回图像的一个通道
+         */
+        void storeChannel(const float *src, int srcWidth, int offsetX, int offsetY, float delta,
+                          OptimalImage &img, int channel)
+        {
+            unsigned char *dst = img.data();
+            size_t step = img.step();
+            int cn = img.channels();
+            int width = img.width();
+            int height = img.height();
+
+#pragma omp parallel for if (width * height > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < height; ++y)
+            {
+                const float *row = src + static_cast<size_t>(y + offsetY) * srcWidth + offsetX;
+                unsigned char *out = dst + y * step + channel;
+                for (int x = 0; x < width; ++x)
+                {
+                    long v = std::lrint(row[x] + delta);
+                    out[x * cn] = static_cast<unsigned char>(std::clamp(v, 0L, 255L));
+                }
+            }
+        }
+
+        /**
+         * @brief 转为灰度浮点图并乘以Hanning窗，写入paddedWidth × paddedHeight的缓冲区（其余部分为0）
+         */
+        void windowedGray(const OptimalImage &img, int paddedWidth, float *dst)
+        {
+            int width = img.width();
+            int height = img.height();
+            int cn = img.channels();
+            int colorChannels = std::min(cn, 3);
+            size_t step = img.step();
+            const unsigned char *src = img.data();
+
+            std::vector<float> wx(width, 1.0f);
+            std::vector<float> wy(height, 1.0f);
+            for (int x = 0; width > 1 && x < width; ++x)
+            {
+                wx[x] = static_cast<float>(0.5 * (1.0 - std::cos(2.0 * PI * x / (width - 1))));
+            }
+            for (int y = 0; height > 1 && y < height; ++y)
+            {
+                wy[y] = static_cast<float>(0.5 * (1.0 - std::cos(2.0 * PI * y / (height - 1))));
+            }
+
+#pragma omp parallel for if (width * height > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < height; ++y)
+            {
+                const unsigned char *row = src + y * step;
+                float *out = dst + static_cast<size_t>(y) * paddedWidth;
+                for (int x = 0; x < width; ++x)
+                {
+                    int sum = 0;
+                    for (int c = 0; c < colorChannels; ++c)
+                    {
+                        sum += row[x * cn + c];
+                    }
+                    out[x] = static_cast<float>(sum) / colorChannels * wx[x] * wy[y];
+                }
+            }
+        }
+    } // namespace
+
+    int OptimalImage::getOptimalDFTSize(int size)
+    {
+        if (size <= 0)
+        {
+            std::stringstream ss;
+            ss << "DFT size must be positive, but got " << size;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        long long best = -1;
+        for (long long p2 = 1; best < 0 || p2 < best; p2 *= 2)
+        {
+            for (long long p3 = p2; best < 0 || p3 < best; p3 *= 3)
+            {
+                for (long long p5 = p3; best < 0 || p5 < best; p5 *= 5)
+                {
+                    if (p5 >= size)
+                    {
+                        best = p5;
+                        break;
+                    }
+                }
+            }
+        }
+        return static_cast<int>(best);
+    }
+
+    OptimalImage OptimalImage::fftConvolve(const std::vector<float> &kernel, int kernelWidth, int kernelHeight, float delta) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply fftConvolve to an empty image");
+        }
+
+        if (kernelWidth <= 0 || kernelWidth % 2 == 0 || kernelHeight <= 0 || kernelHeight % 2 == 0)
+        {
+            std::stringstream ss;
+            ss << "Kernel size must be positive odd numbers, but got " << kernelWidth << "x" << kernelHeight;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (kernel.size() != static_cast<size_t>(kernelWidth) * kernelHeight)
+        {
+            std::stringstream ss;
+            ss << "Kernel must contain " << kernelWidth * kernelHeight << " coefficients, but got " << kernel.size();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        // 线性相关需要的最小尺寸为 图像 + 核 - 1，再取FFT友好的长度，避免循环卷积回绕进有效区域
+        int paddedWidth = getOptimalDFTSize(width_ + kernelWidth - 1);
+        int paddedHeight = getOptimalDFTSize(height_ + kernelHeight - 1);
+        int cols = paddedWidth / 2 + 1;
+        size_t realSize = static_cast<size_t>(paddedWidth) * paddedHeight;
+        size_t specSize = static_cast<size_t>(cols) * paddedHeight;
+
+        std::vector<float> realBuffer(realSize, 0.0f);
+        std::vector<Complex> kernelSpec(specSize);
+        std::vector<Complex> imageSpec(specSize);
+
+        for (int y = 0; y < kernelHeight; ++y)
+        {
+            std::memcpy(realBuffer.data() + static_cast<size_t>(y) * paddedWidth, kernel.data() + static_cast<size_t>(y) * kernelWidth, sizeof(float) * kernelWidth);
+        }
+        rfft2D(realBuffer.data(), paddedWidth, paddedHeight, kernelSpec.data());
+
+        OptimalImage result(width_, height_, channels_);
+        for (int c = 0; c < channels_; ++c)
+        {
+            extractChannelPadded(*this, c, kernelWidth / 2, kernelHeight / 2, paddedWidth, paddedHeight, realBuffer.data());
+            rfft2D(realBuffer.data(), paddedWidth, paddedHeight, imageSpec.data());
+
+            // 相关运算：乘以核频谱的共轭
+#pragma omp parallel for if (specSize > OPTIMIZATION_THRESHOLD)
+            for (long long i = 0; i < static_cast<long long>(specSize); ++i)
+            {
+                imageSpec[i] = cmul(imageSpec[i], cconj(kernelSpec[i]));
+            }
+
+            irfft2D(imageSpec.data(), paddedWidth, paddedHeight, realBuffer.data());
+            storeChannel(realBuffer.data(), paddedWidth, 0, 0, delta, result, c);
+        }
+
+        return result;
+    }
+
+    OptimalImage OptimalImage::fftGaussianBlur(double sigma) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply fftGaussianBlur to an empty image");
+        }
+
+        if (sigma <= 0.0)
+        {
+            std::stringstream ss;
+            ss << "Sigma must be positive, but got " << sigma;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        // 四周各复制3σ宽的边缘，使循环卷积的回绕远离有效区域
+        int margin = static_cast<int>(std::ceil(3.0 * sigma));
+        int paddedWidth = getOptimalDFTSize(width_ + 2 * margin);
+        int paddedHeight = getOptimalDFTSize(height_ + 2 * margin);
+        int cols = paddedWidth / 2 + 1;
+        size_t specSize = static_cast<size_t>(cols) * paddedHeight;
+
+        // 高斯函数的傅里叶变换：G(f) = exp(-2π²σ²f²)，二维时可分离
+        std::vector<float> gx(cols);
+        std::vector<float> gy(paddedHeight);
+        double factor = -2.0 * PI * PI * sigma * sigma;
+        for (int k = 0; k < cols; ++k)
+        {
+            double f = static_cast<double>(k) / paddedWidth;
+            gx[k] = static_cast<float>(std::exp(factor * f * f));
+        }
+        for (int k = 0; k < paddedHeight; ++k)
+        {
+            double f = static_cast<double>(k <= paddedHeight / 2 ? k : k - paddedHeight) / paddedHeight;
+            gy[k] = static_cast<float>(std::exp(factor * f * f));
+        }
+
+        std::vector<float> realBuffer(static_cast<size_t>(paddedWidth) * paddedHeight);
+        std::vector<Complex> spectrum(specSize);
+
+        OptimalImage result(width_, height_, channels_);
+        for (int c = 0; c < channels_; ++c)
+        {
+            extractChannelPadded(*this, c, margin, margin, paddedWidth, paddedHeight, realBuffer.data());
+            rfft2D(realBuffer.data(), paddedWidth, paddedHeight, spectrum.data());
+
+#pragma omp parallel for if (specSize > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < paddedHeight; ++y)
+            {
+                Complex *row = spectrum.data() + static_cast<size_t>(y) * cols;
+                for (int x = 0; x < cols; ++x)
+                {
+                    float g = gx[x] * gy[y];
+                    row[x].re *= g;
+                    row[x].im *= g;
+                }
+            }
+
+            irfft2D(spectrum.data(), paddedWidth, paddedHeight, realBuffer.data());
+            storeChannel(realBuffer.data(), paddedWidth, margin, margin, 0.0f, result, c);
+        }
+
+        return result;
+    }
+
+    PhaseCorrelationResult OptimalImage::phaseCorrelate(const OptimalImage &img1, const OptimalImage &img2)
+    {
+        if (img1.empty() || img2.empty())
+        {
+            throw InvalidArgumentException("Cannot phase-correlate empty images");
+        }
+
+        if (img1.width() != img2.width() || img1.height() != img2.height())
+        {
+            std::stringstream ss;
+            ss << "Image dimensions must match for phase correlation. "
+               << "First image: " << img1.width() << "x" << img1.height()
+               << ", Second image: " << img2.width() << "x" << img2.height();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        int width = img1.width();
+        int height = img1.height();
+        int paddedWidth = getOptimalDFTSize(width);
+        int paddedHeight = getOptimalDFTSize(height);
+        int cols = paddedWidth / 2 + 1;
+        size_t realSize = static_cast<size_t>(paddedWidth) * paddedHeight;
+        size_t specSize = static_cast<size_t>(cols) * paddedHeight;
+
+        std::vector<float> realBuffer(realSize, 0.0f);
+        std::vector<Complex> spec1(specSize);
+        std::vector<Complex> spec2(specSize);
+
+        windowedGray(img1, paddedWidth, realBuffer.data());
+        rfft2D(realBuffer.data(), paddedWidth, paddedHeight, spec1.data());
+        windowedGray(img2, paddedWidth, realBuffer.data());
+        rfft2D(realBuffer.data(), paddedWidth, paddedHeight, spec2.data());
+
+        // 归一化互功率谱：conj(F1) * F2 / |conj(F1) * F2|，逆变换后峰值位于平移量处
+#pragma omp parallel for if (specSize > OPTIMIZATION_THRESHOLD)
+        for (long long i = 0; i < static_cast<long long>(specSize); ++i)
+        {
+            Complex cross = cmul(cconj(spec1[i]), spec2[i]);
+            float magnitude = std::sqrt(cross.re * cross.re + cross.im * cross.im);
+            float inv = magnitude > PHASE_EPS ? 1.0f / magnitude : 0.0f;
+            spec1[i] = {cross.re * inv, cross.im * inv};
+        }
+        irfft2D(spec1.data(), paddedWidth, paddedHeight, realBuffer.data());
+
+        size_t peak = static_cast<size_t>(std::max_element(realBuffer.begin(), realBuffer.end()) - realBuffer.begin());
+        int px = static_cast<int>(peak % paddedWidth);
+        int py = static_cast<int>(peak / paddedWidth);
+
+        // 在峰值的3x3邻域（循环边界）内求加权质心，得到亚像素精度
+        double sum = 0.0;
+        double sumX = 0.0;
+        double sumY = 0.0;
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                int x = (px + dx + paddedWidth) % paddedWidth;
+                int y = (py + dy + paddedHeight) % paddedHeight;
+                double v = std::max(0.0f, realBuffer[static_cast<size_t>(y) * paddedWidth + x]);
+                sum += v;
+                sumX += v * dx;
+                sumY += v * dy;
+            }
+        }
+
+        double shiftX = px > paddedWidth / 2 ? px - paddedWidth : px;
+        double shiftY = py > paddedHeight / 2 ? py - paddedHeight : py;
+        if (sum > 0.0)
+        {
+            shiftX += sumX / sum;
+            shiftY += sumY / sum;
+        }
+
+        return {shiftX, shiftY, static_cast<double>(realBuffer[peak])};
+    }
+
+} // namespace mylib
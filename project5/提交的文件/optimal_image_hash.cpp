@@ -0,0 +1,403 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        constexpr double PI = 3.14159265358979323846;
+
+        // 感知哈希的缩略图边长与保留的低频系数边长
+        constexpr int PHASH_SIZE = 32;
+        constexpr int PHASH_LOW = 8;
+
+        // 汉明距离扫描的分块大小（哈希个数），一块为32KB，可以放进L1缓存
+        constexpr size_t HASH_BLOCK = 4096;
+
+        /**
+         * @brief 用区域平均缩小到width × height，再把颜色通道求和作为灰度（不除以通道数，各哈希只做比较和线性变换，结果不变）
+         * 四通道图像忽略alpha
+         */
+        std::vector<int> grayThumbnail(const OptimalImage &img, int width, int height)
+        {
+            OptimalImage small = img.resize(width, height, Interpolation::Area);
+            int cn = small.channels();
+            int colorChannels = std::min(cn, 3);
+            std::vector<int> gray(static_cast<size_t>(width) * height);
+            for (int y = 0; y < height; ++y)
+            {
+                const unsigned char *row = small.data() + y * small.step();
+                for (int x = 0; x < width; ++x)
+                {
+                    int sum = 0;
+                    for (int c = 0; c < colorChannels; ++c)
+                    {
+                        sum += row[x * cn + c];
+                    }
+                    gray[static_cast<size_t>(y) * width + x] = sum;
+                }
+            }
+            return gray;
+        }
+
+        /**
+         * @brief 32点DCT-II基函数的前8行：cos(PI * (2n + 1) * k / 64)，不做归一化（所有系数同比例，不影响与中值的比较）
+         */
+        const std::vector<double> &dctBasis()
+        {
+            static const std::vector<double> basis = []
+            {
+                std::vector<double> b(static_cast<size_t>(PHASH_LOW) * PHASH_SIZE);
+                for (int k = 0; k < PHASH_LOW; ++k)
+                {
+                    for (int n = 0; n < PHASH_SIZE; ++n)
+                    {
+                        b[static_cast<size_t>(k) * PHASH_SIZE + n] = std::cos(PI * (2 * n + 1) * k / (2.0 * PHASH_SIZE));
+                    }
+                }
+                return b;
+            }();
+            return basis;
+        }
+
+        void checkDistance(int maxDistance)
+        {
+            if (maxDistance < 0 || maxDistance > 64)
+            {
+                std::stringstream ss;
+                ss << "Hamming distance must be in [0, 64], but got " << maxDistance;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        /**
+         * @brief 扫描hashes[begin, end)，对与query汉明距离不超过maxDistance的每一项调用emit(index, distance)
+         * AVX2下用pshufb查4位查找表统计每个字节的位数，再用sad_epu8横向求和得到4个64位计数，
+         * 与阈值比较后用movemask取出命中的项；绝大多数哈希不命中，只在命中时才逐项处理
+         */
+        template <typename Emit>
+        void scanRange(const uint64_t *hashes, size_t begin, size_t end, uint64_t query, int maxDistance, Emit emit)
+        {
+            size_t i = begin;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                                 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+            const __m256i lowNibble = _mm256_set1_epi8(0x0F);
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i q = _mm256_set1_epi64x(static_cast<long long>(query));
+            const __m256i limit = _mm256_set1_epi64x(maxDistance);
+            for (; i + 4 <= end; i += 4)
+            {
+                __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(hashes + i)), q);
+                __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, lowNibble));
+                __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi16(v, 4), lowNibble));
+                __m256i count = _mm256_sad_epu8(_mm256_add_epi8(lo, hi), zero);
+                int over = _mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(count, limit)));
+                if (over != 0xF)
+                {
+                    for (int k = 0; k < 4; ++k)
+                    {
+                        if (!(over & (1 << k)))
+                        {
+                            emit(i + k, detail::popcount64(hashes[i + k] ^ query));
+                        }
+                    }
+                }
+            }
+#endif
+#endif
+            for (; i < end; ++i)
+            {
+                int distance = detail::popcount64(hashes[i] ^ query);
+                if (distance <= maxDistance)
+                {
+                    emit(i, distance);
+                }
+            }
+        }
+
+        /**
+         * @brief 把n个哈希分成若干条带（以HASH_BLOCK为单位），返回条带数
+         */
+        int hashStripes(size_t n)
+        {
+            int blocks = static_cast<int>((n + HASH_BLOCK - 1) / HASH_BLOCK);
+            return n > OPTIMIZATION_THRESHOLD ? detail::stripeCount(blocks) : 1;
+        }
+
+        size_t hashStripeBegin(size_t n, int stripes, int s)
+        {
+            int blocks = static_cast<int>((n + HASH_BLOCK - 1) / HASH_BLOCK);
+            return std::min(n, static_cast<size_t>(detail::stripeBegin(blocks, stripes, s)) * HASH_BLOCK);
+        }
+    } // namespace
+
+    uint64_t OptimalImage::averageHash() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot hash an empty image");
+        }
+
+        std::vector<int> gray = grayThumbnail(*this, 8, 8);
+        long long total = 0;
+        for (int v : gray)
+        {
+            total += v;
+        }
+
+        // 与均值比较写成 v * 64 > total，避免除法和舍入
+        uint64_t hash = 0;
+        for (int i = 0; i < 64; ++i)
+        {
+            if (static_cast<long long>(gray[i]) * 64 > total)
+            {
+                hash |= 1ull << i;
+            }
+        }
+        return hash;
+    }
+
+    uint64_t OptimalImage::dHash() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot hash an empty image");
+        }
+
+        std::vector<int> gray = grayThumbnail(*this, 9, 8);
+        uint64_t hash = 0;
+        for (int y = 0; y < 8; ++y)
+        {
+            for (int x = 0; x < 8; ++x)
+            {
+                if (gray[y * 9 + x] > gray[y * 9 + x + 1])
+                {
+                    hash |= 1ull << (y * 8 + x);
+                }
+            }
+        }
+        return hash;
+    }
+
+    uint64_t OptimalImage::pHash() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot hash an empty image");
+        }
+
+        std::vector<int> gray = grayThumbnail(*this, PHASH_SIZE, PHASH_SIZE);
+        const std::vector<double> &basis = dctBasis();
+
+        // 只需要8x8低频系数：先对列做DCT得到8 × 32的中间结果，再对行做DCT
+        std::vector<double> columns(static_cast<size_t>(PHASH_LOW) * PHASH_SIZE, 0.0);
+        for (int v = 0; v < PHASH_LOW; ++v)
+        {
+            const double *b = basis.data() + static_cast<size_t>(v) * PHASH_SIZE;
+            double *out = columns.data() + static_cast<size_t>(v) * PHASH_SIZE;
+            for (int y = 0; y < PHASH_SIZE; ++y)
+            {
+                const int *row = gray.data() + static_cast<size_t>(y) * PHASH_SIZE;
+                for (int x = 0; x < PHASH_SIZE; ++x)
+                {
+                    out[x] += b[y] * row[x];
+                }
+            }
+        }
+
+        double coeffs[PHASH_LOW * PHASH_LOW];
+        for (int v = 0; v < PHASH_LOW; ++v)
+        {
+            const double *col = columns.data() + static_cast<size_t>(v) * PHASH_SIZE;
+            for (int u = 0; u < PHASH_LOW; ++u)
+            {
+                const double *b = basis.data() + static_cast<size_t>(u) * PHASH_SIZE;
+                double sum = 0.0;
+                for (int x = 0; x < PHASH_SIZE; ++x)
+                {
+                    sum += b[x] * col[x];
+                }
+                coeffs[v * PHASH_LOW + u] = sum;
+            }
+        }
+
+        // 中值取排序后中间两个数的平均
+        double sorted[PHASH_LOW * PHASH_LOW];
+        std::copy(coeffs, coeffs + PHASH_LOW * PHASH_LOW, sorted);
+        std::sort(sorted, sorted + PHASH_LOW * PHASH_LOW);
+        double median = 0.5 * (sorted[31] + sorted[32]);
+
+        uint64_t hash = 0;
+        for (int i = 0; i < 64; ++i)
+        {
+            if (coeffs[i] > median)
+            {
+                hash |= 1ull << i;
+            }
+        }
+        return hash;
+    }
+
+    int OptimalImage::hammingDistance(uint64_t a, uint64_t b)
+    {
+        return detail::popcount64(a ^ b);
+    }
+
+    HashIndex::HashIndex(std::vector<uint64_t> hashes) : hashes_(std::move(hashes))
+    {
+    }
+
+    size_t HashIndex::add(uint64_t hash)
+    {
+        hashes_.push_back(hash);
+        return hashes_.size() - 1;
+    }
+
+    void HashIndex::reserve(size_t count)
+    {
+        hashes_.reserve(count);
+    }
+
+    size_t HashIndex::size() const
+    {
+        return hashes_.size();
+    }
+
+    uint64_t HashIndex::hash(size_t index) const
+    {
+        if (index >= hashes_.size())
+        {
+            std::stringstream ss;
+            ss << "Hash index " << index << " is out of range [0, " << hashes_.size() << ")";
+            throw OutOfRangeException(ss.str());
+        }
+        return hashes_[index];
+    }
+
+    std::vector<HashMatch> HashIndex::query(uint64_t hash, int maxDistance) const
+    {
+        checkDistance(maxDistance);
+
+        size_t n = hashes_.size();
+        int stripes = hashStripes(n);
+        std::vector<std::vector<HashMatch>> partial(stripes);
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<HashMatch> &out = partial[s];
+            scanRange(hashes_.data(), hashStripeBegin(n, stripes, s), hashStripeBegin(n, stripes, s + 1), hash, maxDistance,
+                      [&out](size_t index, int distance)
+                      { out.push_back({index, distance}); });
+        }
+
+        // 各条带按下标顺序拼接，结果与线程数无关
+        std::vector<HashMatch> matches;
+        for (const std::vector<HashMatch> &p : partial)
+        {
+            matches.insert(matches.end(), p.begin(), p.end());
+        }
+        return matches;
+    }
+
+    HashMatch HashIndex::nearest(uint64_t hash) const
+    {
+        if (hashes_.empty())
+        {
+            throw OperationFailedException("Cannot search an empty hash index");
+        }
+
+        size_t n = hashes_.size();
+        int stripes = hashStripes(n);
+        std::vector<HashMatch> best(stripes, HashMatch{0, 65});
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            HashMatch &b = best[s];
+            size_t begin = hashStripeBegin(n, stripes, s);
+            size_t end = hashStripeBegin(n, stripes, s + 1);
+            // 阈值随当前最优距离收紧，后面只有更近的项才会命中
+            for (size_t i = begin; i < end && b.distance > 0; i += HASH_BLOCK)
+            {
+                scanRange(hashes_.data(), i, std::min(end, i + HASH_BLOCK), hash, b.distance - 1,
+                          [&b](size_t index, int distance)
+                          {
+                              if (distance < b.distance)
+                              {
+                                  b = {index, distance};
+                              }
+                          });
+            }
+        }
+
+        // 条带按下标顺序排列，距离相同时保留靠前条带的结果
+        HashMatch result = best[0];
+        for (int s = 1; s < stripes; ++s)
+        {
+            if (best[s].distance < result.distance)
+            {
+                result = best[s];
+            }
+        }
+        return result;
+    }
+
+    std::vector<std::pair<size_t, size_t>> HashIndex::findDuplicates(int maxDistance) const
+    {
+        checkDistance(maxDistance);
+
+        size_t n = hashes_.size();
+        long long blocks = static_cast<long long>((n + HASH_BLOCK - 1) / HASH_BLOCK);
+        std::vector<std::vector<std::pair<size_t, size_t>>> partial(blocks);
+        const uint64_t *data = hashes_.data();
+
+        // 第bi块的每个哈希与下标更大的所有哈希比较；被比较的哈希按块遍历，一块在缓存中被bi块的全部查询复用。
+        // 各块的工作量随bi递减，所以动态分配
+#pragma omp parallel for schedule(dynamic) if (n > OPTIMIZATION_THRESHOLD)
+        for (long long bi = 0; bi < blocks; ++bi)
+        {
+            std::vector<std::pair<size_t, size_t>> &out = partial[bi];
+            size_t iBegin = static_cast<size_t>(bi) * HASH_BLOCK;
+            size_t iEnd = std::min(n, iBegin + HASH_BLOCK);
+            for (size_t jBegin = iBegin; jBegin < n; jBegin += HASH_BLOCK)
+            {
+                size_t jEnd = std::min(n, jBegin + HASH_BLOCK);
+                for (size_t i = iBegin; i < iEnd; ++i)
+                {
+                    scanRange(data, std::max(i + 1, jBegin), jEnd, data[i], maxDistance,
+                              [&out, i](size_t index, int)
+                              { out.emplace_back(i, index); });
+                }
+            }
+            std::sort(out.begin(), out.end());
+        }
+
+        std::vector<std::pair<size_t, size_t>> pairs;
+        for (const auto &p : partial)
+        {
+            pairs.insert(pairs.end(), p.begin(), p.end());
+        }
+        return pairs;
+    }
+
+} // namespace mylib
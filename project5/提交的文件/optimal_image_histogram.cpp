@@ -0,0 +1,478 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        constexpr int HIST_BINS = 256;
+        constexpr int MAX_CHANNELS = 4;
+
+        // 每个线程内部的子直方图数：相邻像素落入不同的子直方图，相同灰度连续出现时不会串行化在同一个计数器上
+        constexpr int HIST_LANES = 4;
+
+        // CLAHE插值权重的定点精度（8位小数）
+        constexpr int CLAHE_WEIGHT_BITS = 8;
+        constexpr int CLAHE_WEIGHT_ONE = 1 << CLAHE_WEIGHT_BITS;
+
+        /**
+         * @brief 直方图合并：dst += src，n为32位计数的个数
+         */
+        inline void histAdd(uint32_t *dst, const uint32_t *src, int n)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= n - 8; i += 8)
+            {
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_add_epi32(d, s));
+            }
+#elif defined(__SSE2__)
+            for (; i <= n - 4; i += 4)
+            {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_add_epi32(d, s));
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                dst[i] += src[i];
+            }
+        }
+
+        /**
+         * @brief 统计矩形区域[x0, x1) × [y0, y1)的直方图并累加到hist
+         * @param data 第一个要统计的通道的起始地址
+         * @param pixelStride 相邻像素间隔的字节数（图像通道数）
+         * @param histChannels 统计的通道数，hist大小为histChannels × 256
+         */
+        void accumulateHistogram(const unsigned char *data, size_t step, int pixelStride, int histChannels,
+                                 int x0, int x1, int y0, int y1, uint32_t *hist)
+        {
+            alignas(32) uint32_t lanes[HIST_LANES][MAX_CHANNELS * HIST_BINS];
+            int binCount = histChannels * HIST_BINS;
+            for (int l = 0; l < HIST_LANES; ++l)
+            {
+                std::memset(lanes[l], 0, binCount * sizeof(uint32_t));
+            }
+
+            int count = x1 - x0;
+            for (int y = y0; y < y1; ++y)
+            {
+                const unsigned char *row = data + y * step + x0 * pixelStride;
+                int x = 0;
+                for (; x <= count - HIST_LANES; x += HIST_LANES)
+                {
+                    const unsigned char *p = row + x * pixelStride;
+                    for (int c = 0; c < histChannels; ++c)
+                    {
+                        int base = c * HIST_BINS;
+                        ++lanes[0][base + p[c]];
+                        ++lanes[1][base + p[pixelStride + c]];
+                        ++lanes[2][base + p[2 * pixelStride + c]];
+                        ++lanes[3][base + p[3 * pixelStride + c]];
+                    }
+                }
+                for (; x < count; ++x)
+                {
+                    const unsigned char *p = row + x * pixelStride;
+                    for (int c = 0; c < histChannels; ++c)
+                    {
+                        ++lanes[0][c * HIST_BINS + p[c]];
+                    }
+                }
+            }
+
+            for (int l = 0; l < HIST_LANES; ++l)
+            {
+                histAdd(hist, lanes[l], binCount);
+            }
+        }
+
+        /**
+         * @brief 并行统计整幅图像的直方图：每个条带（线程）写入私有直方图，最后合并
+         * @param channel 起始通道
+         * @param histChannels 统计的通道数
+         * @return histChannels × 256个计数
+         */
+        std::vector<uint32_t> imageHistogram(const OptimalImage &img, int channel, int histChannels)
+        {
+            int binCount = histChannels * HIST_BINS;
+            int stripes = detail::stripeCount(img.height());
+            std::vector<uint32_t> partial(static_cast<size_t>(stripes) * binCount, 0);
+            int pixelCount = img.width() * img.height();
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int s = 0; s < stripes; ++s)
+            {
+                int y0 = detail::stripeBegin(img.height(), stripes, s);
+                int y1 = detail::stripeBegin(img.height(), stripes, s + 1);
+                accumulateHistogram(img.data() + channel, img.step(), img.channels(), histChannels,
+                                    0, img.width(), y0, y1, partial.data() + static_cast<size_t>(s) * binCount);
+            }
+
+            std::vector<uint32_t> hist(partial.begin(), partial.begin() + binCount);
+            for (int s = 1; s < stripes; ++s)
+            {
+                histAdd(hist.data(), partial.data() + static_cast<size_t>(s) * binCount, binCount);
+            }
+            return hist;
+        }
+
+        /**
+         * @brief 对每个字节查表：dst[i] = lut[(i % cn) × 256 + src[i]]
+         * 字节查表没有可用的SIMD gather，标量展开即可达到每字节约1个周期
+         */
+        void applyLUT(const OptimalImage &src, OptimalImage &dst, const unsigned char *lut)
+        {
+            int cn = src.channels();
+            int width = src.width();
+            int pixelCount = width * src.height();
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < src.height(); ++y)
+            {
+                const unsigned char *s = src.data() + y * src.step();
+                unsigned char *d = dst.data() + y * dst.step();
+                if (cn == 1)
+                {
+                    int x = 0;
+                    for (; x <= width - 4; x += 4)
+                    {
+                        d[x] = lut[s[x]];
+                        d[x + 1] = lut[s[x + 1]];
+                        d[x + 2] = lut[s[x + 2]];
+                        d[x + 3] = lut[s[x + 3]];
+                    }
+                    for (; x < width; ++x)
+                    {
+                        d[x] = lut[s[x]];
+                    }
+                }
+                else
+                {
+                    for (int x = 0; x < width; ++x)
+                    {
+                        for (int c = 0; c < cn; ++c)
+                        {
+                            d[x * cn + c] = lut[c * HIST_BINS + s[x * cn + c]];
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 截断直方图并把截掉的计数均匀分配回所有桶
+         */
+        void clipHistogram(uint32_t *hist, uint32_t clip)
+        {
+            uint32_t excess = 0;
+            for (int i = 0; i < HIST_BINS; ++i)
+            {
+                if (hist[i] > clip)
+                {
+                    excess += hist[i] - clip;
+                    hist[i] = clip;
+                }
+            }
+
+            uint32_t batch = excess / HIST_BINS;
+            uint32_t residual = excess - batch * HIST_BINS;
+            for (int i = 0; i < HIST_BINS; ++i)
+            {
+                hist[i] += batch;
+            }
+
+            // 余数以等间隔分散到各个桶，避免集中在低灰度端
+            if (residual > 0)
+            {
+                int residualStep = std::max(HIST_BINS / static_cast<int>(residual), 1);
+                for (int i = 0; i < HIST_BINS && residual > 0; i += residualStep, --residual)
+                {
+                    ++hist[i];
+                }
+            }
+        }
+
+        /**
+         * @brief 计算CLAHE插值的分块索引与权重
+         * 分块t覆盖[bounds[t], bounds[t + 1])，其查找表位于分块中心；位于两个中心之间的坐标在两者之间线性插值，
+         * 第一个中心之前和最后一个中心之后的坐标只使用最近的分块
+         * @param t0 左（上）侧分块索引
+         * @param t1 右（下）侧分块索引
+         * @param weight t1的权重，定点数，范围[0, CLAHE_WEIGHT_ONE]
+         */
+        void tileInterpolation(const std::vector<int> &bounds, int length,
+                               std::vector<int> &t0, std::vector<int> &t1, std::vector<int> &weight)
+        {
+            int tiles = static_cast<int>(bounds.size()) - 1;
+            t0.resize(length);
+            t1.resize(length);
+            weight.resize(length);
+
+            int t = 0;
+            for (int i = 0; i < length; ++i)
+            {
+                double center0 = (bounds[t] + bounds[t + 1] - 1) * 0.5;
+                while (t < tiles - 1 && i >= (bounds[t + 1] + bounds[t + 2] - 1) * 0.5)
+                {
+                    ++t;
+                    center0 = (bounds[t] + bounds[t + 1] - 1) * 0.5;
+                }
+
+                if (i <= center0 || t == tiles - 1)
+                {
+                    t0[i] = t;
+                    t1[i] = t;
+                    weight[i] = 0;
+                }
+                else
+                {
+                    double center1 = (bounds[t + 1] + bounds[t + 2] - 1) * 0.5;
+                    t0[i] = t;
+                    t1[i] = t + 1;
+                    weight[i] = static_cast<int>((i - center0) / (center1 - center0) * CLAHE_WEIGHT_ONE + 0.5);
+                }
+            }
+        }
+
+        std::vector<int> tileBounds(int length, int tiles)
+        {
+            std::vector<int> bounds(tiles + 1);
+            for (int t = 0; t <= tiles; ++t)
+            {
+                bounds[t] = static_cast<int>(static_cast<long long>(length) * t / tiles);
+            }
+            return bounds;
+        }
+    } // namespace
+
+    std::vector<size_t> OptimalImage::calcHist(int channel) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute histogram of an empty image");
+        }
+
+        if (channel < 0 || channel >= channels_)
+        {
+            std::stringstream ss;
+            ss << "Channel index " << channel << " out of range [0, " << channels_ - 1 << "]";
+            throw OutOfRangeException(ss.str());
+        }
+
+        std::vector<uint32_t> hist = imageHistogram(*this, channel, 1);
+        return std::vector<size_t>(hist.begin(), hist.end());
+    }
+
+    OptimalImage OptimalImage::equalizeHist() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot equalize histogram of an empty image");
+        }
+
+        std::vector<uint32_t> hist = imageHistogram(*this, 0, channels_);
+        std::vector<unsigned char> lut(static_cast<size_t>(channels_) * HIST_BINS);
+        uint32_t total = static_cast<uint32_t>(width_) * height_;
+
+        for (int c = 0; c < channels_; ++c)
+        {
+            const uint32_t *h = hist.data() + c * HIST_BINS;
+            unsigned char *l = lut.data() + c * HIST_BINS;
+
+            int first = 0;
+            while (h[first] == 0)
+            {
+                ++first;
+            }
+
+            // 只有一个灰度级时保持原值
+            if (h[first] == total)
+            {
+                for (int i = 0; i < HIST_BINS; ++i)
+                {
+                    l[i] = static_cast<unsigned char>(i);
+                }
+                continue;
+            }
+
+            // 最小灰度映射到0，最大灰度映射到255
+            double scale = 255.0 / (total - h[first]);
+            uint32_t cdf = 0;
+            for (int i = 0; i < HIST_BINS; ++i)
+            {
+                if (i > first)
+                {
+                    cdf += h[i];
+                }
+                l[i] = static_cast<unsigned char>(std::min(255, static_cast<int>(cdf * scale + 0.5)));
+            }
+        }
+
+        OptimalImage result(width_, height_, channels_);
+        applyLUT(*this, result, lut.data());
+        return result;
+    }
+
+    OptimalImage OptimalImage::clahe(double clipLimit, int tilesX, int tilesY) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply CLAHE to an empty image");
+        }
+
+        if (!(clipLimit > 0.0))
+        {
+            std::stringstream ss;
+            ss << "CLAHE clip limit must be positive, but got " << clipLimit;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (tilesX <= 0 || tilesY <= 0 || tilesX > width_ || tilesY > height_)
+        {
+            std::stringstream ss;
+            ss << "CLAHE tile grid " << tilesX << "x" << tilesY << " is invalid for a "
+               << width_ << "x" << height_ << " image";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        int cn = channels_;
+        int lutSize = cn * HIST_BINS;
+        std::vector<int> boundsX = tileBounds(width_, tilesX);
+        std::vector<int> boundsY = tileBounds(height_, tilesY);
+
+        // 每个分块、每个通道一张查找表，用int32存储以便直接gather
+        std::vector<int> luts(static_cast<size_t>(tilesX) * tilesY * lutSize);
+        int tileCount = tilesX * tilesY;
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int t = 0; t < tileCount; ++t)
+        {
+            int tx = t % tilesX;
+            int ty = t / tilesX;
+            int x0 = boundsX[tx], x1 = boundsX[tx + 1];
+            int y0 = boundsY[ty], y1 = boundsY[ty + 1];
+            uint32_t area = static_cast<uint32_t>(x1 - x0) * (y1 - y0);
+
+            uint32_t hist[MAX_CHANNELS * HIST_BINS] = {};
+            accumulateHistogram(data(), step(), cn, cn, x0, x1, y0, y1, hist);
+
+            uint32_t clip = std::max<uint32_t>(1, static_cast<uint32_t>(clipLimit * area / HIST_BINS));
+            for (int c = 0; c < cn; ++c)
+            {
+                uint32_t *h = hist + c * HIST_BINS;
+                clipHistogram(h, clip);
+
+                int *lut = luts.data() + static_cast<size_t>(t) * lutSize + c * HIST_BINS;
+                uint64_t cdf = 0;
+                for (int i = 0; i < HIST_BINS; ++i)
+                {
+                    cdf += h[i];
+                    lut[i] = static_cast<int>(std::min<uint64_t>(255, (cdf * 255 + area / 2) / area));
+                }
+            }
+        }
+
+        // 每个字节的分块偏移量与水平权重只与列有关，预先计算一次
+        std::vector<int> colT0, colT1, colWeight;
+        tileInterpolation(boundsX, width_, colT0, colT1, colWeight);
+        std::vector<int> rowT0, rowT1, rowWeight;
+        tileInterpolation(boundsY, height_, rowT0, rowT1, rowWeight);
+
+        int rowBytes = width_ * cn;
+        std::vector<int> offset0(rowBytes), offset1(rowBytes), weightX(rowBytes);
+        for (int x = 0; x < width_; ++x)
+        {
+            for (int c = 0; c < cn; ++c)
+            {
+                offset0[x * cn + c] = colT0[x] * lutSize + c * HIST_BINS;
+                offset1[x * cn + c] = colT1[x] * lutSize + c * HIST_BINS;
+                weightX[x * cn + c] = colWeight[x];
+            }
+        }
+
+        OptimalImage result(width_, height_, cn);
+        size_t tileRowSize = static_cast<size_t>(tilesX) * lutSize;
+        constexpr int ROUND = 1 << (2 * CLAHE_WEIGHT_BITS - 1);
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            const unsigned char *src = data() + y * step();
+            unsigned char *dst = result.data() + y * result.step();
+            const int *lutTop = luts.data() + rowT0[y] * tileRowSize;
+            const int *lutBottom = luts.data() + rowT1[y] * tileRowSize;
+            int wy = rowWeight[y];
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            // 每8个字节做4次gather，水平插值用madd_epi16一次完成两个乘加
+            __m256i vOne = _mm256_set1_epi32(CLAHE_WEIGHT_ONE);
+            __m256i vWy = _mm256_set1_epi32(wy);
+            __m256i vIwy = _mm256_set1_epi32(CLAHE_WEIGHT_ONE - wy);
+            __m256i vRound = _mm256_set1_epi32(ROUND);
+            __m256i vCompact = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+            for (; i <= rowBytes - 8; i += 8)
+            {
+                __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+                __m256i idx0 = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(offset0.data() + i)), v);
+                __m256i idx1 = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(offset1.data() + i)), v);
+                __m256i l00 = _mm256_i32gather_epi32(lutTop, idx0, 4);
+                __m256i l01 = _mm256_i32gather_epi32(lutTop, idx1, 4);
+                __m256i l10 = _mm256_i32gather_epi32(lutBottom, idx0, 4);
+                __m256i l11 = _mm256_i32gather_epi32(lutBottom, idx1, 4);
+
+                __m256i wx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(weightX.data() + i));
+                __m256i weights = _mm256_or_si256(_mm256_sub_epi32(vOne, wx), _mm256_slli_epi32(wx, 16));
+                __m256i top = _mm256_madd_epi16(_mm256_or_si256(l00, _mm256_slli_epi32(l01, 16)), weights);
+                __m256i bottom = _mm256_madd_epi16(_mm256_or_si256(l10, _mm256_slli_epi32(l11, 16)), weights);
+
+                __m256i r = _mm256_add_epi32(_mm256_mullo_epi32(top, vIwy), _mm256_mullo_epi32(bottom, vWy));
+                r = _mm256_srli_epi32(_mm256_add_epi32(r, vRound), 2 * CLAHE_WEIGHT_BITS);
+                r = _mm256_packus_epi32(r, r);
+                r = _mm256_packus_epi16(r, r);
+                r = _mm256_permutevar8x32_epi32(r, vCompact);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(r));
+            }
+#endif
+#endif
+            for (; i < rowBytes; ++i)
+            {
+                int v = src[i];
+                int wx = weightX[i];
+                int top = lutTop[offset0[i] + v] * (CLAHE_WEIGHT_ONE - wx) + lutTop[offset1[i] + v] * wx;
+                int bottom = lutBottom[offset0[i] + v] * (CLAHE_WEIGHT_ONE - wx) + lutBottom[offset1[i] + v] * wx;
+                dst[i] = static_cast<unsigned char>((top * (CLAHE_WEIGHT_ONE - wy) + bottom * wy + ROUND) >> (2 * CLAHE_WEIGHT_BITS));
+            }
+        }
+
+        return result;
+    }
+
+} // namespace mylib
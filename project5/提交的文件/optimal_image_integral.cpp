@@ -0,0 +1,418 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cstdint>
+#include <climits>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 列累加时每个线程负责的列宽（元素个数）
+        constexpr int INTEGRAL_COLUMN_BLOCK = 256;
+
+        /**
+         * @brief 单行前缀和：dst[i] = dst[i - cn] + f(src[i])，f为恒等或平方，dst[-cn, 0)视为0
+         * 单通道32位积分图使用寄存器内的前缀扫描：先在128位通道内做两次移位相加，再把低半部分的总和加到高半部分
+         */
+        template <typename T, bool Squared>
+        void scanRow(const unsigned char *src, int count, int cn, T *dst)
+        {
+            int n = count * cn;
+            int i = 0;
+
+            if constexpr (std::is_same<T, uint32_t>::value && !Squared)
+            {
+                if (cn == 1)
+                {
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+                    __m256i carry = _mm256_setzero_si256();
+                    __m256i lastLane = _mm256_set1_epi32(7);
+                    for (; i <= n - 8; i += 8)
+                    {
+                        __m256i v = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)));
+                        v = _mm256_add_epi32(v, _mm256_slli_si256(v, 4));
+                        v = _mm256_add_epi32(v, _mm256_slli_si256(v, 8));
+                        __m256i low = _mm256_permute2x128_si256(v, v, 0x08); // 低半部分置零，高半部分为原低半部分
+                        v = _mm256_add_epi32(v, _mm256_shuffle_epi32(low, 0xFF));
+                        v = _mm256_add_epi32(v, carry);
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+                        carry = _mm256_permutevar8x32_epi32(v, lastLane);
+                    }
+#elif defined(__SSE2__)
+                    __m128i carry = _mm_setzero_si128();
+                    __m128i zero = _mm_setzero_si128();
+                    for (; i <= n - 4; i += 4)
+                    {
+                        int packed;
+                        std::memcpy(&packed, src + i, sizeof(packed));
+                        __m128i v = _mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(packed), zero), zero);
+                        v = _mm_add_epi32(v, _mm_slli_si128(v, 4));
+                        v = _mm_add_epi32(v, _mm_slli_si128(v, 8));
+                        v = _mm_add_epi32(v, carry);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+                        carry = _mm_shuffle_epi32(v, 0xFF);
+                    }
+#endif
+#endif
+                }
+            }
+
+            T sums[4] = {0, 0, 0, 0};
+            for (int c = 0; c < cn && i > 0; ++c)
+            {
+                sums[c] = dst[i - cn + c];
+            }
+            for (; i < n; i += cn)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    T v = src[i + c];
+                    sums[c] += Squared ? v * v : v;
+                    dst[i + c] = sums[c];
+                }
+            }
+        }
+
+        /**
+         * @brief 列累加：dst += prev
+         */
+        template <typename T>
+        void addRow(T *dst, const T *prev, int n)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            constexpr int lanes = 32 / sizeof(T);
+            for (; i <= n - lanes; i += lanes)
+            {
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(prev + i));
+                __m256i r = sizeof(T) == 4 ? _mm256_add_epi32(d, p) : _mm256_add_epi64(d, p);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), r);
+            }
+#elif defined(__SSE2__)
+            constexpr int lanes = 16 / sizeof(T);
+            for (; i <= n - lanes; i += lanes)
+            {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i *>(prev + i));
+                __m128i r = sizeof(T) == 4 ? _mm_add_epi32(d, p) : _mm_add_epi64(d, p);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), r);
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                dst[i] += prev[i];
+            }
+        }
+
+        /**
+         * @brief 计算复制填充后图像的积分图
+         * 第一遍按行条带并行做行前缀和，第二遍按列块并行逐行向下累加
+         * @param padLeft 左侧填充的像素数，其余类似
+         * @return (width + padLeft + padRight + 1) × (height + padTop + padBottom + 1)的积分图
+         */
+        template <typename T, bool Squared>
+        ImageBuffer<T> buildIntegral(const OptimalImage &src, int padLeft, int padTop, int padRight, int padBottom)
+        {
+            int srcWidth = src.width();
+            int srcHeight = src.height();
+            int cn = src.channels();
+            int width = srcWidth + padLeft + padRight;
+            int height = srcHeight + padTop + padBottom;
+            bool padded = padLeft > 0 || padRight > 0;
+
+            ImageBuffer<T> sat(width + 1, height + 1, cn);
+            int rowLen = (width + 1) * cn;
+            int pixelCount = width * height;
+
+            int stripes = detail::stripeCount(height);
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int s = 0; s < stripes; ++s)
+            {
+                int y0 = detail::stripeBegin(height, stripes, s);
+                int y1 = detail::stripeBegin(height, stripes, s + 1);
+                std::vector<unsigned char> rowBuffer(padded ? static_cast<size_t>(width) * cn : 0);
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    const unsigned char *srcRow = src.data() + std::clamp(y - padTop, 0, srcHeight - 1) * src.step();
+                    if (padded)
+                    {
+                        unsigned char *buf = rowBuffer.data();
+                        for (int x = 0; x < padLeft; ++x)
+                        {
+                            std::memcpy(buf + x * cn, srcRow, cn);
+                        }
+                        std::memcpy(buf + padLeft * cn, srcRow, static_cast<size_t>(srcWidth) * cn);
+                        for (int x = padLeft + srcWidth; x < width; ++x)
+                        {
+                            std::memcpy(buf + x * cn, srcRow + (srcWidth - 1) * cn, cn);
+                        }
+                        srcRow = buf;
+                    }
+                    scanRow<T, Squared>(srcRow, width, cn, sat.row(y + 1) + cn);
+                }
+            }
+
+            int blocks = (rowLen + INTEGRAL_COLUMN_BLOCK - 1) / INTEGRAL_COLUMN_BLOCK;
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int blk = 0; blk < blocks; ++blk)
+            {
+                int c0 = blk * INTEGRAL_COLUMN_BLOCK;
+                int bw = std::min(INTEGRAL_COLUMN_BLOCK, rowLen - c0);
+                for (int y = 2; y <= height; ++y)
+                {
+                    addRow(sat.row(y) + c0, sat.row(y - 1) + c0, bw);
+                }
+            }
+
+            return sat;
+        }
+
+        void checkWindow(const OptimalImage &img, int windowWidth, int windowHeight, const char *operation)
+        {
+            if (img.empty())
+            {
+                std::stringstream ss;
+                ss << "Cannot apply " << operation << " to an empty image";
+                throw OperationFailedException(ss.str());
+            }
+
+            if (windowWidth <= 0 || windowHeight <= 0)
+            {
+                std::stringstream ss;
+                ss << "Window size must be positive, but got " << windowWidth << "x" << windowHeight;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        /**
+         * @brief 窗口和的上界windowWidth × windowHeight × 255是否小于2^31
+         * 满足时32位积分图的回绕不影响四角相减的结果，SIMD按有符号数转换浮点数也不会出错；否则必须使用64位积分图
+         */
+        bool windowFitsInt32(int windowWidth, int windowHeight)
+        {
+            return static_cast<long long>(windowWidth) * windowHeight * 255 <= INT_MAX;
+        }
+
+        /**
+         * @brief 窗口和可能超过2^31时的盒式滤波：64位积分图，标量双精度计算
+         */
+        OptimalImage boxFilterWide(const OptimalImage &src, int kernelWidth, int kernelHeight)
+        {
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            int ax = kernelWidth / 2;
+            int ay = kernelHeight / 2;
+            ImageBuffer<uint64_t> sat = buildIntegral<uint64_t, false>(src, ax, ay, kernelWidth - 1 - ax, kernelHeight - 1 - ay);
+
+            OptimalImage result(width, height, cn);
+            int rowBytes = width * cn;
+            size_t span = static_cast<size_t>(kernelWidth) * cn;
+            double scale = 1.0 / (static_cast<double>(kernelWidth) * kernelHeight);
+            int pixelCount = width * height;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < height; ++y)
+            {
+                const uint64_t *top = sat.row(y);
+                const uint64_t *bottom = sat.row(y + kernelHeight);
+                unsigned char *dst = result.data() + y * result.step();
+                for (int i = 0; i < rowBytes; ++i)
+                {
+                    uint64_t sum = bottom[i + span] - bottom[i] - top[i + span] + top[i];
+                    dst[i] = static_cast<unsigned char>(static_cast<int>(static_cast<double>(sum) * scale + 0.5));
+                }
+            }
+            return result;
+        }
+
+        /**
+         * @brief 由（填充后的）积分图和平方积分图计算每个窗口的均值和方差
+         */
+        template <typename T>
+        void meanVarianceFromIntegral(const ImageBuffer<T> &sat, const ImageBuffer<uint64_t> &sqsat, int windowWidth, int windowHeight,
+                                      ImageBuffer<float> &mean, ImageBuffer<float> &variance)
+        {
+            int width = mean.width;
+            int height = mean.height;
+            int rowBytes = width * mean.channels;
+            size_t span = static_cast<size_t>(windowWidth) * mean.channels;
+            double scale = 1.0 / (static_cast<double>(windowWidth) * windowHeight);
+            int pixelCount = width * height;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < height; ++y)
+            {
+                const T *top = sat.row(y);
+                const T *bottom = sat.row(y + windowHeight);
+                const uint64_t *sqTop = sqsat.row(y);
+                const uint64_t *sqBottom = sqsat.row(y + windowHeight);
+                float *meanRow = mean.row(y);
+                float *varRow = variance.row(y);
+
+                for (int i = 0; i < rowBytes; ++i)
+                {
+                    T sum = bottom[i + span] - bottom[i] - top[i + span] + top[i];
+                    uint64_t sqSum = sqBottom[i + span] - sqBottom[i] - sqTop[i + span] + sqTop[i];
+                    double m = sum * scale;
+                    meanRow[i] = static_cast<float>(m);
+                    varRow[i] = static_cast<float>(std::max(0.0, sqSum * scale - m * m));
+                }
+            }
+        }
+    } // namespace
+
+    ImageBuffer<uint32_t> OptimalImage::integral() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute integral image of an empty image");
+        }
+        return buildIntegral<uint32_t, false>(*this, 0, 0, 0, 0);
+    }
+
+    ImageBuffer<uint64_t> OptimalImage::integral64() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute integral image of an empty image");
+        }
+        return buildIntegral<uint64_t, false>(*this, 0, 0, 0, 0);
+    }
+
+    ImageBuffer<uint64_t> OptimalImage::integralSquared() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute integral image of an empty image");
+        }
+        return buildIntegral<uint64_t, true>(*this, 0, 0, 0, 0);
+    }
+
+    OptimalImage OptimalImage::boxFilter(int kernelWidth, int kernelHeight) const
+    {
+        checkWindow(*this, kernelWidth, kernelHeight, "box filter");
+
+        // 窗口和的上界不小于2^31时，32位积分图会回绕、SIMD的有符号转换也会出错，改用64位积分图
+        if (!windowFitsInt32(kernelWidth, kernelHeight))
+        {
+            return boxFilterWide(*this, kernelWidth, kernelHeight);
+        }
+
+        // 窗口和小于2^31：32位积分图的回绕不影响四角相减的结果
+        int ax = kernelWidth / 2;
+        int ay = kernelHeight / 2;
+        ImageBuffer<uint32_t> sat = buildIntegral<uint32_t, false>(*this, ax, ay, kernelWidth - 1 - ax, kernelHeight - 1 - ay);
+
+        OptimalImage result(width_, height_, channels_);
+        int rowBytes = width_ * channels_;
+        int span = kernelWidth * channels_;
+        float scale = 1.0f / (static_cast<float>(kernelWidth) * kernelHeight);
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            const uint32_t *top = sat.row(y);
+            const uint32_t *bottom = sat.row(y + kernelHeight);
+            unsigned char *dst = result.data() + y * result.step();
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            __m256 vScale = _mm256_set1_ps(scale);
+            __m256 vHalf = _mm256_set1_ps(0.5f);
+            __m256i vCompact = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+            for (; i <= rowBytes - 8; i += 8)
+            {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(top + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(top + i + span));
+                __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottom + i));
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bottom + i + span));
+                __m256i sum = _mm256_add_epi32(_mm256_sub_epi32(d, c), _mm256_sub_epi32(a, b));
+                __m256 mean = _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(sum), vScale), vHalf);
+                __m256i r = _mm256_cvttps_epi32(mean);
+                r = _mm256_packus_epi32(r, r);
+                r = _mm256_packus_epi16(r, r);
+                r = _mm256_permutevar8x32_epi32(r, vCompact);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(r));
+            }
+#elif defined(__SSE2__)
+            __m128 vScale = _mm_set1_ps(scale);
+            __m128 vHalf = _mm_set1_ps(0.5f);
+            for (; i <= rowBytes - 4; i += 4)
+            {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(top + i + span));
+                __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + i));
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bottom + i + span));
+                __m128i sum = _mm_add_epi32(_mm_sub_epi32(d, c), _mm_sub_epi32(a, b));
+                __m128 mean = _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(sum), vScale), vHalf);
+                __m128i r = _mm_cvttps_epi32(mean);
+                r = _mm_packs_epi32(r, r);
+                r = _mm_packus_epi16(r, r);
+                int packed = _mm_cvtsi128_si32(r);
+                std::memcpy(dst + i, &packed, sizeof(packed));
+            }
+#endif
+#endif
+            for (; i < rowBytes; ++i)
+            {
+                uint32_t sum = bottom[i + span] - bottom[i] - top[i + span] + top[i];
+                dst[i] = static_cast<unsigned char>(static_cast<int>(static_cast<float>(sum) * scale + 0.5f));
+            }
+        }
+
+        return result;
+    }
+
+    void OptimalImage::localMeanVariance(int windowWidth, int windowHeight, ImageBuffer<float> &mean, ImageBuffer<float> &variance) const
+    {
+        checkWindow(*this, windowWidth, windowHeight, "local mean/variance");
+
+        int ax = windowWidth / 2;
+        int ay = windowHeight / 2;
+        int padRight = windowWidth - 1 - ax;
+        int padBottom = windowHeight - 1 - ay;
+        ImageBuffer<uint64_t> sqsat = buildIntegral<uint64_t, true>(*this, ax, ay, padRight, padBottom);
+
+        mean = ImageBuffer<float>(width_, height_, channels_);
+        variance = ImageBuffer<float>(width_, height_, channels_);
+
+        // 窗口和可能超过32位时改用64位积分图
+        if (windowFitsInt32(windowWidth, windowHeight))
+        {
+            ImageBuffer<uint32_t> sat = buildIntegral<uint32_t, false>(*this, ax, ay, padRight, padBottom);
+            meanVarianceFromIntegral(sat, sqsat, windowWidth, windowHeight, mean, variance);
+        }
+        else
+        {
+            ImageBuffer<uint64_t> sat = buildIntegral<uint64_t, false>(*this, ax, ay, padRight, padBottom);
+            meanVarianceFromIntegral(sat, sqsat, windowWidth, windowHeight, mean, variance);
+        }
+    }
+
+} // namespace mylib
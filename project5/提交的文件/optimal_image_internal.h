@@ -0,0 +1,94 @@
+#ifndef OPTIMAL_IMAGE_INTERNAL_H
+#define OPTIMAL_IMAGE_INTERNAL_H
+
+// 库内部使用的辅助函数，不属于公开接口，不随库安装
+
+#include "optimal_image.h"
+#include <algorithm>
+#include <cstdint>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+namespace mylib
+{
+    namespace detail
+    {
+        /**
+         * @brief 计算并行条带数，每个条带只分配一次行缓冲区
+         * @param rows 需要处理的行数
+         * @return 条带数，不超过行数和可用线程数
+         */
+        inline int stripeCount(int rows)
+        {
+#ifdef _OPENMP
+            return std::max(1, std::min(rows, omp_get_max_threads()));
+#else
+            (void)rows;
+            return 1;
+#endif
+        }
+
+        /**
+         * @brief 计算第s个条带的起始行（条带s覆盖[stripeBegin(s), stripeBegin(s + 1))）
+         */
+        inline int stripeBegin(int rows, int stripes, int s)
+        {
+            return static_cast<int>(static_cast<long long>(rows) * s / stripes);
+        }
+
+        /**
+         * @brief 分块转置：dst(x, y) = src(y, x)，以像素（channels字节）为单位
+         * @param src 源图像
+         * @param dst 目标图像，尺寸必须为src.height() × src.width()，通道数相同
+         */
+        void transposeImage(const OptimalImage &src, OptimalImage &dst);
+
+        /**
+         * @brief 将浮点结果四舍五入（与SIMD一致采用就近取偶）并饱和到[0, 255]
+         */
+        void storeRow(const float *src, unsigned char *dst, int count);
+
+        /**
+         * @brief 把一行交错像素拆成cn个单通道平面行，三/四通道使用SIMD重排
+         */
+        void splitRow(const unsigned char *src, unsigned char *const *dst, int width, int cn);
+
+        /**
+         * @brief 把cn个单通道平面行交错成一行像素，三/四通道使用SIMD重排
+         */
+        void mergeRow(const unsigned char *const *src, unsigned char *dst, int width, int cn);
+
+        /**
+         * @brief 32位整数末尾0的个数（最低的1所在的位），value不能为0
+         */
+        inline int countTrailingZeros(uint32_t value)
+        {
+#if defined(_MSC_VER)
+            unsigned long index;
+            _BitScanForward(&index, value);
+            return static_cast<int>(index);
+#else
+            return __builtin_ctz(value);
+#endif
+        }
+
+        /**
+         * @brief 64位整数中1的个数，编译器在支持popcnt的目标上生成单条指令
+         */
+        inline int popcount64(uint64_t value)
+        {
+#if defined(_MSC_VER) && defined(_M_X64)
+            return static_cast<int>(__popcnt64(value));
+#elif defined(_MSC_VER)
+            return static_cast<int>(__popcnt(static_cast<uint32_t>(value)) + __popcnt(static_cast<uint32_t>(value >> 32)));
+#else
+            return __builtin_popcountll(value);
+#endif
+        }
+    } // namespace detail
+} // namespace mylib
+
+#endif // OPTIMAL_IMAGE_INTERNAL_H
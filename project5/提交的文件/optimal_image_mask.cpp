@@ -0,0 +1,665 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+        // 一段的字节数，以及movemask在整段都选中时的返回值
+        constexpr int MASK_SPAN = 32;
+        constexpr int MASK_ALL = -1;
+        using MaskVec = __m256i;
+
+        inline MaskVec loadSpan(const unsigned char *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+
+        inline void storeSpan(unsigned char *p, MaskVec v) { _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v); }
+
+        inline int spanBits(MaskVec m) { return _mm256_movemask_epi8(m); }
+
+        inline MaskVec selectSpan(MaskVec base, MaskVec value, MaskVec m) { return _mm256_blendv_epi8(base, value, m); }
+#elif defined(__SSE2__)
+        constexpr int MASK_SPAN = 16;
+        constexpr int MASK_ALL = 0xFFFF;
+        using MaskVec = __m128i;
+
+        inline MaskVec loadSpan(const unsigned char *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+
+        inline void storeSpan(unsigned char *p, MaskVec v) { _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v); }
+
+        inline int spanBits(MaskVec m) { return _mm_movemask_epi8(m); }
+
+        inline MaskVec selectSpan(MaskVec base, MaskVec value, MaskVec m)
+        {
+#if defined(__SSE4_1__)
+            return _mm_blendv_epi8(base, value, m);
+#else
+            return _mm_or_si128(_mm_and_si128(m, value), _mm_andnot_si128(m, base));
+#endif
+        }
+#endif
+#endif
+
+        /**
+         * @brief 统一8位掩码和按位打包掩码的读取方式
+         */
+        struct MaskSource
+        {
+            const OptimalImage *bytes = nullptr;
+            const PackedMask *bits = nullptr;
+
+            /**
+             * @brief 把第y行整理成逐像素的0x00/0xFF，供blendv按字节最高位选择
+             * @return 该行是否有选中的像素；没有时sel的内容未定义
+             */
+            bool loadRow(int y, unsigned char *sel, int width) const
+            {
+                int x = 0;
+                if (bytes)
+                {
+                    const unsigned char *m = bytes->data() + y * bytes->step();
+                    int any = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+                    const __m256i zero = _mm256_setzero_si256();
+                    __m256i acc = zero;
+                    for (; x <= width - 32; x += 32)
+                    {
+                        __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(m + x));
+                        acc = _mm256_or_si256(acc, v);
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(sel + x),
+                                            _mm256_xor_si256(_mm256_cmpeq_epi8(v, zero), _mm256_set1_epi8(-1)));
+                    }
+                    any = _mm256_movemask_epi8(_mm256_cmpeq_epi8(acc, zero)) != -1;
+#elif defined(__SSE2__)
+                    const __m128i zero = _mm_setzero_si128();
+                    __m128i acc = zero;
+                    for (; x <= width - 16; x += 16)
+                    {
+                        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(m + x));
+                        acc = _mm_or_si128(acc, v);
+                        _mm_storeu_si128(reinterpret_cast<__m128i *>(sel + x),
+                                         _mm_xor_si128(_mm_cmpeq_epi8(v, zero), _mm_set1_epi8(-1)));
+                    }
+                    any = _mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF;
+#endif
+#endif
+                    for (; x < width; ++x)
+                    {
+                        sel[x] = m[x] ? 0xFF : 0;
+                        any |= m[x];
+                    }
+                    return any != 0;
+                }
+
+                // 整行的字节都为0时不必展开
+                const uint8_t *row = bits->row(y);
+                int fullBytes = width >> 3;
+                bool any = false;
+                for (int i = 0; i < fullBytes && !any; ++i)
+                {
+                    any = row[i] != 0;
+                }
+                if (!any && (width & 7))
+                {
+                    any = (row[fullBytes] & ((1 << (width & 7)) - 1)) != 0;
+                }
+                if (!any)
+                {
+                    return false;
+                }
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+                // 每次展开4个字节（32个像素）：pshufb把第j个输出字节对应到第j / 8个源字节，再测试各自的位
+                const __m256i spread = _mm256_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                                                        2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+                const __m256i bitSelect = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201ULL));
+                for (; x <= width - 32; x += 32)
+                {
+                    uint32_t word;
+                    std::memcpy(&word, row + (x >> 3), 4);
+                    __m256i v = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(word)), spread);
+                    v = _mm256_cmpeq_epi8(_mm256_and_si256(v, bitSelect), bitSelect);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(sel + x), v);
+                }
+#elif defined(__SSE2__)
+                // 每次展开2个字节（16个像素）：逐级unpack把每个源字节复制8份
+                const __m128i bitSelect = _mm_set1_epi64x(static_cast<long long>(0x8040201008040201ULL));
+                for (; x <= width - 16; x += 16)
+                {
+                    __m128i v = _mm_cvtsi32_si128(row[x >> 3] | (row[(x >> 3) + 1] << 8));
+                    v = _mm_unpacklo_epi8(v, v);
+                    v = _mm_unpacklo_epi16(v, v);
+                    v = _mm_unpacklo_epi32(v, v);
+                    v = _mm_cmpeq_epi8(_mm_and_si128(v, bitSelect), bitSelect);
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(sel + x), v);
+                }
+#endif
+#endif
+                for (; x < width; ++x)
+                {
+                    sel[x] = ((row[x >> 3] >> (x & 7)) & 1) ? 0xFF : 0;
+                }
+                return true;
+            }
+        };
+
+        /**
+         * @brief 取src中的值
+         */
+        struct CopyOp
+        {
+            const unsigned char *src;
+
+#if defined(USE_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+            MaskVec span(int i) const { return loadSpan(src + i); }
+#endif
+
+            unsigned char at(int i) const { return src[i]; }
+        };
+
+        /**
+         * @brief 饱和加上亮度增量
+         */
+        struct BrightnessOp
+        {
+            const unsigned char *src;
+            int delta;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            MaskVec span(int i) const
+            {
+                __m256i v = loadSpan(src + i);
+                return delta >= 0 ? _mm256_adds_epu8(v, _mm256_set1_epi8(static_cast<char>(delta)))
+                                  : _mm256_subs_epu8(v, _mm256_set1_epi8(static_cast<char>(-delta)));
+            }
+#elif defined(__SSE2__)
+            MaskVec span(int i) const
+            {
+                __m128i v = loadSpan(src + i);
+                return delta >= 0 ? _mm_adds_epu8(v, _mm_set1_epi8(static_cast<char>(delta)))
+                                  : _mm_subs_epu8(v, _mm_set1_epi8(static_cast<char>(-delta)));
+            }
+#endif
+#endif
+
+            unsigned char at(int i) const { return static_cast<unsigned char>(std::clamp(src[i] + delta, 0, 255)); }
+        };
+
+        /**
+         * @brief 8位定点混合：(a × w + b × (256 - w) + 128) >> 8，16位无符号运算不会溢出
+         */
+        struct BlendOp
+        {
+            const unsigned char *a;
+            const unsigned char *b;
+            int weight;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            MaskVec span(int i) const
+            {
+                const __m256i zero = _mm256_setzero_si256();
+                const __m256i wa = _mm256_set1_epi16(static_cast<short>(weight));
+                const __m256i wb = _mm256_set1_epi16(static_cast<short>(256 - weight));
+                const __m256i half = _mm256_set1_epi16(128);
+                __m256i va = loadSpan(a + i);
+                __m256i vb = loadSpan(b + i);
+                __m256i lo = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(va, zero), wa),
+                                              _mm256_mullo_epi16(_mm256_unpacklo_epi8(vb, zero), wb));
+                __m256i hi = _mm256_add_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(va, zero), wa),
+                                              _mm256_mullo_epi16(_mm256_unpackhi_epi8(vb, zero), wb));
+                lo = _mm256_srli_epi16(_mm256_add_epi16(lo, half), 8);
+                hi = _mm256_srli_epi16(_mm256_add_epi16(hi, half), 8);
+                return _mm256_packus_epi16(lo, hi);
+            }
+#elif defined(__SSE2__)
+            MaskVec span(int i) const
+            {
+                const __m128i zero = _mm_setzero_si128();
+                const __m128i wa = _mm_set1_epi16(static_cast<short>(weight));
+                const __m128i wb = _mm_set1_epi16(static_cast<short>(256 - weight));
+                const __m128i half = _mm_set1_epi16(128);
+                __m128i va = loadSpan(a + i);
+                __m128i vb = loadSpan(b + i);
+                __m128i lo = _mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(va, zero), wa),
+                                           _mm_mullo_epi16(_mm_unpacklo_epi8(vb, zero), wb));
+                __m128i hi = _mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(va, zero), wa),
+                                           _mm_mullo_epi16(_mm_unpackhi_epi8(vb, zero), wb));
+                lo = _mm_srli_epi16(_mm_add_epi16(lo, half), 8);
+                hi = _mm_srli_epi16(_mm_add_epi16(hi, half), 8);
+                return _mm_packus_epi16(lo, hi);
+            }
+#endif
+#endif
+
+            unsigned char at(int i) const { return static_cast<unsigned char>((a[i] * weight + b[i] * (256 - weight) + 128) >> 8); }
+        };
+
+        /**
+         * @brief dst[i] = mask[i] ? op(i) : base[i]，按段处理：
+         * 掩码全为0的段不计算op（base与dst相同时不读写），全选中的段直接存op的结果，其余段用blendv选择
+         */
+        template <typename Op>
+        void maskedRow(const unsigned char *base, unsigned char *dst, const unsigned char *mask, int count, const Op &op)
+        {
+            int i = 0;
+#if defined(USE_SIMD) && (defined(__AVX2__) || defined(__SSE2__))
+            for (; i <= count - MASK_SPAN; i += MASK_SPAN)
+            {
+                MaskVec m = loadSpan(mask + i);
+                int bits = spanBits(m);
+                if (bits == 0)
+                {
+                    if (base != dst)
+                    {
+                        std::memcpy(dst + i, base + i, MASK_SPAN);
+                    }
+                    continue;
+                }
+                MaskVec value = op.span(i);
+                storeSpan(dst + i, bits == MASK_ALL ? value : selectSpan(loadSpan(base + i), value, m));
+            }
+#endif
+            for (; i < count; ++i)
+            {
+                dst[i] = mask[i] ? op.at(i) : base[i];
+            }
+        }
+
+        /**
+         * @brief 按行条带并行地执行dst = mask ? op : base
+         * makeOp(y, scratch)为第y行生成运算，只对有选中像素的行调用；scratch是条带私有的行缓冲区（width × channels字节）
+         */
+        template <typename MakeOp>
+        void applyMasked(const OptimalImage &base, OptimalImage &dst, const MaskSource &mask, MakeOp makeOp)
+        {
+            int width = dst.width();
+            int height = dst.height();
+            int cn = dst.channels();
+            int count = width * cn;
+            int pixelCount = width * height;
+            int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+
+#pragma omp parallel for if (stripes > 1)
+            for (int s = 0; s < stripes; ++s)
+            {
+                std::vector<unsigned char> sel(width);
+                std::vector<unsigned char> expanded(cn > 1 ? count : 0);
+                std::vector<unsigned char> scratch(count);
+                std::vector<const unsigned char *> planes(cn, sel.data());
+
+                int yEnd = detail::stripeBegin(height, stripes, s + 1);
+                for (int y = detail::stripeBegin(height, stripes, s); y < yEnd; ++y)
+                {
+                    const unsigned char *baseRow = base.data() + y * base.step();
+                    unsigned char *dstRow = dst.data() + y * dst.step();
+                    if (!mask.loadRow(y, sel.data(), width))
+                    {
+                        if (baseRow != dstRow)
+                        {
+                            std::memcpy(dstRow, baseRow, count);
+                        }
+                        continue;
+                    }
+
+                    // 多通道时把逐像素掩码复制到每个通道，之后按字节流处理
+                    const unsigned char *m = sel.data();
+                    if (cn > 1)
+                    {
+                        detail::mergeRow(planes.data(), expanded.data(), width, cn);
+                        m = expanded.data();
+                    }
+                    maskedRow(baseRow, dstRow, m, count, makeOp(y, scratch.data()));
+                }
+            }
+        }
+
+        void checkMask(const OptimalImage &mask, int width, int height)
+        {
+            if (mask.empty() || mask.channels() != 1 || mask.width() != width || mask.height() != height)
+            {
+                std::stringstream ss;
+                ss << "Mask must be a single-channel " << width << "x" << height << " image, but got "
+                   << mask.width() << "x" << mask.height() << "x" << mask.channels();
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        void checkMask(const PackedMask &mask, int width, int height)
+        {
+            if (mask.width != width || mask.height != height || mask.stride != (width + 7) / 8 ||
+                mask.bits.size() < static_cast<size_t>(mask.stride) * height)
+            {
+                std::stringstream ss;
+                ss << "Packed mask must be " << width << "x" << height << ", but got "
+                   << mask.width << "x" << mask.height << " with stride " << mask.stride;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        MaskSource maskSource(const OptimalImage &mask)
+        {
+            MaskSource source;
+            source.bytes = &mask;
+            return source;
+        }
+
+        MaskSource maskSource(const PackedMask &mask)
+        {
+            MaskSource source;
+            source.bits = &mask;
+            return source;
+        }
+
+        void copyMasked(const OptimalImage &src, OptimalImage &dst, const MaskSource &mask)
+        {
+            applyMasked(dst, dst, mask, [&src](int y, unsigned char *)
+                        { return CopyOp{src.data() + y * src.step()}; });
+        }
+
+        void adjustBrightnessMasked(OptimalImage &image, int delta, const MaskSource &mask)
+        {
+            if (delta < -255 || delta > 255)
+            {
+                std::stringstream ss;
+                ss << "Brightness delta must be in range [-255, 255], but got " << delta;
+                throw InvalidArgumentException(ss.str());
+            }
+
+            // 确保数据可修改（如果多处引用，会创建副本）
+            image.copyOnWrite();
+            applyMasked(image, image, mask, [&image, delta](int y, unsigned char *)
+                        { return BrightnessOp{image.data() + y * image.step(), delta}; });
+        }
+
+        OptimalImage blendMasked(const OptimalImage &img1, const OptimalImage &img2, float alpha, const MaskSource &mask)
+        {
+            if (alpha < 0.0f || alpha > 1.0f)
+            {
+                std::stringstream ss;
+                ss << "Alpha must be in range [0, 1], but got " << alpha;
+                throw InvalidArgumentException(ss.str());
+            }
+
+            if (img2.width() != img1.width() || img2.height() != img1.height() || img2.channels() != img1.channels())
+            {
+                std::stringstream ss;
+                ss << "Images must match for blending. "
+                   << "First image: " << img1.width() << "x" << img1.height() << "x" << img1.channels()
+                   << ", Second image: " << img2.width() << "x" << img2.height() << "x" << img2.channels();
+                throw InvalidArgumentException(ss.str());
+            }
+
+            OptimalImage result(img1.width(), img1.height(), img1.channels());
+            int weight = static_cast<int>(std::lround(alpha * 256.0f));
+            applyMasked(img1, result, mask, [&img1, &img2, weight](int y, unsigned char *)
+                        { return BlendOp{img1.data() + y * img1.step(), img2.data() + y * img2.step(), weight}; });
+            return result;
+        }
+
+        /**
+         * @brief 与gaussianBlur相同的核与取整方式，但只计算掩码外接矩形内的结果
+         * 水平滤波覆盖外接矩形上下各扩展radius行，垂直滤波在applyMasked中逐行计算到条带缓冲区，没有选中像素的行不计算
+         */
+        OptimalImage gaussianBlurMasked(const OptimalImage &src, int kernelSize, double sigma, const MaskSource &mask)
+        {
+            if (kernelSize <= 0 || kernelSize % 2 == 0)
+            {
+                std::stringstream ss;
+                ss << "Kernel size must be a positive odd number, but got " << kernelSize;
+                throw InvalidArgumentException(ss.str());
+            }
+
+            if (sigma <= 0.0)
+            {
+                std::stringstream ss;
+                ss << "Sigma must be positive, but got " << sigma;
+                throw InvalidArgumentException(ss.str());
+            }
+
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            OptimalImage result(width, height, cn);
+
+            // 掩码的外接矩形
+            int left = width;
+            int right = -1;
+            int top = height;
+            int bottom = -1;
+            std::vector<unsigned char> sel(width);
+            for (int y = 0; y < height; ++y)
+            {
+                if (!mask.loadRow(y, sel.data(), width))
+                {
+                    continue;
+                }
+                top = std::min(top, y);
+                bottom = y;
+                int first = 0;
+                while (!sel[first])
+                {
+                    ++first;
+                }
+                int last = width - 1;
+                while (!sel[last])
+                {
+                    --last;
+                }
+                left = std::min(left, first);
+                right = std::max(right, last);
+            }
+
+            if (bottom < 0)
+            {
+                // 没有选中的像素，结果就是原图的拷贝
+                for (int y = 0; y < height; ++y)
+                {
+                    std::memcpy(result.data() + y * result.step(), src.data() + y * src.step(), static_cast<size_t>(width) * cn);
+                }
+                return result;
+            }
+
+            std::vector<float> kernel(kernelSize);
+            float kernelSum = 0.0f;
+            int radius = kernelSize / 2;
+            for (int i = 0; i < kernelSize; ++i)
+            {
+                int x = i - radius;
+                kernel[i] = static_cast<float>(exp(-(x * x) / (2 * sigma * sigma)));
+                kernelSum += kernel[i];
+            }
+            for (int i = 0; i < kernelSize; ++i)
+            {
+                kernel[i] /= kernelSum;
+            }
+
+            // 水平方向模糊：只算外接矩形的列，行向上下扩展radius
+            int tempTop = std::max(0, top - radius);
+            int tempBottom = std::min(height - 1, bottom + radius);
+            int tempRows = tempBottom - tempTop + 1;
+            int regionWidth = right - left + 1;
+            size_t tempStep = static_cast<size_t>(regionWidth) * cn;
+            std::vector<unsigned char> temp(tempStep * tempRows);
+            const unsigned char *srcData = src.data();
+            size_t srcStep = src.step();
+            int pixelCount = regionWidth * tempRows;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int r = 0; r < tempRows; ++r)
+            {
+                const unsigned char *in = srcData + (tempTop + r) * srcStep;
+                unsigned char *out = temp.data() + r * tempStep;
+                for (int x = left; x <= right; ++x)
+                {
+                    for (int c = 0; c < cn; ++c)
+                    {
+                        float sum = 0.0f;
+                        for (int i = -radius; i <= radius; ++i)
+                        {
+                            int sampleX = std::clamp(x + i, 0, width - 1);
+                            sum += in[sampleX * cn + c] * kernel[i + radius];
+                        }
+                        out[(x - left) * cn + c] = static_cast<unsigned char>(sum + 0.5f);
+                    }
+                }
+            }
+
+            // 垂直方向模糊与按掩码合成：模糊结果写入条带缓冲区的外接矩形列，选中的像素只会落在这些列上
+            auto blurRow = [&](int y, unsigned char *scratch)
+            {
+                unsigned char *out = scratch + static_cast<size_t>(left) * cn;
+                for (size_t j = 0; j < tempStep; ++j)
+                {
+                    float sum = 0.0f;
+                    for (int i = -radius; i <= radius; ++i)
+                    {
+                        int sampleY = std::clamp(y + i, 0, height - 1);
+                        sum += temp[(sampleY - tempTop) * tempStep + j] * kernel[i + radius];
+                    }
+                    out[j] = static_cast<unsigned char>(sum + 0.5f);
+                }
+                return CopyOp{scratch};
+            };
+            applyMasked(src, result, mask, blurRow);
+            return result;
+        }
+    } // namespace
+
+    void OptimalImage::copyTo(OptimalImage &dst, const OptimalImage &mask) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot copy an empty image");
+        }
+
+        checkMask(mask, width_, height_);
+        if (dst.empty())
+        {
+            dst.create(width_, height_, channels_);
+        }
+        else if (dst.width() != width_ || dst.height() != height_ || dst.channels() != channels_)
+        {
+            std::stringstream ss;
+            ss << "Destination must be " << width_ << "x" << height_ << "x" << channels_ << ", but got "
+               << dst.width() << "x" << dst.height() << "x" << dst.channels();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        dst.copyOnWrite();
+        copyMasked(*this, dst, maskSource(mask));
+    }
+
+    void OptimalImage::copyTo(OptimalImage &dst, const PackedMask &mask) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot copy an empty image");
+        }
+
+        checkMask(mask, width_, height_);
+        if (dst.empty())
+        {
+            dst.create(width_, height_, channels_);
+        }
+        else if (dst.width() != width_ || dst.height() != height_ || dst.channels() != channels_)
+        {
+            std::stringstream ss;
+            ss << "Destination must be " << width_ << "x" << height_ << "x" << channels_ << ", but got "
+               << dst.width() << "x" << dst.height() << "x" << dst.channels();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        dst.copyOnWrite();
+        copyMasked(*this, dst, maskSource(mask));
+    }
+
+    void OptimalImage::adjustBrightness(int delta, const OptimalImage &mask)
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot adjust brightness of an empty image");
+        }
+
+        checkMask(mask, width_, height_);
+        adjustBrightnessMasked(*this, delta, maskSource(mask));
+    }
+
+    void OptimalImage::adjustBrightness(int delta, const PackedMask &mask)
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot adjust brightness of an empty image");
+        }
+
+        checkMask(mask, width_, height_);
+        adjustBrightnessMasked(*this, delta, maskSource(mask));
+    }
+
+    OptimalImage OptimalImage::blend(const OptimalImage &img1, const OptimalImage &img2, float alpha, const OptimalImage &mask)
+    {
+        if (img1.empty() || img2.empty())
+        {
+            throw InvalidArgumentException("Cannot blend empty images");
+        }
+
+        checkMask(mask, img1.width(), img1.height());
+        return blendMasked(img1, img2, alpha, maskSource(mask));
+    }
+
+    OptimalImage OptimalImage::blend(const OptimalImage &img1, const OptimalImage &img2, float alpha, const PackedMask &mask)
+    {
+        if (img1.empty() || img2.empty())
+        {
+            throw InvalidArgumentException("Cannot blend empty images");
+        }
+
+        checkMask(mask, img1.width(), img1.height());
+        return blendMasked(img1, img2, alpha, maskSource(mask));
+    }
+
+    OptimalImage OptimalImage::gaussianBlur(int kernelSize, double sigma, const OptimalImage &mask) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply Gaussian blur to an empty image");
+        }
+
+        checkMask(mask, width_, height_);
+        return gaussianBlurMasked(*this, kernelSize, sigma, maskSource(mask));
+    }
+
+    OptimalImage OptimalImage::gaussianBlur(int kernelSize, double sigma, const PackedMask &mask) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply Gaussian blur to an empty image");
+        }
+
+        checkMask(mask, width_, height_);
+        return gaussianBlurMasked(*this, kernelSize, sigma, maskSource(mask));
+    }
+
+} // namespace mylib
@@ -0,0 +1,239 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 16位计数器能容纳的最大窗口为255x255
+        constexpr int MEDIAN_MAX_RADIUS = 127;
+
+        constexpr int HIST_BINS = 256;
+        constexpr int COARSE_BINS = 16; // 粗直方图：每个粗桶对应16个细桶
+
+        /**
+         * @brief 直方图增量更新：hist += add - sub，n为16位计数的个数（16的倍数）
+         */
+        inline void histUpdate(uint16_t *hist, const uint16_t *add, const uint16_t *sub, int n)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i < n; i += 16)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(hist + i));
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(add + i));
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sub + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(hist + i), _mm256_add_epi16(h, _mm256_sub_epi16(a, s)));
+            }
+#elif defined(__SSE2__)
+            for (; i < n; i += 8)
+            {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hist + i));
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(add + i));
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sub + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(hist + i), _mm_add_epi16(h, _mm_sub_epi16(a, s)));
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                hist[i] = static_cast<uint16_t>(hist[i] + add[i] - sub[i]);
+            }
+        }
+
+        /**
+         * @brief 直方图累加：hist += add
+         */
+        inline void histAdd(uint16_t *hist, const uint16_t *add, int n)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i < n; i += 16)
+            {
+                __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(hist + i));
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(add + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(hist + i), _mm256_add_epi16(h, a));
+            }
+#elif defined(__SSE2__)
+            for (; i < n; i += 8)
+            {
+                __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i *>(hist + i));
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(add + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(hist + i), _mm_add_epi16(h, a));
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                hist[i] = static_cast<uint16_t>(hist[i] + add[i]);
+            }
+        }
+
+        /**
+         * @brief 在粗/细两级直方图中查找第target个（从1开始）值：先在16个粗桶中定位，再在对应的16个细桶中定位
+         */
+        inline unsigned char histMedian(const uint16_t *coarse, const uint16_t *fine, int target)
+        {
+            int sum = 0;
+            int bucket = 0;
+            while (sum + coarse[bucket] < target)
+            {
+                sum += coarse[bucket];
+                ++bucket;
+            }
+
+            const uint16_t *segment = fine + bucket * COARSE_BINS;
+            int bin = 0;
+            while (sum + segment[bin] < target)
+            {
+                sum += segment[bin];
+                ++bin;
+            }
+            return static_cast<unsigned char>(bucket * COARSE_BINS + bin);
+        }
+
+        /**
+         * @brief 对一个水平条带[y0, y1)的一个通道做中值滤波
+         * @param colFine 每列的细直方图，width × 256
+         * @param colCoarse 每列的粗直方图，width × 16
+         */
+        void medianStrip(const OptimalImage &src, OptimalImage &dst, int channel, int radius, int y0, int y1,
+                         std::vector<uint16_t> &colFine, std::vector<uint16_t> &colCoarse)
+        {
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            size_t srcStep = src.step();
+            size_t dstStep = dst.step();
+            const unsigned char *srcData = src.data();
+            unsigned char *dstData = dst.data();
+
+            int windowSize = 2 * radius + 1;
+            int target = windowSize * windowSize / 2 + 1;
+
+            // 初始化列直方图，覆盖第y0行的窗口[y0 - r, y0 + r]
+            std::fill(colFine.begin(), colFine.end(), 0);
+            std::fill(colCoarse.begin(), colCoarse.end(), 0);
+            for (int k = -radius; k <= radius; ++k)
+            {
+                const unsigned char *row = srcData + std::clamp(y0 + k, 0, height - 1) * srcStep + channel;
+                for (int x = 0; x < width; ++x)
+                {
+                    unsigned char v = row[x * cn];
+                    ++colFine[static_cast<size_t>(x) * HIST_BINS + v];
+                    ++colCoarse[static_cast<size_t>(x) * COARSE_BINS + (v >> 4)];
+                }
+            }
+
+            alignas(32) uint16_t kernelFine[HIST_BINS];
+            alignas(32) uint16_t kernelCoarse[COARSE_BINS];
+
+            for (int y = y0; y < y1; ++y)
+            {
+                // 列直方图下移一行：移除离开窗口的行，加入进入窗口的行
+                if (y > y0)
+                {
+                    const unsigned char *oldRow = srcData + std::clamp(y - radius - 1, 0, height - 1) * srcStep + channel;
+                    const unsigned char *newRow = srcData + std::clamp(y + radius, 0, height - 1) * srcStep + channel;
+                    for (int x = 0; x < width; ++x)
+                    {
+                        unsigned char vOld = oldRow[x * cn];
+                        unsigned char vNew = newRow[x * cn];
+                        uint16_t *fine = colFine.data() + static_cast<size_t>(x) * HIST_BINS;
+                        uint16_t *coarse = colCoarse.data() + static_cast<size_t>(x) * COARSE_BINS;
+                        --fine[vOld];
+                        --coarse[vOld >> 4];
+                        ++fine[vNew];
+                        ++coarse[vNew >> 4];
+                    }
+                }
+
+                // 每行开头重新合成核直方图（O(r)，摊销到整行）
+                std::memset(kernelFine, 0, sizeof(kernelFine));
+                std::memset(kernelCoarse, 0, sizeof(kernelCoarse));
+                for (int k = -radius; k <= radius; ++k)
+                {
+                    int x = std::clamp(k, 0, width - 1);
+                    histAdd(kernelFine, colFine.data() + static_cast<size_t>(x) * HIST_BINS, HIST_BINS);
+                    histAdd(kernelCoarse, colCoarse.data() + static_cast<size_t>(x) * COARSE_BINS, COARSE_BINS);
+                }
+
+                unsigned char *dstRow = dstData + y * dstStep + channel;
+                for (int x = 0; x < width; ++x)
+                {
+                    // 核直方图右移一列：加入x + r列，移除x - r - 1列，每像素开销固定
+                    if (x > 0)
+                    {
+                        size_t addCol = static_cast<size_t>(std::min(x + radius, width - 1));
+                        size_t subCol = static_cast<size_t>(std::max(x - radius - 1, 0));
+                        histUpdate(kernelFine, colFine.data() + addCol * HIST_BINS, colFine.data() + subCol * HIST_BINS, HIST_BINS);
+                        histUpdate(kernelCoarse, colCoarse.data() + addCol * COARSE_BINS, colCoarse.data() + subCol * COARSE_BINS, COARSE_BINS);
+                    }
+                    dstRow[x * cn] = histMedian(kernelCoarse, kernelFine, target);
+                }
+            }
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::medianBlur(int radius) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply median blur to an empty image");
+        }
+
+        if (radius < 0 || radius > MEDIAN_MAX_RADIUS)
+        {
+            std::stringstream ss;
+            ss << "Median radius must be in range [0, " << MEDIAN_MAX_RADIUS << "], but got " << radius;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (radius == 0)
+        {
+            return clone();
+        }
+
+        OptimalImage result(width_, height_, channels_);
+        int stripes = detail::stripeCount(height_);
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int s = 0; s < stripes; ++s)
+        {
+            int y0 = detail::stripeBegin(height_, stripes, s);
+            int y1 = detail::stripeBegin(height_, stripes, s + 1);
+
+            // 列直方图按通道复用，每个条带只分配一次
+            std::vector<uint16_t> colFine(static_cast<size_t>(width_) * HIST_BINS);
+            std::vector<uint16_t> colCoarse(static_cast<size_t>(width_) * COARSE_BINS);
+            for (int c = 0; c < channels_; ++c)
+            {
+                medianStrip(*this, result, c, radius, y0, y1, colFine, colCoarse);
+            }
+        }
+
+        return result;
+    }
+
+} // namespace mylib
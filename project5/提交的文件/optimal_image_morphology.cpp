@@ -0,0 +1,252 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 垂直方向每次处理的列宽（字节），后缀缓冲区为(height + k - 1) × MORPH_COLUMN_BLOCK
+        constexpr int MORPH_COLUMN_BLOCK = 256;
+
+        /**
+         * @brief 逐字节取最小值（腐蚀）或最大值（膨胀）：dst = op(a, b)
+         */
+        template <bool IsMin>
+        void rowOp(const unsigned char *a, const unsigned char *b, unsigned char *dst, int count)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= count - 32; i += 32)
+            {
+                __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                __m256i r = IsMin ? _mm256_min_epu8(va, vb) : _mm256_max_epu8(va, vb);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), r);
+            }
+#elif defined(__SSE2__)
+            for (; i <= count - 16; i += 16)
+            {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                __m128i r = IsMin ? _mm_min_epu8(va, vb) : _mm_max_epu8(va, vb);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), r);
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                dst[i] = IsMin ? std::min(a[i], b[i]) : std::max(a[i], b[i]);
+            }
+        }
+
+        /**
+         * @brief 沿垂直方向做van Herk/Gil-Werman滑动最小/最大值，每行的所有列同时处理
+         * 将补齐后的序列按k行分块：后缀h从块尾向前累积，前缀g从块首向后累积，
+         * 窗口[p, p + k - 1]的结果为op(h[p], g[p + k - 1])，每个输出只需3次比较
+         * 超出图像的行取运算的单位元（最小值取255，最大值取0），即不参与计算
+         */
+        template <bool IsMin>
+        void vanHerkVertical(const OptimalImage &src, OptimalImage &dst, int k)
+        {
+            int height = src.height();
+            int rowBytes = src.width() * src.channels();
+            size_t srcStep = src.step();
+            size_t dstStep = dst.step();
+            const unsigned char *srcData = src.data();
+            unsigned char *dstData = dst.data();
+
+            int anchor = k / 2;
+            int padded = height + k - 1;
+            unsigned char identity = IsMin ? 255 : 0;
+            int blocks = (rowBytes + MORPH_COLUMN_BLOCK - 1) / MORPH_COLUMN_BLOCK;
+            int pixelCount = src.width() * height;
+
+#pragma omp parallel if (pixelCount > OPTIMIZATION_THRESHOLD)
+            {
+                std::vector<unsigned char> suffix(static_cast<size_t>(padded) * MORPH_COLUMN_BLOCK);
+                std::vector<unsigned char> prefix(MORPH_COLUMN_BLOCK);
+                std::vector<unsigned char> identityRow(MORPH_COLUMN_BLOCK, identity);
+
+#pragma omp for
+                for (int blk = 0; blk < blocks; ++blk)
+                {
+                    int c0 = blk * MORPH_COLUMN_BLOCK;
+                    int bw = std::min(MORPH_COLUMN_BLOCK, rowBytes - c0);
+
+                    // 补齐后的第p行对应源图像的第p - anchor行
+                    auto rowAt = [&](int p) -> const unsigned char *
+                    {
+                        int y = p - anchor;
+                        return (y >= 0 && y < height) ? srcData + y * srcStep + c0 : identityRow.data();
+                    };
+
+                    // 后缀：块内从后向前累积
+                    for (int p = padded - 1; p >= 0; --p)
+                    {
+                        unsigned char *h = suffix.data() + static_cast<size_t>(p) * MORPH_COLUMN_BLOCK;
+                        if (p % k == k - 1 || p == padded - 1)
+                        {
+                            std::memcpy(h, rowAt(p), bw);
+                        }
+                        else
+                        {
+                            rowOp<IsMin>(h + MORPH_COLUMN_BLOCK, rowAt(p), h, bw);
+                        }
+                    }
+
+                    // 前缀：块内从前向后累积，累积到窗口末尾时输出
+                    for (int p = 0; p < padded; ++p)
+                    {
+                        if (p % k == 0)
+                        {
+                            std::memcpy(prefix.data(), rowAt(p), bw);
+                        }
+                        else
+                        {
+                            rowOp<IsMin>(prefix.data(), rowAt(p), prefix.data(), bw);
+                        }
+
+                        int y = p - (k - 1);
+                        if (y >= 0)
+                        {
+                            const unsigned char *h = suffix.data() + static_cast<size_t>(y) * MORPH_COLUMN_BLOCK;
+                            rowOp<IsMin>(h, prefix.data(), dstData + y * dstStep + c0, bw);
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 矩形结构元素的腐蚀/膨胀：垂直方向直接计算，水平方向先转置成垂直方向再转置回来
+         */
+        template <bool IsMin>
+        OptimalImage morphologyRect(const OptimalImage &src, int kernelWidth, int kernelHeight)
+        {
+            OptimalImage vertical = src;
+            if (kernelHeight > 1)
+            {
+                vertical = OptimalImage(src.width(), src.height(), src.channels());
+                vanHerkVertical<IsMin>(src, vertical, kernelHeight);
+            }
+
+            if (kernelWidth == 1)
+            {
+                return kernelHeight > 1 ? vertical : src.clone();
+            }
+
+            OptimalImage transposed(src.height(), src.width(), src.channels());
+            detail::transposeImage(vertical, transposed);
+            OptimalImage filtered(src.height(), src.width(), src.channels());
+            vanHerkVertical<IsMin>(transposed, filtered, kernelWidth);
+
+            OptimalImage result(src.width(), src.height(), src.channels());
+            detail::transposeImage(filtered, result);
+            return result;
+        }
+
+        void checkElementSize(const OptimalImage &img, int kernelWidth, int kernelHeight, const char *operation)
+        {
+            if (img.empty())
+            {
+                std::stringstream ss;
+                ss << "Cannot apply " << operation << " to an empty image";
+                throw OperationFailedException(ss.str());
+            }
+
+            if (kernelWidth <= 0 || kernelHeight <= 0)
+            {
+                std::stringstream ss;
+                ss << "Structuring element size must be positive, but got " << kernelWidth << "x" << kernelHeight;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::erode(int kernelWidth, int kernelHeight) const
+    {
+        checkElementSize(*this, kernelWidth, kernelHeight, "erode");
+        return morphologyRect<true>(*this, kernelWidth, kernelHeight);
+    }
+
+    OptimalImage OptimalImage::dilate(int kernelWidth, int kernelHeight) const
+    {
+        checkElementSize(*this, kernelWidth, kernelHeight, "dilate");
+        return morphologyRect<false>(*this, kernelWidth, kernelHeight);
+    }
+
+    OptimalImage OptimalImage::morphOpen(int kernelWidth, int kernelHeight) const
+    {
+        checkElementSize(*this, kernelWidth, kernelHeight, "morphological opening");
+        return morphologyRect<false>(morphologyRect<true>(*this, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+    }
+
+    OptimalImage OptimalImage::morphClose(int kernelWidth, int kernelHeight) const
+    {
+        checkElementSize(*this, kernelWidth, kernelHeight, "morphological closing");
+        return morphologyRect<true>(morphologyRect<false>(*this, kernelWidth, kernelHeight), kernelWidth, kernelHeight);
+    }
+
+    OptimalImage OptimalImage::morphGradient(int kernelWidth, int kernelHeight) const
+    {
+        checkElementSize(*this, kernelWidth, kernelHeight, "morphological gradient");
+
+        OptimalImage dilated = morphologyRect<false>(*this, kernelWidth, kernelHeight);
+        OptimalImage eroded = morphologyRect<true>(*this, kernelWidth, kernelHeight);
+
+        // 膨胀结果总是不小于腐蚀结果，直接在膨胀结果上原地相减
+        dilated.copyOnWrite();
+        int rowBytes = width_ * channels_;
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            unsigned char *d = dilated.data() + y * dilated.step();
+            const unsigned char *e = eroded.data() + y * eroded.step();
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= rowBytes - 32; i += 32)
+            {
+                __m256i vd = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(d + i));
+                __m256i ve = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(e + i));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(d + i), _mm256_subs_epu8(vd, ve));
+            }
+#elif defined(__SSE2__)
+            for (; i <= rowBytes - 16; i += 16)
+            {
+                __m128i vd = _mm_loadu_si128(reinterpret_cast<const __m128i *>(d + i));
+                __m128i ve = _mm_loadu_si128(reinterpret_cast<const __m128i *>(e + i));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(d + i), _mm_subs_epu8(vd, ve));
+            }
+#endif
+#endif
+            for (; i < rowBytes; ++i)
+            {
+                d[i] = static_cast<unsigned char>(d[i] - e[i]);
+            }
+        }
+
+        return dilated;
+    }
+
+} // namespace mylib
@@ -0,0 +1,557 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 行缓冲区左右两侧各预留的像素数，用复制边缘像素填充，内层循环无需再判断边界
+        constexpr int PYR_BORDER = 2;
+
+        // 行缓冲区尾部额外预留的元素数，保证SIMD整块加载不越界
+        constexpr int PYR_SLACK = 16;
+
+        /**
+         * @brief 垂直5抽头二项式滤波：dst = r0 + 4*r1 + 6*r2 + 4*r3 + r4（结果最大4080，用16位保存）
+         */
+        void pyrDownVertical(const unsigned char *const *rows, unsigned short *dst, int count)
+        {
+            const unsigned char *r0 = rows[0];
+            const unsigned char *r1 = rows[1];
+            const unsigned char *r2 = rows[2];
+            const unsigned char *r3 = rows[3];
+            const unsigned char *r4 = rows[4];
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= count - 16; i += 16)
+            {
+                __m256i v0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + i)));
+                __m256i v1 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r1 + i)));
+                __m256i v2 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r2 + i)));
+                __m256i v3 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r3 + i)));
+                __m256i v4 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r4 + i)));
+
+                __m256i sum = _mm256_add_epi16(v0, v4);
+                sum = _mm256_add_epi16(sum, _mm256_slli_epi16(_mm256_add_epi16(v1, v3), 2));
+                sum = _mm256_add_epi16(sum, _mm256_add_epi16(_mm256_slli_epi16(v2, 2), _mm256_slli_epi16(v2, 1)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), sum);
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 8; i += 8)
+            {
+                __m128i v0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r0 + i)), zero);
+                __m128i v1 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r1 + i)), zero);
+                __m128i v2 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r2 + i)), zero);
+                __m128i v3 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r3 + i)), zero);
+                __m128i v4 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r4 + i)), zero);
+
+                __m128i sum = _mm_add_epi16(v0, v4);
+                sum = _mm_add_epi16(sum, _mm_slli_epi16(_mm_add_epi16(v1, v3), 2));
+                sum = _mm_add_epi16(sum, _mm_add_epi16(_mm_slli_epi16(v2, 2), _mm_slli_epi16(v2, 1)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), sum);
+            }
+#endif
+#endif
+
+            for (; i < count; ++i)
+            {
+                dst[i] = static_cast<unsigned short>(r0[i] + r4[i] + 4 * (r1[i] + r3[i]) + 6 * r2[i]);
+            }
+        }
+
+        /**
+         * @brief 用复制边缘像素填充行缓冲区两侧的PYR_BORDER个像素
+         */
+        void replicateBorder(unsigned short *row, int width, int cn)
+        {
+            for (int b = 1; b <= PYR_BORDER; ++b)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    row[-b * cn + c] = row[c];
+                    row[(width - 1 + b) * cn + c] = row[(width - 1) * cn + c];
+                }
+            }
+        }
+
+        /**
+         * @brief 水平5抽头滤波并2倍抽取，只计算偶数列：(v[-2] + 4v[-1] + 6v[0] + 4v[1] + v[2] + 128) >> 8
+         */
+        void pyrDownHorizontal(const unsigned short *row, unsigned char *dst, int dstWidth, int cn)
+        {
+            int x = 0;
+
+#if defined(USE_SIMD) && defined(__AVX2__)
+            // 单通道：每个32位元素的低16位为偶数列，高16位为奇数列，抽取无需额外的shuffle
+            if (cn == 1)
+            {
+                const __m256i lowMask = _mm256_set1_epi32(0xFFFF);
+                const __m256i delta = _mm256_set1_epi32(128);
+                for (; x <= dstWidth - 8; x += 8)
+                {
+                    const unsigned short *p = row + 2 * x;
+                    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p - 2)); // v[-2], v[-1]
+                    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));     // v[0], v[1]
+                    __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 2)); // v[2]
+
+                    __m256i sum = _mm256_add_epi32(_mm256_and_si256(a, lowMask), _mm256_and_si256(c, lowMask));
+                    __m256i odd = _mm256_add_epi32(_mm256_srli_epi32(a, 16), _mm256_srli_epi32(b, 16));
+                    __m256i center = _mm256_and_si256(b, lowMask);
+                    sum = _mm256_add_epi32(sum, _mm256_slli_epi32(odd, 2));
+                    sum = _mm256_add_epi32(sum, _mm256_add_epi32(_mm256_slli_epi32(center, 2), _mm256_slli_epi32(center, 1)));
+                    sum = _mm256_srli_epi32(_mm256_add_epi32(sum, delta), 8);
+
+                    __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(sum, sum), 0x08);
+                    __m128i packed8 = _mm_packus_epi16(_mm256_castsi256_si128(packed), _mm_setzero_si128());
+                    _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + x), packed8);
+                }
+            }
+#endif
+
+            for (; x < dstWidth; ++x)
+            {
+                const unsigned short *p = row + 2 * x * cn;
+                for (int c = 0; c < cn; ++c)
+                {
+                    int sum = p[c - 2 * cn] + p[c + 2 * cn] + 4 * (p[c - cn] + p[c + cn]) + 6 * p[c];
+                    dst[x * cn + c] = static_cast<unsigned char>((sum + 128) >> 8);
+                }
+            }
+        }
+
+        /**
+         * @brief 上采样的垂直方向：偶数行 r[-1] + 6r[0] + r[1]，奇数行 4r[0] + 4r[1]
+         */
+        void pyrUpVertical(const unsigned char *rm1, const unsigned char *r0, const unsigned char *rp1,
+                           bool oddRow, unsigned short *dst, int count)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= count - 16; i += 16)
+            {
+                __m256i v0 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(r0 + i)));
+                __m256i vp = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rp1 + i)));
+                __m256i sum;
+                if (oddRow)
+                {
+                    sum = _mm256_slli_epi16(_mm256_add_epi16(v0, vp), 2);
+                }
+                else
+                {
+                    __m256i vm = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rm1 + i)));
+                    sum = _mm256_add_epi16(_mm256_add_epi16(vm, vp), _mm256_add_epi16(_mm256_slli_epi16(v0, 2), _mm256_slli_epi16(v0, 1)));
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), sum);
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 8; i += 8)
+            {
+                __m128i v0 = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(r0 + i)), zero);
+                __m128i vp = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rp1 + i)), zero);
+                __m128i sum;
+                if (oddRow)
+                {
+                    sum = _mm_slli_epi16(_mm_add_epi16(v0, vp), 2);
+                }
+                else
+                {
+                    __m128i vm = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rm1 + i)), zero);
+                    sum = _mm_add_epi16(_mm_add_epi16(vm, vp), _mm_add_epi16(_mm_slli_epi16(v0, 2), _mm_slli_epi16(v0, 1)));
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), sum);
+            }
+#endif
+#endif
+
+            for (; i < count; ++i)
+            {
+                dst[i] = static_cast<unsigned short>(oddRow ? 4 * (r0[i] + rp1[i]) : rm1[i] + 6 * r0[i] + rp1[i]);
+            }
+        }
+
+        /**
+         * @brief pyrUp的实现，源和目标以行起点与步长给出，目标可以是复用的缓冲区
+         */
+        void pyrUpRows(const unsigned char *srcData, size_t srcStep, int srcWidth, int srcHeight, int cn,
+                       unsigned char *dstData, size_t dstStep, int dstWidth, int dstHeight)
+        {
+            int count = srcWidth * cn;
+            int stripes = detail::stripeCount(dstHeight);
+            int pixelCount = dstWidth * dstHeight;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int s = 0; s < stripes; ++s)
+            {
+                int y0 = detail::stripeBegin(dstHeight, stripes, s);
+                int y1 = detail::stripeBegin(dstHeight, stripes, s + 1);
+
+                std::vector<unsigned short> buffer(static_cast<size_t>(srcWidth + 2 * PYR_BORDER) * cn + PYR_SLACK);
+                unsigned short *row = buffer.data() + PYR_BORDER * cn;
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    int sy = y / 2;
+                    const unsigned char *rm1 = srcData + std::clamp(sy - 1, 0, srcHeight - 1) * srcStep;
+                    const unsigned char *r0 = srcData + std::min(sy, srcHeight - 1) * srcStep;
+                    const unsigned char *rp1 = srcData + std::min(sy + 1, srcHeight - 1) * srcStep;
+                    pyrUpVertical(rm1, r0, rp1, (y & 1) != 0, row, count);
+                    replicateBorder(row, srcWidth, cn);
+
+                    // 水平方向：偶数列 v[-1] + 6v[0] + v[1]，奇数列 4v[0] + 4v[1]，总权重64
+                    unsigned char *dstRow = dstData + y * dstStep;
+                    for (int x = 0; x < dstWidth; ++x)
+                    {
+                        const unsigned short *p = row + (x / 2) * cn;
+                        unsigned char *d = dstRow + x * cn;
+                        if (x & 1)
+                        {
+                            for (int c = 0; c < cn; ++c)
+                            {
+                                d[c] = static_cast<unsigned char>((4 * (p[c] + p[c + cn]) + 32) >> 6);
+                            }
+                        }
+                        else
+                        {
+                            for (int c = 0; c < cn; ++c)
+                            {
+                                d[c] = static_cast<unsigned char>((p[c - cn] + 6 * p[c] + p[c + cn] + 32) >> 6);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 一行的多频段重建：dst = up + ((g1 - u1) × (256 - w) + (g2 - u2) × w + 128) >> 8，饱和到[0, 255]
+         * w = m + (m >> 7) 把掩码[0, 255]映射到[0, 256]，掩码为0或255时拉普拉斯值原样取自一张图像；dst可以与up相同
+         */
+        void blendLaplacianRow(const unsigned char *up, const unsigned char *g1, const unsigned char *u1,
+                               const unsigned char *g2, const unsigned char *u2, const unsigned char *m,
+                               unsigned char *dst, int count)
+        {
+            int i = 0;
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            // 差分交错成(d1, d2)对、权重交错成(256 - w, w)对，madd一次得到32位加权和
+            const __m256i full = _mm256_set1_epi16(256);
+            const __m256i half = _mm256_set1_epi32(128);
+            auto load16 = [](const unsigned char *p)
+            {
+                return _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)));
+            };
+            for (; i <= count - 16; i += 16)
+            {
+                __m256i vm = load16(m + i);
+                __m256i w = _mm256_add_epi16(vm, _mm256_srli_epi16(vm, 7));
+                __m256i iw = _mm256_sub_epi16(full, w);
+                __m256i d1 = _mm256_sub_epi16(load16(g1 + i), load16(u1 + i));
+                __m256i d2 = _mm256_sub_epi16(load16(g2 + i), load16(u2 + i));
+                __m256i lo = _mm256_madd_epi16(_mm256_unpacklo_epi16(d1, d2), _mm256_unpacklo_epi16(iw, w));
+                __m256i hi = _mm256_madd_epi16(_mm256_unpackhi_epi16(d1, d2), _mm256_unpackhi_epi16(iw, w));
+                lo = _mm256_srai_epi32(_mm256_add_epi32(lo, half), 8);
+                hi = _mm256_srai_epi32(_mm256_add_epi32(hi, half), 8);
+                __m256i r = _mm256_add_epi16(load16(up + i), _mm256_packs_epi32(lo, hi));
+                r = _mm256_permute4x64_epi64(_mm256_packus_epi16(r, r), 0x08);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(r));
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i full = _mm_set1_epi16(256);
+            const __m128i half = _mm_set1_epi32(128);
+            auto load8 = [zero](const unsigned char *p)
+            {
+                return _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), zero);
+            };
+            for (; i <= count - 8; i += 8)
+            {
+                __m128i vm = load8(m + i);
+                __m128i w = _mm_add_epi16(vm, _mm_srli_epi16(vm, 7));
+                __m128i iw = _mm_sub_epi16(full, w);
+                __m128i d1 = _mm_sub_epi16(load8(g1 + i), load8(u1 + i));
+                __m128i d2 = _mm_sub_epi16(load8(g2 + i), load8(u2 + i));
+                __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(d1, d2), _mm_unpacklo_epi16(iw, w));
+                __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(d1, d2), _mm_unpackhi_epi16(iw, w));
+                lo = _mm_srai_epi32(_mm_add_epi32(lo, half), 8);
+                hi = _mm_srai_epi32(_mm_add_epi32(hi, half), 8);
+                __m128i r = _mm_add_epi16(load8(up + i), _mm_packs_epi32(lo, hi));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(r, r));
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                int w = m[i] + (m[i] >> 7);
+                // 算术右移对负值向下取整，与SIMD路径一致
+                int lap = ((g1[i] - u1[i]) * (256 - w) + (g2[i] - u2[i]) * w + 128) >> 8;
+                dst[i] = static_cast<unsigned char>(std::clamp(up[i] + lap, 0, 255));
+            }
+        }
+
+        /**
+         * @brief 重建一层：dst = dst + 按掩码混合的两张拉普拉斯层（g - u），原地写入，按行条带并行
+         * dst中已是上一层结果的上采样；u1、u2为nullptr表示最顶层，此时上采样值都按0处理（不读取dst），
+         * 即两张高斯层直接按掩码混合。u1、u2按uStep连续存储
+         */
+        void collapseLevel(const unsigned char *u1, const unsigned char *u2, size_t uStep,
+                           const OptimalImage &g1, const OptimalImage &g2, const OptimalImage &mask,
+                           unsigned char *dst, size_t dstStep)
+        {
+            int width = g1.width();
+            int height = g1.height();
+            int cn = g1.channels();
+            int count = width * cn;
+            int pixelCount = width * height;
+            int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+            bool top = u1 == nullptr;
+            std::vector<unsigned char> zeros(top ? count : 0, 0);
+
+#pragma omp parallel for if (stripes > 1)
+            for (int s = 0; s < stripes; ++s)
+            {
+                // 多通道时把掩码复制到每个通道，之后按字节流处理
+                std::vector<unsigned char> weights(cn > 1 ? count : 0);
+                std::vector<const unsigned char *> planes(cn);
+
+                int yEnd = detail::stripeBegin(height, stripes, s + 1);
+                for (int y = detail::stripeBegin(height, stripes, s); y < yEnd; ++y)
+                {
+                    const unsigned char *m = mask.data() + y * mask.step();
+                    if (cn > 1)
+                    {
+                        std::fill(planes.begin(), planes.end(), m);
+                        detail::mergeRow(planes.data(), weights.data(), width, cn);
+                        m = weights.data();
+                    }
+                    unsigned char *dstRow = dst + y * dstStep;
+                    const unsigned char *upRow = top ? zeros.data() : dstRow;
+                    const unsigned char *u1Row = top ? zeros.data() : u1 + y * uStep;
+                    const unsigned char *u2Row = top ? zeros.data() : u2 + y * uStep;
+                    blendLaplacianRow(upRow, g1.data() + y * g1.step(), u1Row, g2.data() + y * g2.step(), u2Row,
+                                      m, dstRow, count);
+                }
+            }
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::pyrDown() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply pyrDown to an empty image");
+        }
+
+        int dstWidth = (width_ + 1) / 2;
+        int dstHeight = (height_ + 1) / 2;
+        OptimalImage result(dstWidth, dstHeight, channels_);
+
+        const unsigned char *srcData = data();
+        unsigned char *dstData = result.data();
+        size_t dstStep = result.step();
+        int count = width_ * channels_;
+        int stripes = detail::stripeCount(dstHeight);
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int s = 0; s < stripes; ++s)
+        {
+            int y0 = detail::stripeBegin(dstHeight, stripes, s);
+            int y1 = detail::stripeBegin(dstHeight, stripes, s + 1);
+
+            std::vector<unsigned short> buffer(static_cast<size_t>(width_ + 2 * PYR_BORDER) * channels_ + PYR_SLACK);
+            unsigned short *row = buffer.data() + PYR_BORDER * channels_;
+            const unsigned char *rows[5];
+
+            for (int y = y0; y < y1; ++y)
+            {
+                // 只对保留下来的输出行做垂直滤波
+                for (int k = 0; k < 5; ++k)
+                {
+                    int sy = std::clamp(2 * y + k - 2, 0, height_ - 1);
+                    rows[k] = srcData + sy * step_;
+                }
+                pyrDownVertical(rows, row, count);
+                replicateBorder(row, width_, channels_);
+                pyrDownHorizontal(row, dstData + y * dstStep, dstWidth, channels_);
+            }
+        }
+
+        return result;
+    }
+
+    OptimalImage OptimalImage::pyrUp(int dstWidth, int dstHeight) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply pyrUp to an empty image");
+        }
+
+        if (dstWidth == 0)
+        {
+            dstWidth = width_ * 2;
+        }
+        if (dstHeight == 0)
+        {
+            dstHeight = height_ * 2;
+        }
+
+        if (std::abs(dstWidth - width_ * 2) > 1 || std::abs(dstHeight - height_ * 2) > 1 || dstWidth <= 0 || dstHeight <= 0)
+        {
+            std::stringstream ss;
+            ss << "pyrUp target size must be within 1 pixel of " << width_ * 2 << "x" << height_ * 2
+               << ", but got " << dstWidth << "x" << dstHeight;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        OptimalImage result(dstWidth, dstHeight, channels_);
+        pyrUpRows(data(), step_, width_, height_, channels_, result.data(), result.step(), dstWidth, dstHeight);
+
+        return result;
+    }
+
+    std::vector<OptimalImage> OptimalImage::buildPyramid(int levels) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot build a pyramid from an empty image");
+        }
+
+        if (levels < 0)
+        {
+            std::stringstream ss;
+            ss << "Pyramid levels must be non-negative, but got " << levels;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        // 逐层构建：每层只读取刚写完的上一层，较小的层完全驻留在缓存中
+        std::vector<OptimalImage> pyramid;
+        pyramid.reserve(static_cast<size_t>(levels) + 1);
+        pyramid.push_back(*this);
+        for (int i = 1; i <= levels; ++i)
+        {
+            pyramid.push_back(pyramid.back().pyrDown());
+        }
+        return pyramid;
+    }
+
+    OptimalImage OptimalImage::blendMultiBand(const OptimalImage &img1, const OptimalImage &img2, const OptimalImage &mask, int levels)
+    {
+        if (img1.empty() || img2.empty())
+        {
+            throw InvalidArgumentException("Cannot blend empty images");
+        }
+
+        if (img1.width() != img2.width() || img1.height() != img2.height() || img1.channels() != img2.channels())
+        {
+            std::stringstream ss;
+            ss << "Images must match for multi-band blending. "
+               << "First image: " << img1.width() << "x" << img1.height() << "x" << img1.channels()
+               << ", Second image: " << img2.width() << "x" << img2.height() << "x" << img2.channels();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (mask.empty() || mask.channels() != 1 || mask.width() != img1.width() || mask.height() != img1.height())
+        {
+            std::stringstream ss;
+            ss << "Mask must be a single-channel " << img1.width() << "x" << img1.height() << " image, but got "
+               << mask.width() << "x" << mask.height() << "x" << mask.channels();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (levels < 0)
+        {
+            std::stringstream ss;
+            ss << "Pyramid levels must be non-negative, but got " << levels;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        std::vector<OptimalImage> g1 = img1.buildPyramid(levels);
+        std::vector<OptimalImage> g2 = img2.buildPyramid(levels);
+        std::vector<OptimalImage> gm = mask.buildPyramid(levels);
+
+        int cn = img1.channels();
+
+        // 所有缓冲区只分配一次：各层上采样的高斯层按层依次打包在一块缓冲区中（总大小不到最细层的4/3），
+        // 重建结果在两块第1层大小的缓冲区间交替，第0层直接写入结果图像
+        std::vector<size_t> offset(static_cast<size_t>(levels) + 1, 0);
+        for (int i = 0; i < levels; ++i)
+        {
+            offset[i + 1] = offset[i] + static_cast<size_t>(g1[i].width()) * cn * g1[i].height();
+        }
+        std::vector<unsigned char> up1(offset[levels]);
+        std::vector<unsigned char> up2(offset[levels]);
+        size_t reconSize = levels > 0 ? static_cast<size_t>(g1[1].width()) * cn * g1[1].height() : 0;
+        std::vector<unsigned char> recon[2] = {std::vector<unsigned char>(reconSize), std::vector<unsigned char>(reconSize)};
+        OptimalImage result(img1.width(), img1.height(), cn);
+
+        auto levelStep = [&](int i)
+        {
+            return i == 0 ? result.step() : static_cast<size_t>(g1[i].width()) * cn;
+        };
+        auto levelData = [&](int i)
+        {
+            return i == 0 ? result.data() : recon[i & 1].data();
+        };
+
+        // 拉普拉斯层 = 高斯层 - 上一层的上采样。各层的上采样互不依赖：大层依次计算，由pyrUp在层内按行并行；
+        // 小层在层内不会启用并行，把所有小层（两张图像）的上采样作为独立任务在层间并行
+        auto upsampleGaussian = [&](int t)
+        {
+            int i = t / 2;
+            const std::vector<OptimalImage> &g = (t & 1) ? g2 : g1;
+            unsigned char *dst = ((t & 1) ? up2 : up1).data() + offset[i];
+            pyrUpRows(g[i + 1].data(), g[i + 1].step(), g[i + 1].width(), g[i + 1].height(), cn,
+                      dst, static_cast<size_t>(g[i].width()) * cn, g[i].width(), g[i].height());
+        };
+        int firstSmall = levels;
+        while (firstSmall > 0 && g1[firstSmall - 1].width() * g1[firstSmall - 1].height() <= OPTIMIZATION_THRESHOLD)
+        {
+            --firstSmall;
+        }
+        for (int t = 0; t < 2 * firstSmall; ++t)
+        {
+            upsampleGaussian(t);
+        }
+
+#pragma omp parallel for schedule(dynamic) if (levels - firstSmall > 1)
+        for (int t = 2 * firstSmall; t < 2 * levels; ++t)
+        {
+            upsampleGaussian(t);
+        }
+
+        // 从最顶层开始重建：每层把上一层的结果上采样到本层缓冲区，再原地加上本层混合后的拉普拉斯值
+        collapseLevel(nullptr, nullptr, 0, g1[levels], g2[levels], gm[levels], levelData(levels), levelStep(levels));
+        for (int i = levels - 1; i >= 0; --i)
+        {
+            pyrUpRows(levelData(i + 1), levelStep(i + 1), g1[i + 1].width(), g1[i + 1].height(), cn,
+                      levelData(i), levelStep(i), g1[i].width(), g1[i].height());
+            collapseLevel(up1.data() + offset[i], up2.data() + offset[i], static_cast<size_t>(g1[i].width()) * cn,
+                          g1[i], g2[i], gm[i], levelData(i), levelStep(i));
+        }
+        return result;
+    }
+
+} // namespace mylib
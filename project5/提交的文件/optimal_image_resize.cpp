@@ -0,0 +1,520 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 定点系数的小数位数，每个输出位置的系数之和恰好为 1 << RESIZE_COEF_BITS
+        constexpr int RESIZE_COEF_BITS = 11;
+        constexpr int RESIZE_COEF_SCALE = 1 << RESIZE_COEF_BITS;
+
+        // 双三次插值的参数A（与OpenCV保持一致）
+        constexpr double BICUBIC_A = -0.75;
+
+        /**
+         * @brief 一维缩放表：每个输出位置有ksize个抽头（源索引 + 定点系数）
+         * 布局为 offsets[i * ksize + k]，边界处的源索引已经被钳制到合法范围
+         */
+        struct AxisTable
+        {
+            int ksize = 0;
+            std::vector<int> offsets;
+            std::vector<int> coeffs;
+        };
+
+        /**
+         * @brief 将浮点权重转换为定点系数，并把舍入误差补到最大的系数上，保证系数和精确为 RESIZE_COEF_SCALE
+         */
+        void quantizeWeights(const double *weights, int *coeffs, int ksize)
+        {
+            int sum = 0;
+            int maxIdx = 0;
+            for (int k = 0; k < ksize; ++k)
+            {
+                coeffs[k] = static_cast<int>(std::lround(weights[k] * RESIZE_COEF_SCALE));
+                sum += coeffs[k];
+                if (weights[k] > weights[maxIdx])
+                {
+                    maxIdx = k;
+                }
+            }
+            coeffs[maxIdx] += RESIZE_COEF_SCALE - sum;
+        }
+
+        double cubicWeight(double x)
+        {
+            x = std::fabs(x);
+            if (x <= 1.0)
+            {
+                return ((BICUBIC_A + 2.0) * x - (BICUBIC_A + 3.0)) * x * x + 1.0;
+            }
+            if (x < 2.0)
+            {
+                return ((BICUBIC_A * x - 5.0 * BICUBIC_A) * x + 8.0 * BICUBIC_A) * x - 4.0 * BICUBIC_A;
+            }
+            return 0.0;
+        }
+
+        /**
+         * @brief 构建一个方向上的缩放表（采用像素中心对齐的坐标映射）
+         */
+        void buildAxisTable(int srcSize, int dstSize, Interpolation interpolation, AxisTable &table)
+        {
+            double scale = static_cast<double>(srcSize) / dstSize;
+
+            // 区域插值只在缩小时有意义，放大时退化为双线性插值
+            if (interpolation == Interpolation::Area && scale <= 1.0)
+            {
+                interpolation = Interpolation::Bilinear;
+            }
+
+            switch (interpolation)
+            {
+            case Interpolation::Bicubic:
+                table.ksize = 4;
+                break;
+            case Interpolation::Area:
+                table.ksize = static_cast<int>(std::ceil(scale)) + 1;
+                break;
+            default:
+                table.ksize = 2;
+                break;
+            }
+
+            int ksize = table.ksize;
+            table.offsets.assign(static_cast<size_t>(dstSize) * ksize, 0);
+            table.coeffs.assign(static_cast<size_t>(dstSize) * ksize, 0);
+            std::vector<double> weights(ksize);
+
+            for (int i = 0; i < dstSize; ++i)
+            {
+                int *offsets = table.offsets.data() + static_cast<size_t>(i) * ksize;
+                int *coeffs = table.coeffs.data() + static_cast<size_t>(i) * ksize;
+                int start = 0;
+
+                if (interpolation == Interpolation::Area)
+                {
+                    double fsx1 = i * scale;
+                    double fsx2 = fsx1 + scale;
+                    start = static_cast<int>(std::floor(fsx1));
+                    for (int k = 0; k < ksize; ++k)
+                    {
+                        double p = start + k;
+                        double overlap = std::min(p + 1.0, fsx2) - std::max(p, fsx1);
+                        weights[k] = std::max(0.0, overlap) / scale;
+                    }
+                }
+                else
+                {
+                    double fx = (i + 0.5) * scale - 0.5;
+                    int sx = static_cast<int>(std::floor(fx));
+                    double t = fx - sx;
+                    if (interpolation == Interpolation::Bicubic)
+                    {
+                        start = sx - 1;
+                        for (int k = 0; k < ksize; ++k)
+                        {
+                            weights[k] = cubicWeight(t - (k - 1));
+                        }
+                    }
+                    else
+                    {
+                        start = sx;
+                        weights[0] = 1.0 - t;
+                        weights[1] = t;
+                    }
+                }
+
+                for (int k = 0; k < ksize; ++k)
+                {
+                    offsets[k] = std::clamp(start + k, 0, srcSize - 1);
+                }
+                quantizeWeights(weights.data(), coeffs, ksize);
+            }
+        }
+
+        /**
+         * @brief 水平方向缩放一行：dst[j] = sum_k src[xofs[k][j]] * xcoef[k][j]
+         * @param canGather 该行之后是否还有至少4字节可读（AVX2 gather每次读取4字节）
+         */
+        void resizeRowHorizontal(const unsigned char *src, int *dst, const int *xofs, const int *xcoef,
+                                 int ksize, int count, bool canGather)
+        {
+            int j = 0;
+#if defined(USE_SIMD) && defined(__AVX2__)
+            if (canGather)
+            {
+                const __m256i byteMask = _mm256_set1_epi32(0xFF);
+                for (; j <= count - 8; j += 8)
+                {
+                    __m256i acc = _mm256_setzero_si256();
+                    for (int k = 0; k < ksize; ++k)
+                    {
+                        __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xofs + static_cast<size_t>(k) * count + j));
+                        __m256i coef = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xcoef + static_cast<size_t>(k) * count + j));
+                        __m256i pix = _mm256_and_si256(_mm256_i32gather_epi32(reinterpret_cast<const int *>(src), idx, 1), byteMask);
+                        acc = _mm256_add_epi32(acc, _mm256_mullo_epi32(pix, coef));
+                    }
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + j), acc);
+                }
+            }
+#else
+            (void)canGather;
+#endif
+            for (; j < count; ++j)
+            {
+                int sum = 0;
+                for (int k = 0; k < ksize; ++k)
+                {
+                    size_t idx = static_cast<size_t>(k) * count + j;
+                    sum += src[xofs[idx]] * xcoef[idx];
+                }
+                dst[j] = sum;
+            }
+        }
+
+        /**
+         * @brief 垂直方向合并ksize个水平缩放结果行，并舍入回8位
+         */
+        void resizeRowVertical(const int *const *rows, const int *ycoef, int ksize, unsigned char *dst, int count)
+        {
+            constexpr int shift = 2 * RESIZE_COEF_BITS;
+            constexpr int delta = 1 << (shift - 1);
+            int j = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i deltaVec = _mm256_set1_epi32(delta);
+            for (; j <= count - 16; j += 16)
+            {
+                __m256i acc0 = deltaVec;
+                __m256i acc1 = deltaVec;
+                for (int k = 0; k < ksize; ++k)
+                {
+                    __m256i coef = _mm256_set1_epi32(ycoef[k]);
+                    acc0 = _mm256_add_epi32(acc0, _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[k] + j)), coef));
+                    acc1 = _mm256_add_epi32(acc1, _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(rows[k] + j + 8)), coef));
+                }
+                acc0 = _mm256_srai_epi32(acc0, shift);
+                acc1 = _mm256_srai_epi32(acc1, shift);
+
+                // 32位->16位->8位，饱和截断到[0, 255]，并修正AVX2按128位通道打包造成的乱序
+                __m256i packed16 = _mm256_permute4x64_epi64(_mm256_packs_epi32(acc0, acc1), 0xD8);
+                __m256i packed8 = _mm256_permute4x64_epi64(_mm256_packus_epi16(packed16, packed16), 0xD8);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + j), _mm256_castsi256_si128(packed8));
+            }
+#elif defined(__SSE4_1__)
+            const __m128i deltaVec = _mm_set1_epi32(delta);
+            for (; j <= count - 8; j += 8)
+            {
+                __m128i acc0 = deltaVec;
+                __m128i acc1 = deltaVec;
+                for (int k = 0; k < ksize; ++k)
+                {
+                    __m128i coef = _mm_set1_epi32(ycoef[k]);
+                    acc0 = _mm_add_epi32(acc0, _mm_mullo_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + j)), coef));
+                    acc1 = _mm_add_epi32(acc1, _mm_mullo_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[k] + j + 4)), coef));
+                }
+                acc0 = _mm_srai_epi32(acc0, shift);
+                acc1 = _mm_srai_epi32(acc1, shift);
+                __m128i packed16 = _mm_packs_epi32(acc0, acc1);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + j), _mm_packus_epi16(packed16, packed16));
+            }
+#endif
+#endif
+
+            for (; j < count; ++j)
+            {
+                int sum = delta;
+                for (int k = 0; k < ksize; ++k)
+                {
+                    sum += rows[k][j] * ycoef[k];
+                }
+                dst[j] = static_cast<unsigned char>(std::clamp(sum >> shift, 0, 255));
+            }
+        }
+
+        /**
+         * @brief 最近邻缩放：预计算每列的源字节偏移，逐行拷贝
+         */
+        void resizeNearest(const OptimalImage &src, OptimalImage &dst)
+        {
+            int srcW = src.width();
+            int srcH = src.height();
+            int dstW = dst.width();
+            int dstH = dst.height();
+            int cn = src.channels();
+            size_t srcStep = src.step();
+            size_t dstStep = dst.step();
+            const unsigned char *srcData = src.data();
+            unsigned char *dstData = dst.data();
+
+            double scaleX = static_cast<double>(srcW) / dstW;
+            double scaleY = static_cast<double>(srcH) / dstH;
+
+            std::vector<int> xofs(dstW);
+            for (int x = 0; x < dstW; ++x)
+            {
+                xofs[x] = std::min(static_cast<int>(std::floor((x + 0.5) * scaleX)), srcW - 1) * cn;
+            }
+
+            int pixelCount = dstW * dstH;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < dstH; ++y)
+            {
+                int sy = std::min(static_cast<int>(std::floor((y + 0.5) * scaleY)), srcH - 1);
+                const unsigned char *srcRow = srcData + sy * srcStep;
+                unsigned char *dstRow = dstData + y * dstStep;
+
+                switch (cn)
+                {
+                case 1:
+                    for (int x = 0; x < dstW; ++x)
+                    {
+                        dstRow[x] = srcRow[xofs[x]];
+                    }
+                    break;
+                case 3:
+                    for (int x = 0; x < dstW; ++x)
+                    {
+                        const unsigned char *s = srcRow + xofs[x];
+                        dstRow[x * 3] = s[0];
+                        dstRow[x * 3 + 1] = s[1];
+                        dstRow[x * 3 + 2] = s[2];
+                    }
+                    break;
+                default:
+                    for (int x = 0; x < dstW; ++x)
+                    {
+                        std::memcpy(dstRow + static_cast<size_t>(x) * cn, srcRow + xofs[x], cn);
+                    }
+                    break;
+                }
+            }
+        }
+
+        /**
+         * @brief 整数倍缩小的快速路径：先按列累加fy行，再每fx个像素求平均（四舍五入）
+         */
+        void resizeAreaInteger(const OptimalImage &src, OptimalImage &dst, int fx, int fy)
+        {
+            int dstW = dst.width();
+            int dstH = dst.height();
+            int cn = src.channels();
+            size_t srcStep = src.step();
+            size_t dstStep = dst.step();
+            const unsigned char *srcData = src.data();
+            unsigned char *dstData = dst.data();
+
+            int rowLen = src.width() * cn;
+            unsigned int area = static_cast<unsigned int>(fx) * fy;
+            unsigned int half = area / 2;
+            int stripes = detail::stripeCount(dstH);
+            int pixelCount = dstW * dstH;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int s = 0; s < stripes; ++s)
+            {
+                int y0 = detail::stripeBegin(dstH, stripes, s);
+                int y1 = detail::stripeBegin(dstH, stripes, s + 1);
+                std::vector<unsigned int> colSum(rowLen);
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    std::fill(colSum.begin(), colSum.end(), 0u);
+                    for (int r = 0; r < fy; ++r)
+                    {
+                        const unsigned char *srcRow = srcData + (static_cast<size_t>(y) * fy + r) * srcStep;
+                        unsigned int *sum = colSum.data();
+                        int i = 0;
+#if defined(USE_SIMD) && defined(__AVX2__)
+                        for (; i <= rowLen - 8; i += 8)
+                        {
+                            __m256i pix = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(srcRow + i)));
+                            __m256i acc = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sum + i));
+                            _mm256_storeu_si256(reinterpret_cast<__m256i *>(sum + i), _mm256_add_epi32(acc, pix));
+                        }
+#elif defined(USE_SIMD) && defined(__SSE4_1__)
+                        for (; i <= rowLen - 4; i += 4)
+                        {
+                            int packed;
+                            std::memcpy(&packed, srcRow + i, sizeof(packed));
+                            __m128i pix = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(packed));
+                            __m128i acc = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sum + i));
+                            _mm_storeu_si128(reinterpret_cast<__m128i *>(sum + i), _mm_add_epi32(acc, pix));
+                        }
+#endif
+                        for (; i < rowLen; ++i)
+                        {
+                            sum[i] += srcRow[i];
+                        }
+                    }
+
+                    unsigned char *dstRow = dstData + y * dstStep;
+                    for (int x = 0; x < dstW; ++x)
+                    {
+                        const unsigned int *block = colSum.data() + static_cast<size_t>(x) * fx * cn;
+                        for (int c = 0; c < cn; ++c)
+                        {
+                            unsigned int total = 0;
+                            for (int i = 0; i < fx; ++i)
+                            {
+                                total += block[i * cn + c];
+                            }
+                            dstRow[x * cn + c] = static_cast<unsigned char>((total + half) / area);
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 通用可分离缩放：水平方向按列表插值，垂直方向按行表合并
+         * 每个条带维护一个环形行缓存，每个源行在一个条带内只做一次水平插值
+         */
+        void resizeSeparable(const OptimalImage &src, OptimalImage &dst, Interpolation interpolation)
+        {
+            int cn = src.channels();
+            int dstW = dst.width();
+            int dstH = dst.height();
+            size_t srcStep = src.step();
+            size_t dstStep = dst.step();
+            size_t srcTotal = src.size();
+            const unsigned char *srcData = src.data();
+            unsigned char *dstData = dst.data();
+
+            AxisTable xtab;
+            AxisTable ytab;
+            buildAxisTable(src.width(), dstW, interpolation, xtab);
+            buildAxisTable(src.height(), dstH, interpolation, ytab);
+
+            // 将水平表展开到每个输出字节（含通道），并转置成按抽头连续存储，便于SIMD加载
+            int count = dstW * cn;
+            int ksx = xtab.ksize;
+            std::vector<int> xofs(static_cast<size_t>(ksx) * count);
+            std::vector<int> xcoef(static_cast<size_t>(ksx) * count);
+            int maxOffset = 0;
+            for (int x = 0; x < dstW; ++x)
+            {
+                for (int k = 0; k < ksx; ++k)
+                {
+                    int sx = xtab.offsets[static_cast<size_t>(x) * ksx + k];
+                    int coef = xtab.coeffs[static_cast<size_t>(x) * ksx + k];
+                    for (int c = 0; c < cn; ++c)
+                    {
+                        size_t idx = static_cast<size_t>(k) * count + x * cn + c;
+                        xofs[idx] = sx * cn + c;
+                        xcoef[idx] = coef;
+                        maxOffset = std::max(maxOffset, xofs[idx]);
+                    }
+                }
+            }
+
+            int ksy = ytab.ksize;
+            int stripes = detail::stripeCount(dstH);
+            int pixelCount = dstW * dstH;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int s = 0; s < stripes; ++s)
+            {
+                int y0 = detail::stripeBegin(dstH, stripes, s);
+                int y1 = detail::stripeBegin(dstH, stripes, s + 1);
+
+                // 环形缓存：源行sy存放在槽 sy % ksy 中（同一输出行的抽头是ksy个连续源行，不会冲突）
+                std::vector<int> ring(static_cast<size_t>(ksy) * count);
+                std::vector<int> ringRow(ksy, -1);
+                std::vector<const int *> rows(ksy);
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    const int *yofs = ytab.offsets.data() + static_cast<size_t>(y) * ksy;
+                    for (int k = 0; k < ksy; ++k)
+                    {
+                        int sy = yofs[k];
+                        int slot = sy % ksy;
+                        int *buffer = ring.data() + static_cast<size_t>(slot) * count;
+                        if (ringRow[slot] != sy)
+                        {
+                            size_t rowOffset = static_cast<size_t>(sy) * srcStep;
+                            bool canGather = rowOffset + maxOffset + 4 <= srcTotal;
+                            resizeRowHorizontal(srcData + rowOffset, buffer, xofs.data(), xcoef.data(), ksx, count, canGather);
+                            ringRow[slot] = sy;
+                        }
+                        rows[k] = buffer;
+                    }
+
+                    resizeRowVertical(rows.data(), ytab.coeffs.data() + static_cast<size_t>(y) * ksy, ksy,
+                                      dstData + y * dstStep, count);
+                }
+            }
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::resize(int newWidth, int newHeight, Interpolation interpolation) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot resize an empty image");
+        }
+
+        if (newWidth <= 0 || newHeight <= 0)
+        {
+            std::stringstream ss;
+            ss << "Target size must be positive, but got " << newWidth << "x" << newHeight;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (newWidth == width_ && newHeight == height_)
+        {
+            return clone();
+        }
+
+        OptimalImage result(newWidth, newHeight, channels_);
+
+        if (interpolation == Interpolation::Nearest)
+        {
+            resizeNearest(*this, result);
+            return result;
+        }
+
+        // 整数倍缩小的快速路径：区域插值直接做块平均；
+        // 双线性插值在1倍或2倍缩小时采样点恰好落在像素之间，结果与块平均完全一致
+        bool integerX = width_ % newWidth == 0;
+        bool integerY = height_ % newHeight == 0;
+        int fx = width_ / newWidth;
+        int fy = height_ / newHeight;
+        if (integerX && integerY)
+        {
+            if (interpolation == Interpolation::Area ||
+                (interpolation == Interpolation::Bilinear && fx <= 2 && fy <= 2))
+            {
+                resizeAreaInteger(*this, result, fx, fy);
+                return result;
+            }
+        }
+
+        resizeSeparable(*this, result, interpolation);
+        return result;
+    }
+
+} // namespace mylib
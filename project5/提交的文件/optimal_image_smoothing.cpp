@@ -0,0 +1,563 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 参与双边滤波颜色距离的最大通道数（四通道图像的alpha不参与）
+        constexpr int BILATERAL_COLOR_CHANNELS = 3;
+
+        // 引导滤波的最大半径，保证(2 × radius + 1) × 255²的32位列和不溢出
+        constexpr int GUIDED_MAX_RADIUS = 16383;
+
+        /**
+         * @brief 一行的一维（垂直）双边滤波：out = Σ w × n / Σ w，w = space[k] × color[|n - c|]
+         * 多通道时颜色距离为前三个通道绝对差之和；AVX2下单通道、三通道、四通道每次处理8个像素，
+         * 三通道像素先用pshufb扩展为4字节，颜色权重用gather查表
+         * @param rows 窗口覆盖的2 × radius + 1个源行（边界行已复制），中心行为rows[radius]
+         * @param out 输出的浮点行，长度为width × cn
+         */
+        void bilateralRow(const unsigned char *const *rows, int radius, const float *space, const float *color,
+                          int width, int cn, float *out)
+        {
+            const int ksize = 2 * radius + 1;
+            const int colorCn = std::min(cn, BILATERAL_COLOR_CHANNELS);
+            const unsigned char *center = rows[radius];
+            int x = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            if (cn == 1)
+            {
+                for (; x <= width - 8; x += 8)
+                {
+                    __m256i c = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(center + x)));
+                    __m256 acc = _mm256_setzero_ps();
+                    __m256 wsum = _mm256_setzero_ps();
+                    for (int k = 0; k < ksize; ++k)
+                    {
+                        __m256i n = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[k] + x)));
+                        __m256i d = _mm256_abs_epi32(_mm256_sub_epi32(n, c));
+                        __m256 w = _mm256_mul_ps(_mm256_set1_ps(space[k]), _mm256_i32gather_ps(color, d, 4));
+                        acc = _mm256_add_ps(acc, _mm256_mul_ps(w, _mm256_cvtepi32_ps(n)));
+                        wsum = _mm256_add_ps(wsum, w);
+                    }
+                    _mm256_storeu_ps(out + x, _mm256_div_ps(acc, wsum));
+                }
+            }
+            else if (cn == 3 || cn == 4)
+            {
+                // 三通道：前4个像素取自偏移0处的16字节，后4个像素取自偏移8处的16字节，都不超出8个像素的24字节
+                const __m128i expandLo = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+                const __m128i expandHi = _mm_setr_epi8(4, 5, 6, -1, 7, 8, 9, -1, 10, 11, 12, -1, 13, 14, 15, -1);
+                const __m256i colorMask = _mm256_set1_epi32(0x00FFFFFF);
+                const __m256i ones8 = _mm256_set1_epi8(1);
+                const __m256i ones16 = _mm256_set1_epi16(1);
+                const __m256i spread[4] = {
+                    _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1), _mm256_setr_epi32(2, 2, 2, 2, 3, 3, 3, 3),
+                    _mm256_setr_epi32(4, 4, 4, 4, 5, 5, 5, 5), _mm256_setr_epi32(6, 6, 6, 6, 7, 7, 7, 7)};
+                auto loadPixels = [&](const unsigned char *p) -> __m256i
+                {
+                    if (cn == 4)
+                    {
+                        return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+                    }
+                    __m128i lo = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p)), expandLo);
+                    __m128i hi = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 8)), expandHi);
+                    return _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+                };
+
+                alignas(32) float lanes[32];
+                for (; x <= width - 8; x += 8)
+                {
+                    __m256i c = _mm256_and_si256(loadPixels(center + x * cn), colorMask);
+                    __m256 acc[4] = {_mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps()};
+                    __m256 wsum = _mm256_setzero_ps();
+                    for (int k = 0; k < ksize; ++k)
+                    {
+                        __m256i n = loadPixels(rows[k] + x * cn);
+                        __m256i nc = _mm256_and_si256(n, colorMask);
+                        __m256i d = _mm256_or_si256(_mm256_subs_epu8(nc, c), _mm256_subs_epu8(c, nc));
+                        d = _mm256_madd_epi16(_mm256_maddubs_epi16(d, ones8), ones16);
+                        __m256 w = _mm256_mul_ps(_mm256_set1_ps(space[k]), _mm256_i32gather_ps(color, d, 4));
+                        wsum = _mm256_add_ps(wsum, w);
+
+                        __m128i nLo = _mm256_castsi256_si128(n);
+                        __m128i nHi = _mm256_extracti128_si256(n, 1);
+                        __m256 v[4] = {_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(nLo)),
+                                       _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(nLo, 8))),
+                                       _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(nHi)),
+                                       _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_srli_si128(nHi, 8)))};
+                        for (int j = 0; j < 4; ++j)
+                        {
+                            __m256 wj = _mm256_permutevar8x32_ps(w, spread[j]);
+                            acc[j] = _mm256_add_ps(acc[j], _mm256_mul_ps(wj, v[j]));
+                        }
+                    }
+
+                    for (int j = 0; j < 4; ++j)
+                    {
+                        __m256 r = _mm256_div_ps(acc[j], _mm256_permutevar8x32_ps(wsum, spread[j]));
+                        if (cn == 4)
+                        {
+                            _mm256_storeu_ps(out + x * 4 + j * 8, r);
+                        }
+                        else
+                        {
+                            _mm256_store_ps(lanes + j * 8, r);
+                        }
+                    }
+                    if (cn == 3)
+                    {
+                        for (int p = 0; p < 8; ++p)
+                        {
+                            out[(x + p) * 3] = lanes[p * 4];
+                            out[(x + p) * 3 + 1] = lanes[p * 4 + 1];
+                            out[(x + p) * 3 + 2] = lanes[p * 4 + 2];
+                        }
+                    }
+                }
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                const unsigned char *c = center + x * cn;
+                float *o = out + x * cn;
+                float wsum = 0.0f;
+                for (int ch = 0; ch < cn; ++ch)
+                {
+                    o[ch] = 0.0f;
+                }
+                for (int k = 0; k < ksize; ++k)
+                {
+                    const unsigned char *n = rows[k] + x * cn;
+                    int d = 0;
+                    for (int ch = 0; ch < colorCn; ++ch)
+                    {
+                        d += std::abs(n[ch] - c[ch]);
+                    }
+                    float w = space[k] * color[d];
+                    wsum += w;
+                    for (int ch = 0; ch < cn; ++ch)
+                    {
+                        o[ch] += w * static_cast<float>(n[ch]);
+                    }
+                }
+                for (int ch = 0; ch < cn; ++ch)
+                {
+                    o[ch] /= wsum;
+                }
+            }
+        }
+
+        /**
+         * @brief 整幅图像的垂直一维双边滤波，按行条带并行
+         */
+        void bilateralVertical(const OptimalImage &src, OptimalImage &dst, int radius, const float *space, const float *color)
+        {
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            int count = width * cn;
+            int pixelCount = width * height;
+            unsigned char *dstData = dst.data();
+            size_t dstStep = dst.step();
+
+            int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+#pragma omp parallel for if (stripes > 1)
+            for (int s = 0; s < stripes; ++s)
+            {
+                std::vector<float> acc(count);
+                std::vector<const unsigned char *> rows(2 * radius + 1);
+                int yEnd = detail::stripeBegin(height, stripes, s + 1);
+                for (int y = detail::stripeBegin(height, stripes, s); y < yEnd; ++y)
+                {
+                    for (int k = 0; k <= 2 * radius; ++k)
+                    {
+                        int sy = std::clamp(y - radius + k, 0, height - 1);
+                        rows[k] = src.data() + sy * src.step();
+                    }
+                    bilateralRow(rows.data(), radius, space, color, width, cn, acc.data());
+                    detail::storeRow(acc.data(), dstData + y * dstStep, count);
+                }
+            }
+        }
+
+        /**
+         * @brief 引导滤波第一阶段的列和：I、p、I × p、I × I，Add为false时减去一行
+         * 8位乘积不超过65025，16位乘法的低位即为精确结果，再零扩展为32位累加
+         */
+        template <bool Add>
+        void updateGuidedColumns(const unsigned char *guide, const unsigned char *src, int count,
+                                 int32_t *colI, int32_t *colP, int32_t *colIp, int32_t *colII)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= count - 16; i += 16)
+            {
+                __m256i iv = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(guide + i)));
+                __m256i pv = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+                __m256i quantities[4] = {iv, pv, _mm256_mullo_epi16(iv, pv), _mm256_mullo_epi16(iv, iv)};
+                int32_t *cols[4] = {colI, colP, colIp, colII};
+                for (int q = 0; q < 4; ++q)
+                {
+                    __m256i lo = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(quantities[q]));
+                    __m256i hi = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(quantities[q], 1));
+                    __m256i *c0 = reinterpret_cast<__m256i *>(cols[q] + i);
+                    __m256i *c1 = reinterpret_cast<__m256i *>(cols[q] + i + 8);
+                    if (Add)
+                    {
+                        _mm256_storeu_si256(c0, _mm256_add_epi32(_mm256_loadu_si256(c0), lo));
+                        _mm256_storeu_si256(c1, _mm256_add_epi32(_mm256_loadu_si256(c1), hi));
+                    }
+                    else
+                    {
+                        _mm256_storeu_si256(c0, _mm256_sub_epi32(_mm256_loadu_si256(c0), lo));
+                        _mm256_storeu_si256(c1, _mm256_sub_epi32(_mm256_loadu_si256(c1), hi));
+                    }
+                }
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 8; i += 8)
+            {
+                __m128i iv = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(guide + i)), zero);
+                __m128i pv = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)), zero);
+                __m128i quantities[4] = {iv, pv, _mm_mullo_epi16(iv, pv), _mm_mullo_epi16(iv, iv)};
+                int32_t *cols[4] = {colI, colP, colIp, colII};
+                for (int q = 0; q < 4; ++q)
+                {
+                    __m128i lo = _mm_unpacklo_epi16(quantities[q], zero);
+                    __m128i hi = _mm_unpackhi_epi16(quantities[q], zero);
+                    __m128i *c0 = reinterpret_cast<__m128i *>(cols[q] + i);
+                    __m128i *c1 = reinterpret_cast<__m128i *>(cols[q] + i + 4);
+                    if (Add)
+                    {
+                        _mm_storeu_si128(c0, _mm_add_epi32(_mm_loadu_si128(c0), lo));
+                        _mm_storeu_si128(c1, _mm_add_epi32(_mm_loadu_si128(c1), hi));
+                    }
+                    else
+                    {
+                        _mm_storeu_si128(c0, _mm_sub_epi32(_mm_loadu_si128(c0), lo));
+                        _mm_storeu_si128(c1, _mm_sub_epi32(_mm_loadu_si128(c1), hi));
+                    }
+                }
+            }
+#endif
+#endif
+            const int sign = Add ? 1 : -1;
+            for (; i < count; ++i)
+            {
+                int iv = guide[i];
+                int pv = src[i];
+                colI[i] += sign * iv;
+                colP[i] += sign * pv;
+                colIp[i] += sign * iv * pv;
+                colII[i] += sign * iv * iv;
+            }
+        }
+
+        /**
+         * @brief 引导滤波第二阶段的列和：系数a、b按double累加，避免长距离滑动产生的累积误差
+         */
+        template <bool Add>
+        void updateCoefColumns(const float *a, const float *b, int count, double *colA, double *colB)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= count - 4; i += 4)
+            {
+                __m256d va = _mm256_cvtps_pd(_mm_loadu_ps(a + i));
+                __m256d vb = _mm256_cvtps_pd(_mm_loadu_ps(b + i));
+                __m256d ca = _mm256_loadu_pd(colA + i);
+                __m256d cb = _mm256_loadu_pd(colB + i);
+                _mm256_storeu_pd(colA + i, Add ? _mm256_add_pd(ca, va) : _mm256_sub_pd(ca, va));
+                _mm256_storeu_pd(colB + i, Add ? _mm256_add_pd(cb, vb) : _mm256_sub_pd(cb, vb));
+            }
+#elif defined(__SSE2__)
+            for (; i <= count - 2; i += 2)
+            {
+                __m128d va = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(a + i))));
+                __m128d vb = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(b + i))));
+                __m128d ca = _mm_loadu_pd(colA + i);
+                __m128d cb = _mm_loadu_pd(colB + i);
+                _mm_storeu_pd(colA + i, Add ? _mm_add_pd(ca, va) : _mm_sub_pd(ca, va));
+                _mm_storeu_pd(colB + i, Add ? _mm_add_pd(cb, vb) : _mm_sub_pd(cb, vb));
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                if (Add)
+                {
+                    colA[i] += static_cast<double>(a[i]);
+                    colB[i] += static_cast<double>(b[i]);
+                }
+                else
+                {
+                    colA[i] -= static_cast<double>(a[i]);
+                    colB[i] -= static_cast<double>(b[i]);
+                }
+            }
+        }
+
+        /**
+         * @brief 对列和做水平窗口求和并乘以scale：左右复制边缘列后求前缀和，窗口和为两个前缀和之差
+         * @param prefix 工作缓冲区，长度至少为(width + 2 × radius + 1) × cn
+         */
+        template <typename T>
+        void horizontalWindow(const T *col, int width, int cn, int radius, double scale, double *prefix, double *out)
+        {
+            int padded = width + 2 * radius;
+            for (int c = 0; c < cn; ++c)
+            {
+                prefix[c] = 0.0;
+            }
+            for (int j = 0; j < padded; ++j)
+            {
+                int x = std::clamp(j - radius, 0, width - 1);
+                for (int c = 0; c < cn; ++c)
+                {
+                    prefix[(j + 1) * cn + c] = prefix[j * cn + c] + static_cast<double>(col[x * cn + c]);
+                }
+            }
+            int window = 2 * radius + 1;
+            for (int i = 0; i < width * cn; ++i)
+            {
+                out[i] = (prefix[i + window * cn] - prefix[i]) * scale;
+            }
+        }
+
+        /**
+         * @brief 返回第y行的引导数据：通道数相同时直接返回原始行，单通道引导时展开到buffer中
+         */
+        const unsigned char *guideRow(const OptimalImage &guide, int y, int cn, int width, unsigned char *buffer)
+        {
+            const unsigned char *row = guide.data() + y * guide.step();
+            if (guide.channels() == cn)
+            {
+                return row;
+            }
+            for (int x = 0; x < width; ++x)
+            {
+                for (int c = 0; c < cn; ++c)
+                {
+                    buffer[x * cn + c] = row[x];
+                }
+            }
+            return buffer;
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::bilateralFilter(int diameter, double sigmaColor, double sigmaSpace) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply bilateral filter to an empty image");
+        }
+
+        if (sigmaColor <= 0.0 || sigmaSpace <= 0.0)
+        {
+            std::stringstream ss;
+            ss << "Bilateral filter sigmas must be positive, but got sigmaColor=" << sigmaColor
+               << ", sigmaSpace=" << sigmaSpace;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        int radius = diameter > 0 ? diameter / 2 : std::max(1, static_cast<int>(std::lround(sigmaSpace * 1.5)));
+        if (radius == 0)
+        {
+            return clone();
+        }
+
+        // 空间权重和颜色权重表，中心处都为1
+        std::vector<float> space(2 * radius + 1);
+        for (int k = -radius; k <= radius; ++k)
+        {
+            space[k + radius] = static_cast<float>(std::exp(-(k * k) / (2.0 * sigmaSpace * sigmaSpace)));
+        }
+        int colorCn = std::min(channels_, BILATERAL_COLOR_CHANNELS);
+        std::vector<float> color(255 * colorCn + 1);
+        for (size_t d = 0; d < color.size(); ++d)
+        {
+            double dd = static_cast<double>(d);
+            color[d] = static_cast<float>(std::exp(-(dd * dd) / (2.0 * sigmaColor * sigmaColor)));
+        }
+
+        // 垂直 -> 转置 -> 垂直 -> 转置：两次都是对连续行的SIMD处理
+        OptimalImage vertical(width_, height_, channels_);
+        bilateralVertical(*this, vertical, radius, space.data(), color.data());
+        OptimalImage transposed(height_, width_, channels_);
+        detail::transposeImage(vertical, transposed);
+        OptimalImage horizontal(height_, width_, channels_);
+        bilateralVertical(transposed, horizontal, radius, space.data(), color.data());
+        OptimalImage result(width_, height_, channels_);
+        detail::transposeImage(horizontal, result);
+        return result;
+    }
+
+    OptimalImage OptimalImage::guidedFilter(const OptimalImage &guide, int radius, double eps) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot apply guided filter to an empty image");
+        }
+
+        if (guide.empty() || guide.width() != width_ || guide.height() != height_ ||
+            (guide.channels() != 1 && guide.channels() != channels_))
+        {
+            std::stringstream ss;
+            ss << "Guide image must be " << width_ << "x" << height_ << " with 1 or " << channels_
+               << " channels, but got " << guide.width() << "x" << guide.height() << "x" << guide.channels();
+            throw InvalidArgumentException(ss.str());
+        }
+
+        if (radius <= 0 || radius > GUIDED_MAX_RADIUS || eps <= 0.0)
+        {
+            std::stringstream ss;
+            ss << "Guided filter radius must be in [1, " << GUIDED_MAX_RADIUS << "] and eps must be positive, but got radius="
+               << radius << ", eps=" << eps;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        int cn = channels_;
+        int count = width_ * cn;
+        int pixelCount = width_ * height_;
+        int prefixLength = (width_ + 2 * radius + 1) * cn;
+        double scale = 1.0 / (static_cast<double>(2 * radius + 1) * (2 * radius + 1));
+        ImageBuffer<float> coefA(width_, height_, cn);
+        ImageBuffer<float> coefB(width_, height_, cn);
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height_) : 1;
+
+        // 第一阶段：a = cov(I, p) / (var(I) + eps)，b = mean(p) - a × mean(I)
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<int32_t> cols(static_cast<size_t>(count) * 4, 0);
+            int32_t *colI = cols.data();
+            int32_t *colP = colI + count;
+            int32_t *colIp = colP + count;
+            int32_t *colII = colIp + count;
+            std::vector<unsigned char> expanded(count);
+            std::vector<double> prefix(prefixLength);
+            std::vector<double> means(static_cast<size_t>(count) * 4);
+            double *meanI = means.data();
+            double *meanP = meanI + count;
+            double *meanIp = meanP + count;
+            double *meanII = meanIp + count;
+
+            int yBegin = detail::stripeBegin(height_, stripes, s);
+            int yEnd = detail::stripeBegin(height_, stripes, s + 1);
+            for (int k = -radius; k <= radius; ++k)
+            {
+                int sy = std::clamp(yBegin + k, 0, height_ - 1);
+                updateGuidedColumns<true>(guideRow(guide, sy, cn, width_, expanded.data()), data() + sy * step_, count,
+                                          colI, colP, colIp, colII);
+            }
+
+            for (int y = yBegin; y < yEnd; ++y)
+            {
+                horizontalWindow(colI, width_, cn, radius, scale, prefix.data(), meanI);
+                horizontalWindow(colP, width_, cn, radius, scale, prefix.data(), meanP);
+                horizontalWindow(colIp, width_, cn, radius, scale, prefix.data(), meanIp);
+                horizontalWindow(colII, width_, cn, radius, scale, prefix.data(), meanII);
+
+                float *a = coefA.row(y);
+                float *b = coefB.row(y);
+                for (int i = 0; i < count; ++i)
+                {
+                    double variance = meanII[i] - meanI[i] * meanI[i];
+                    double covariance = meanIp[i] - meanI[i] * meanP[i];
+                    double ai = covariance / (variance + eps);
+                    a[i] = static_cast<float>(ai);
+                    b[i] = static_cast<float>(meanP[i] - ai * meanI[i]);
+                }
+
+                if (y + 1 < yEnd)
+                {
+                    int addY = std::min(y + radius + 1, height_ - 1);
+                    int subY = std::max(y - radius, 0);
+                    updateGuidedColumns<true>(guideRow(guide, addY, cn, width_, expanded.data()), data() + addY * step_,
+                                              count, colI, colP, colIp, colII);
+                    updateGuidedColumns<false>(guideRow(guide, subY, cn, width_, expanded.data()), data() + subY * step_,
+                                               count, colI, colP, colIp, colII);
+                }
+            }
+        }
+
+        // 第二阶段：q = mean(a) × I + mean(b)
+        OptimalImage result(width_, height_, cn);
+        unsigned char *dstData = result.data();
+        size_t dstStep = result.step();
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<double> cols(static_cast<size_t>(count) * 2, 0.0);
+            double *colA = cols.data();
+            double *colB = colA + count;
+            std::vector<unsigned char> expanded(count);
+            std::vector<double> prefix(prefixLength);
+            std::vector<double> means(static_cast<size_t>(count) * 2);
+            double *meanA = means.data();
+            double *meanB = meanA + count;
+            std::vector<float> out(count);
+
+            int yBegin = detail::stripeBegin(height_, stripes, s);
+            int yEnd = detail::stripeBegin(height_, stripes, s + 1);
+            for (int k = -radius; k <= radius; ++k)
+            {
+                int sy = std::clamp(yBegin + k, 0, height_ - 1);
+                updateCoefColumns<true>(coefA.row(sy), coefB.row(sy), count, colA, colB);
+            }
+
+            for (int y = yBegin; y < yEnd; ++y)
+            {
+                horizontalWindow(colA, width_, cn, radius, scale, prefix.data(), meanA);
+                horizontalWindow(colB, width_, cn, radius, scale, prefix.data(), meanB);
+
+                const unsigned char *g = guideRow(guide, y, cn, width_, expanded.data());
+                for (int i = 0; i < count; ++i)
+                {
+                    out[i] = static_cast<float>(meanA[i] * g[i] + meanB[i]);
+                }
+                detail::storeRow(out.data(), dstData + y * dstStep, count);
+
+                if (y + 1 < yEnd)
+                {
+                    int addY = std::min(y + radius + 1, height_ - 1);
+                    int subY = std::max(y - radius, 0);
+                    updateCoefColumns<true>(coefA.row(addY), coefB.row(addY), count, colA, colB);
+                    updateCoefColumns<false>(coefA.row(subY), coefB.row(subY), count, colA, colB);
+                }
+            }
+        }
+
+        return result;
+    }
+
+} // namespace mylib
@@ -0,0 +1,1036 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 32位平方和累加器每次最多累加的SIMD迭代数，之后转入64位，保证不溢出
+        constexpr int SQUARE_FLUSH_BLOCKS = 4096;
+
+        // SSIM的稳定常数：C1 = (0.01 × 255)²，C2 = (0.03 × 255)²
+        constexpr float SSIM_C1 = 6.5025f;
+        constexpr float SSIM_C2 = 58.5225f;
+
+        // SSIM高斯窗口的标准差
+        constexpr double SSIM_SIGMA = 1.5;
+
+        /**
+         * @brief 按通道收集字节的pshufb掩码
+         * 以相位p（16字节块首字节所在的通道）为下标：a把通道0、1的字节分别收集到低、高8字节，b收集通道2、3，
+         * 其余位置填0x80（输出0），这样sad和madd的每个64位通道只包含一个颜色通道
+         * 单通道图像按两个虚拟通道处理，最后合并
+         */
+        struct GatherMasks
+        {
+            signed char a[4][16];
+            signed char b[4][16];
+        };
+
+        GatherMasks makeGatherMasks(int vc)
+        {
+            GatherMasks masks;
+            std::fill(&masks.a[0][0], &masks.a[0][0] + 4 * 16, static_cast<signed char>(-128));
+            std::fill(&masks.b[0][0], &masks.b[0][0] + 4 * 16, static_cast<signed char>(-128));
+            for (int p = 0; p < vc; ++p)
+            {
+                int fill[4] = {0, 0, 0, 0};
+                for (int j = 0; j < 16; ++j)
+                {
+                    int ch = (p + j) % vc;
+                    signed char *dst = ch < 2 ? masks.a[p] : masks.b[p];
+                    dst[(ch & 1) * 8 + fill[ch]++] = static_cast<signed char>(j);
+                }
+            }
+            return masks;
+        }
+
+        /**
+         * @brief 累加一行各（虚拟）通道的和与平方和，字节i属于虚拟通道i % vc
+         * @tparam Squares 是否同时累加平方和
+         * @param vc 虚拟通道数，取值2~4
+         */
+        template <bool Squares>
+        void rowMoments(const unsigned char *row, int count, int vc, const GatherMasks &masks,
+                        uint64_t *sum, uint64_t *sumSq)
+        {
+            int i = 0;
+
+#if !defined(USE_SIMD) || !(defined(__AVX2__) || defined(__SSSE3__))
+            // 重排掩码只在SIMD路径中使用
+            (void)masks;
+#endif
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            // 32字节块两个128位通道的相位不同，按块首字节的相位预先拼好掩码
+            __m256i maskA[4], maskB[4];
+            for (int p = 0; p < vc; ++p)
+            {
+                int q = (p + 16) % vc;
+                maskA[p] = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(masks.a[p]))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks.a[q])), 1);
+                maskB[p] = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(masks.b[p]))),
+                    _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks.b[q])), 1);
+            }
+
+            const __m256i zero = _mm256_setzero_si256();
+            __m256i sumA = zero;
+            __m256i sumB = zero;
+            int phase = 0;
+            while (i <= count - 32)
+            {
+                __m256i sq[4] = {zero, zero, zero, zero};
+                int blockEnd = std::min(count - 32, i + (SQUARE_FLUSH_BLOCKS - 1) * 32);
+                for (; i <= blockEnd; i += 32)
+                {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+                    __m256i ga = _mm256_shuffle_epi8(v, maskA[phase]);
+                    sumA = _mm256_add_epi64(sumA, _mm256_sad_epu8(ga, zero));
+                    __m256i gb = zero;
+                    if (vc > 2)
+                    {
+                        gb = _mm256_shuffle_epi8(v, maskB[phase]);
+                        sumB = _mm256_add_epi64(sumB, _mm256_sad_epu8(gb, zero));
+                    }
+                    if (Squares)
+                    {
+                        __m256i lo = _mm256_unpacklo_epi8(ga, zero);
+                        __m256i hi = _mm256_unpackhi_epi8(ga, zero);
+                        sq[0] = _mm256_add_epi32(sq[0], _mm256_madd_epi16(lo, lo));
+                        sq[1] = _mm256_add_epi32(sq[1], _mm256_madd_epi16(hi, hi));
+                        if (vc > 2)
+                        {
+                            lo = _mm256_unpacklo_epi8(gb, zero);
+                            hi = _mm256_unpackhi_epi8(gb, zero);
+                            sq[2] = _mm256_add_epi32(sq[2], _mm256_madd_epi16(lo, lo));
+                            sq[3] = _mm256_add_epi32(sq[3], _mm256_madd_epi16(hi, hi));
+                        }
+                    }
+                    phase = (phase + 32) % vc;
+                }
+                if (Squares)
+                {
+                    alignas(32) uint32_t lanes[8];
+                    for (int c = 0; c < vc; ++c)
+                    {
+                        _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sq[c]);
+                        for (int k = 0; k < 8; ++k)
+                        {
+                            sumSq[c] += lanes[k];
+                        }
+                    }
+                }
+            }
+
+            alignas(32) uint64_t lanes[4];
+            _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sumA);
+            sum[0] += lanes[0] + lanes[2];
+            sum[1] += lanes[1] + lanes[3];
+            if (vc > 2)
+            {
+                _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), sumB);
+                sum[2] += lanes[0] + lanes[2];
+                if (vc > 3)
+                {
+                    sum[3] += lanes[1] + lanes[3];
+                }
+            }
+#elif defined(__SSSE3__)
+            __m128i maskA[4], maskB[4];
+            for (int p = 0; p < vc; ++p)
+            {
+                maskA[p] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks.a[p]));
+                maskB[p] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(masks.b[p]));
+            }
+
+            const __m128i zero = _mm_setzero_si128();
+            __m128i sumA = zero;
+            __m128i sumB = zero;
+            int phase = 0;
+            while (i <= count - 16)
+            {
+                __m128i sq[4] = {zero, zero, zero, zero};
+                int blockEnd = std::min(count - 16, i + (SQUARE_FLUSH_BLOCKS - 1) * 16);
+                for (; i <= blockEnd; i += 16)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+                    __m128i ga = _mm_shuffle_epi8(v, maskA[phase]);
+                    sumA = _mm_add_epi64(sumA, _mm_sad_epu8(ga, zero));
+                    __m128i gb = zero;
+                    if (vc > 2)
+                    {
+                        gb = _mm_shuffle_epi8(v, maskB[phase]);
+                        sumB = _mm_add_epi64(sumB, _mm_sad_epu8(gb, zero));
+                    }
+                    if (Squares)
+                    {
+                        __m128i lo = _mm_unpacklo_epi8(ga, zero);
+                        __m128i hi = _mm_unpackhi_epi8(ga, zero);
+                        sq[0] = _mm_add_epi32(sq[0], _mm_madd_epi16(lo, lo));
+                        sq[1] = _mm_add_epi32(sq[1], _mm_madd_epi16(hi, hi));
+                        if (vc > 2)
+                        {
+                            lo = _mm_unpacklo_epi8(gb, zero);
+                            hi = _mm_unpackhi_epi8(gb, zero);
+                            sq[2] = _mm_add_epi32(sq[2], _mm_madd_epi16(lo, lo));
+                            sq[3] = _mm_add_epi32(sq[3], _mm_madd_epi16(hi, hi));
+                        }
+                    }
+                    phase = (phase + 16) % vc;
+                }
+                if (Squares)
+                {
+                    alignas(16) uint32_t lanes[4];
+                    for (int c = 0; c < vc; ++c)
+                    {
+                        _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sq[c]);
+                        sumSq[c] += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+                    }
+                }
+            }
+
+            alignas(16) uint64_t lanes[2];
+            _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sumA);
+            sum[0] += lanes[0];
+            sum[1] += lanes[1];
+            if (vc > 2)
+            {
+                _mm_store_si128(reinterpret_cast<__m128i *>(lanes), sumB);
+                sum[2] += lanes[0];
+                if (vc > 3)
+                {
+                    sum[3] += lanes[1];
+                }
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                unsigned v = row[i];
+                sum[i % vc] += v;
+                if (Squares)
+                {
+                    sumSq[i % vc] += v * v;
+                }
+            }
+        }
+
+        /**
+         * @brief 计算每个通道的和与平方和，按行条带并行，条带结果为整数，合并顺序不影响结果
+         */
+        template <bool Squares>
+        void imageMoments(const OptimalImage &img, std::vector<uint64_t> &sum, std::vector<uint64_t> &sumSq)
+        {
+            int width = img.width();
+            int height = img.height();
+            int cn = img.channels();
+            int count = width * cn;
+            int pixelCount = width * height;
+            // 1~4通道走SIMD按通道收集，单通道当作两个虚拟通道；更多通道直接标量累加
+            int vc = cn == 1 ? 2 : cn;
+            GatherMasks masks = makeGatherMasks(std::min(vc, 4));
+
+            int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+            std::vector<uint64_t> partialSum(static_cast<size_t>(stripes) * vc, 0);
+            std::vector<uint64_t> partialSq(static_cast<size_t>(stripes) * vc, 0);
+
+#pragma omp parallel for if (stripes > 1)
+            for (int s = 0; s < stripes; ++s)
+            {
+                uint64_t *ps = partialSum.data() + static_cast<size_t>(s) * vc;
+                uint64_t *pq = partialSq.data() + static_cast<size_t>(s) * vc;
+                int yEnd = detail::stripeBegin(height, stripes, s + 1);
+                for (int y = detail::stripeBegin(height, stripes, s); y < yEnd; ++y)
+                {
+                    const unsigned char *row = img.data() + y * img.step();
+                    if (vc <= 4)
+                    {
+                        rowMoments<Squares>(row, count, vc, masks, ps, pq);
+                    }
+                    else
+                    {
+                        for (int i = 0; i < count; ++i)
+                        {
+                            unsigned v = row[i];
+                            ps[i % vc] += v;
+                            if (Squares)
+                            {
+                                pq[i % vc] += v * v;
+                            }
+                        }
+                    }
+                }
+            }
+
+            sum.assign(cn, 0);
+            sumSq.assign(cn, 0);
+            for (int s = 0; s < stripes; ++s)
+            {
+                for (int c = 0; c < vc; ++c)
+                {
+                    sum[c % cn] += partialSum[static_cast<size_t>(s) * vc + c];
+                    sumSq[c % cn] += partialSq[static_cast<size_t>(s) * vc + c];
+                }
+            }
+        }
+
+        /**
+         * @brief 计算一行每个通道的最小值和最大值
+         * 向量长度能被通道数整除时一个累加器的每个字节通道固定对应一个颜色通道；
+         * 三通道时轮流使用三个累加器，第t个累加器第j字节对应通道(VEC × t + j) % 3
+         */
+        void rowMinMax(const unsigned char *row, int width, int cn, int *mn, int *mx)
+        {
+            int count = width * cn;
+            for (int c = 0; c < cn; ++c)
+            {
+                mn[c] = 255;
+                mx[c] = 0;
+            }
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            if (cn <= 4)
+            {
+                int nAcc = 32 % cn == 0 ? 1 : cn;
+                __m256i vMin[4], vMax[4];
+                for (int t = 0; t < nAcc; ++t)
+                {
+                    vMin[t] = _mm256_set1_epi8(-1);
+                    vMax[t] = _mm256_setzero_si256();
+                }
+                int t = 0;
+                for (; i <= count - 32; i += 32)
+                {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(row + i));
+                    vMin[t] = _mm256_min_epu8(vMin[t], v);
+                    vMax[t] = _mm256_max_epu8(vMax[t], v);
+                    t = t + 1 == nAcc ? 0 : t + 1;
+                }
+                alignas(32) unsigned char lanesMin[32], lanesMax[32];
+                for (int k = 0; k < nAcc; ++k)
+                {
+                    _mm256_store_si256(reinterpret_cast<__m256i *>(lanesMin), vMin[k]);
+                    _mm256_store_si256(reinterpret_cast<__m256i *>(lanesMax), vMax[k]);
+                    for (int j = 0; j < 32; ++j)
+                    {
+                        int c = (32 * k + j) % cn;
+                        mn[c] = std::min<int>(mn[c], lanesMin[j]);
+                        mx[c] = std::max<int>(mx[c], lanesMax[j]);
+                    }
+                }
+            }
+#elif defined(__SSE2__)
+            if (cn <= 4)
+            {
+                int nAcc = 16 % cn == 0 ? 1 : cn;
+                __m128i vMin[4], vMax[4];
+                for (int t = 0; t < nAcc; ++t)
+                {
+                    vMin[t] = _mm_set1_epi8(-1);
+                    vMax[t] = _mm_setzero_si128();
+                }
+                int t = 0;
+                for (; i <= count - 16; i += 16)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i));
+                    vMin[t] = _mm_min_epu8(vMin[t], v);
+                    vMax[t] = _mm_max_epu8(vMax[t], v);
+                    t = t + 1 == nAcc ? 0 : t + 1;
+                }
+                alignas(16) unsigned char lanesMin[16], lanesMax[16];
+                for (int k = 0; k < nAcc; ++k)
+                {
+                    _mm_store_si128(reinterpret_cast<__m128i *>(lanesMin), vMin[k]);
+                    _mm_store_si128(reinterpret_cast<__m128i *>(lanesMax), vMax[k]);
+                    for (int j = 0; j < 16; ++j)
+                    {
+                        int c = (16 * k + j) % cn;
+                        mn[c] = std::min<int>(mn[c], lanesMin[j]);
+                        mx[c] = std::max<int>(mx[c], lanesMax[j]);
+                    }
+                }
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                int c = i % cn;
+                mn[c] = std::min<int>(mn[c], row[i]);
+                mx[c] = std::max<int>(mx[c], row[i]);
+            }
+        }
+
+        /**
+         * @brief 在一行中查找通道c第一次等于value的像素
+         */
+        int findInRow(const unsigned char *row, int width, int cn, int c, int value)
+        {
+            for (int x = 0; x < width; ++x)
+            {
+                if (row[x * cn + c] == value)
+                {
+                    return x;
+                }
+            }
+            return 0;
+        }
+
+        /**
+         * @brief 用b中更早或更优的结果更新a，严格比较保证取光栅顺序第一次出现的位置（b在a之后）
+         */
+        void mergeMinMax(MinMaxLocation &a, const MinMaxLocation &b)
+        {
+            if (b.minValue < a.minValue)
+            {
+                a.minValue = b.minValue;
+                a.minX = b.minX;
+                a.minY = b.minY;
+            }
+            if (b.maxValue > a.maxValue)
+            {
+                a.maxValue = b.maxValue;
+                a.maxX = b.maxX;
+                a.maxY = b.maxY;
+            }
+        }
+
+        /**
+         * @brief 两行差值的归约：L1累加绝对差，L2累加差的平方，Inf取最大绝对差
+         */
+        void rowDiff(const unsigned char *a, const unsigned char *b, int count, NormType type,
+                     uint64_t &acc, int &maxAbs)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i zero = _mm256_setzero_si256();
+            if (type == NormType::L1)
+            {
+                __m256i vSum = zero;
+                for (; i <= count - 32; i += 32)
+                {
+                    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                    vSum = _mm256_add_epi64(vSum, _mm256_sad_epu8(va, vb));
+                }
+                alignas(32) uint64_t lanes[4];
+                _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), vSum);
+                acc += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+            }
+            else if (type == NormType::L2)
+            {
+                while (i <= count - 32)
+                {
+                    __m256i vSq = zero;
+                    int blockEnd = std::min(count - 32, i + (SQUARE_FLUSH_BLOCKS - 1) * 32);
+                    for (; i <= blockEnd; i += 32)
+                    {
+                        __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                        __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                        __m256i d = _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va));
+                        __m256i lo = _mm256_unpacklo_epi8(d, zero);
+                        __m256i hi = _mm256_unpackhi_epi8(d, zero);
+                        vSq = _mm256_add_epi32(vSq, _mm256_add_epi32(_mm256_madd_epi16(lo, lo), _mm256_madd_epi16(hi, hi)));
+                    }
+                    alignas(32) uint32_t lanes[8];
+                    _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), vSq);
+                    for (int k = 0; k < 8; ++k)
+                    {
+                        acc += lanes[k];
+                    }
+                }
+            }
+            else
+            {
+                __m256i vMax = zero;
+                for (; i <= count - 32; i += 32)
+                {
+                    __m256i va = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                    __m256i vb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                    vMax = _mm256_max_epu8(vMax, _mm256_or_si256(_mm256_subs_epu8(va, vb), _mm256_subs_epu8(vb, va)));
+                }
+                alignas(32) unsigned char lanes[32];
+                _mm256_store_si256(reinterpret_cast<__m256i *>(lanes), vMax);
+                for (int k = 0; k < 32; ++k)
+                {
+                    maxAbs = std::max<int>(maxAbs, lanes[k]);
+                }
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            if (type == NormType::L1)
+            {
+                __m128i vSum = zero;
+                for (; i <= count - 16; i += 16)
+                {
+                    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                    vSum = _mm_add_epi64(vSum, _mm_sad_epu8(va, vb));
+                }
+                alignas(16) uint64_t lanes[2];
+                _mm_store_si128(reinterpret_cast<__m128i *>(lanes), vSum);
+                acc += lanes[0] + lanes[1];
+            }
+            else if (type == NormType::L2)
+            {
+                while (i <= count - 16)
+                {
+                    __m128i vSq = zero;
+                    int blockEnd = std::min(count - 16, i + (SQUARE_FLUSH_BLOCKS - 1) * 16);
+                    for (; i <= blockEnd; i += 16)
+                    {
+                        __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                        __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                        __m128i d = _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va));
+                        __m128i lo = _mm_unpacklo_epi8(d, zero);
+                        __m128i hi = _mm_unpackhi_epi8(d, zero);
+                        vSq = _mm_add_epi32(vSq, _mm_add_epi32(_mm_madd_epi16(lo, lo), _mm_madd_epi16(hi, hi)));
+                    }
+                    alignas(16) uint32_t lanes[4];
+                    _mm_store_si128(reinterpret_cast<__m128i *>(lanes), vSq);
+                    acc += static_cast<uint64_t>(lanes[0]) + lanes[1] + lanes[2] + lanes[3];
+                }
+            }
+            else
+            {
+                __m128i vMax = zero;
+                for (; i <= count - 16; i += 16)
+                {
+                    __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                    __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                    vMax = _mm_max_epu8(vMax, _mm_or_si128(_mm_subs_epu8(va, vb), _mm_subs_epu8(vb, va)));
+                }
+                alignas(16) unsigned char lanes[16];
+                _mm_store_si128(reinterpret_cast<__m128i *>(lanes), vMax);
+                for (int k = 0; k < 16; ++k)
+                {
+                    maxAbs = std::max<int>(maxAbs, lanes[k]);
+                }
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                int d = std::abs(a[i] - b[i]);
+                if (type == NormType::L1)
+                {
+                    acc += static_cast<uint64_t>(d);
+                }
+                else if (type == NormType::L2)
+                {
+                    acc += static_cast<uint64_t>(d * d);
+                }
+                else
+                {
+                    maxAbs = std::max(maxAbs, d);
+                }
+            }
+        }
+
+        /**
+         * @brief 检查两张图像可以逐像素比较
+         */
+        void checkComparable(const OptimalImage &a, const OptimalImage &b, const char *operation)
+        {
+            if (a.empty() || b.empty())
+            {
+                std::stringstream ss;
+                ss << "Cannot compute " << operation << " of empty images";
+                throw InvalidArgumentException(ss.str());
+            }
+
+            if (a.width() != b.width() || a.height() != b.height() || a.channels() != b.channels())
+            {
+                std::stringstream ss;
+                ss << "Images must have the same dimensions and channels to compute " << operation << ", but got "
+                   << a.width() << "x" << a.height() << "x" << a.channels() << " and "
+                   << b.width() << "x" << b.height() << "x" << b.channels();
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        /**
+         * @brief 两张图像差值的整数归约，L1/L2返回绝对差和/平方和，Inf返回最大绝对差
+         */
+        uint64_t diffReduce(const OptimalImage &a, const OptimalImage &b, NormType type)
+        {
+            int height = a.height();
+            int count = a.width() * a.channels();
+            int pixelCount = a.width() * height;
+            int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+            std::vector<uint64_t> partialAcc(stripes, 0);
+            std::vector<int> partialMax(stripes, 0);
+
+#pragma omp parallel for if (stripes > 1)
+            for (int s = 0; s < stripes; ++s)
+            {
+                uint64_t acc = 0;
+                int maxAbs = 0;
+                int yEnd = detail::stripeBegin(height, stripes, s + 1);
+                for (int y = detail::stripeBegin(height, stripes, s); y < yEnd; ++y)
+                {
+                    rowDiff(a.data() + y * a.step(), b.data() + y * b.step(), count, type, acc, maxAbs);
+                }
+                partialAcc[s] = acc;
+                partialMax[s] = maxAbs;
+            }
+
+            uint64_t acc = 0;
+            int maxAbs = 0;
+            for (int s = 0; s < stripes; ++s)
+            {
+                acc += partialAcc[s];
+                maxAbs = std::max(maxAbs, partialMax[s]);
+            }
+            return type == NormType::Inf ? static_cast<uint64_t>(maxAbs) : acc;
+        }
+
+        /**
+         * @brief SSIM的垂直窗口：对五个量μa、μb、E[a²]、E[b²]、E[ab]做加权列求和，直接从8位行计算
+         * @param rowsA/rowsB 窗口覆盖的ksize个源行（边界行已复制）
+         * @param out 五个输出行，依次为a、b、a²、b²、ab
+         */
+        void ssimVertical(const unsigned char *const *rowsA, const unsigned char *const *rowsB, const float *kernel,
+                          int ksize, float *const *out, int count)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= count - 8; i += 8)
+            {
+                __m256 sa = _mm256_setzero_ps(), sb = _mm256_setzero_ps();
+                __m256 saa = _mm256_setzero_ps(), sbb = _mm256_setzero_ps(), sab = _mm256_setzero_ps();
+                for (int k = 0; k < ksize; ++k)
+                {
+                    __m256 w = _mm256_set1_ps(kernel[k]);
+                    __m256 fa = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rowsA[k] + i))));
+                    __m256 fb = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rowsB[k] + i))));
+                    sa = _mm256_add_ps(sa, _mm256_mul_ps(w, fa));
+                    sb = _mm256_add_ps(sb, _mm256_mul_ps(w, fb));
+                    saa = _mm256_add_ps(saa, _mm256_mul_ps(w, _mm256_mul_ps(fa, fa)));
+                    sbb = _mm256_add_ps(sbb, _mm256_mul_ps(w, _mm256_mul_ps(fb, fb)));
+                    sab = _mm256_add_ps(sab, _mm256_mul_ps(w, _mm256_mul_ps(fa, fb)));
+                }
+                _mm256_storeu_ps(out[0] + i, sa);
+                _mm256_storeu_ps(out[1] + i, sb);
+                _mm256_storeu_ps(out[2] + i, saa);
+                _mm256_storeu_ps(out[3] + i, sbb);
+                _mm256_storeu_ps(out[4] + i, sab);
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 4; i += 4)
+            {
+                __m128 sa = _mm_setzero_ps(), sb = _mm_setzero_ps();
+                __m128 saa = _mm_setzero_ps(), sbb = _mm_setzero_ps(), sab = _mm_setzero_ps();
+                for (int k = 0; k < ksize; ++k)
+                {
+                    __m128 w = _mm_set1_ps(kernel[k]);
+                    int pa, pb;
+                    std::memcpy(&pa, rowsA[k] + i, 4);
+                    std::memcpy(&pb, rowsB[k] + i, 4);
+                    __m128 fa = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pa), zero), zero));
+                    __m128 fb = _mm_cvtepi32_ps(_mm_unpacklo_epi16(_mm_unpacklo_epi8(_mm_cvtsi32_si128(pb), zero), zero));
+                    sa = _mm_add_ps(sa, _mm_mul_ps(w, fa));
+                    sb = _mm_add_ps(sb, _mm_mul_ps(w, fb));
+                    saa = _mm_add_ps(saa, _mm_mul_ps(w, _mm_mul_ps(fa, fa)));
+                    sbb = _mm_add_ps(sbb, _mm_mul_ps(w, _mm_mul_ps(fb, fb)));
+                    sab = _mm_add_ps(sab, _mm_mul_ps(w, _mm_mul_ps(fa, fb)));
+                }
+                _mm_storeu_ps(out[0] + i, sa);
+                _mm_storeu_ps(out[1] + i, sb);
+                _mm_storeu_ps(out[2] + i, saa);
+                _mm_storeu_ps(out[3] + i, sbb);
+                _mm_storeu_ps(out[4] + i, sab);
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                float sa = 0.0f, sb = 0.0f, saa = 0.0f, sbb = 0.0f, sab = 0.0f;
+                for (int k = 0; k < ksize; ++k)
+                {
+                    float w = kernel[k];
+                    float fa = static_cast<float>(rowsA[k][i]);
+                    float fb = static_cast<float>(rowsB[k][i]);
+                    sa += w * fa;
+                    sb += w * fb;
+                    saa += w * (fa * fa);
+                    sbb += w * (fb * fb);
+                    sab += w * (fa * fb);
+                }
+                out[0][i] = sa;
+                out[1][i] = sb;
+                out[2][i] = saa;
+                out[3][i] = sbb;
+                out[4][i] = sab;
+            }
+        }
+
+        /**
+         * @brief SSIM的水平窗口：dst[i] = Σ kernel[k] × src[i + k × cn]，src已在两侧复制填充
+         */
+        void ssimHorizontal(const float *src, const float *kernel, int ksize, int cn, float *dst, int count)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            for (; i <= count - 8; i += 8)
+            {
+                __m256 acc = _mm256_setzero_ps();
+                for (int k = 0; k < ksize; ++k)
+                {
+                    acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_set1_ps(kernel[k]), _mm256_loadu_ps(src + i + k * cn)));
+                }
+                _mm256_storeu_ps(dst + i, acc);
+            }
+#elif defined(__SSE2__)
+            for (; i <= count - 4; i += 4)
+            {
+                __m128 acc = _mm_setzero_ps();
+                for (int k = 0; k < ksize; ++k)
+                {
+                    acc = _mm_add_ps(acc, _mm_mul_ps(_mm_set1_ps(kernel[k]), _mm_loadu_ps(src + i + k * cn)));
+                }
+                _mm_storeu_ps(dst + i, acc);
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                float acc = 0.0f;
+                for (int k = 0; k < ksize; ++k)
+                {
+                    acc += kernel[k] * src[i + k * cn];
+                }
+                dst[i] = acc;
+            }
+        }
+
+        /**
+         * @brief 由窗口统计量计算一行SSIM并返回其和
+         * ssim = (2μaμb + C1)(2σab + C2) / ((μa² + μb² + C1)(σa² + σb² + C2))
+         */
+        double ssimRowSum(const float *const *m, int count)
+        {
+            int i = 0;
+            double total = 0.0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256 c1 = _mm256_set1_ps(SSIM_C1);
+            const __m256 c2 = _mm256_set1_ps(SSIM_C2);
+            const __m256 two = _mm256_set1_ps(2.0f);
+            alignas(32) float lanes[8];
+            for (; i <= count - 8; i += 8)
+            {
+                __m256 ma = _mm256_loadu_ps(m[0] + i);
+                __m256 mb = _mm256_loadu_ps(m[1] + i);
+                __m256 maa = _mm256_mul_ps(ma, ma);
+                __m256 mbb = _mm256_mul_ps(mb, mb);
+                __m256 mab = _mm256_mul_ps(ma, mb);
+                __m256 va = _mm256_sub_ps(_mm256_loadu_ps(m[2] + i), maa);
+                __m256 vb = _mm256_sub_ps(_mm256_loadu_ps(m[3] + i), mbb);
+                __m256 cov = _mm256_sub_ps(_mm256_loadu_ps(m[4] + i), mab);
+                __m256 num = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(two, mab), c1), _mm256_add_ps(_mm256_mul_ps(two, cov), c2));
+                __m256 den = _mm256_mul_ps(_mm256_add_ps(_mm256_add_ps(maa, mbb), c1), _mm256_add_ps(_mm256_add_ps(va, vb), c2));
+                _mm256_store_ps(lanes, _mm256_div_ps(num, den));
+                for (int k = 0; k < 8; ++k)
+                {
+                    total += lanes[k];
+                }
+            }
+#elif defined(__SSE2__)
+            const __m128 c1 = _mm_set1_ps(SSIM_C1);
+            const __m128 c2 = _mm_set1_ps(SSIM_C2);
+            const __m128 two = _mm_set1_ps(2.0f);
+            alignas(16) float lanes[4];
+            for (; i <= count - 4; i += 4)
+            {
+                __m128 ma = _mm_loadu_ps(m[0] + i);
+                __m128 mb = _mm_loadu_ps(m[1] + i);
+                __m128 maa = _mm_mul_ps(ma, ma);
+                __m128 mbb = _mm_mul_ps(mb, mb);
+                __m128 mab = _mm_mul_ps(ma, mb);
+                __m128 va = _mm_sub_ps(_mm_loadu_ps(m[2] + i), maa);
+                __m128 vb = _mm_sub_ps(_mm_loadu_ps(m[3] + i), mbb);
+                __m128 cov = _mm_sub_ps(_mm_loadu_ps(m[4] + i), mab);
+                __m128 num = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(two, mab), c1), _mm_add_ps(_mm_mul_ps(two, cov), c2));
+                __m128 den = _mm_mul_ps(_mm_add_ps(_mm_add_ps(maa, mbb), c1), _mm_add_ps(_mm_add_ps(va, vb), c2));
+                _mm_store_ps(lanes, _mm_div_ps(num, den));
+                for (int k = 0; k < 4; ++k)
+                {
+                    total += lanes[k];
+                }
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                float ma = m[0][i], mb = m[1][i];
+                float maa = ma * ma, mbb = mb * mb, mab = ma * mb;
+                float va = m[2][i] - maa;
+                float vb = m[3][i] - mbb;
+                float cov = m[4][i] - mab;
+                float num = (2.0f * mab + SSIM_C1) * (2.0f * cov + SSIM_C2);
+                float den = (maa + mbb + SSIM_C1) * (va + vb + SSIM_C2);
+                total += num / den;
+            }
+            return total;
+        }
+    } // namespace
+
+    std::vector<double> OptimalImage::sum() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute sum of an empty image");
+        }
+
+        std::vector<uint64_t> sums, squares;
+        imageMoments<false>(*this, sums, squares);
+        return std::vector<double>(sums.begin(), sums.end());
+    }
+
+    std::vector<double> OptimalImage::mean() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute mean of an empty image");
+        }
+
+        std::vector<uint64_t> sums, squares;
+        imageMoments<false>(*this, sums, squares);
+        double n = static_cast<double>(width_) * height_;
+        std::vector<double> result(channels_);
+        for (int c = 0; c < channels_; ++c)
+        {
+            result[c] = static_cast<double>(sums[c]) / n;
+        }
+        return result;
+    }
+
+    void OptimalImage::meanStdDev(std::vector<double> &mean, std::vector<double> &stddev) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute mean and standard deviation of an empty image");
+        }
+
+        std::vector<uint64_t> sums, squares;
+        imageMoments<true>(*this, sums, squares);
+        double n = static_cast<double>(width_) * height_;
+        mean.assign(channels_, 0.0);
+        stddev.assign(channels_, 0.0);
+        for (int c = 0; c < channels_; ++c)
+        {
+            double m = static_cast<double>(sums[c]) / n;
+            double variance = static_cast<double>(squares[c]) / n - m * m;
+            mean[c] = m;
+            stddev[c] = std::sqrt(std::max(variance, 0.0));
+        }
+    }
+
+    std::vector<MinMaxLocation> OptimalImage::minMaxLoc() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot compute min/max of an empty image");
+        }
+
+        int pixelCount = width_ * height_;
+        int cn = channels_;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height_) : 1;
+        std::vector<MinMaxLocation> partial(static_cast<size_t>(stripes) * cn);
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            MinMaxLocation *best = partial.data() + static_cast<size_t>(s) * cn;
+            std::vector<int> rowMin(cn), rowMax(cn);
+            for (int c = 0; c < cn; ++c)
+            {
+                best[c].minValue = 256;
+                best[c].maxValue = -1;
+            }
+
+            int yEnd = detail::stripeBegin(height_, stripes, s + 1);
+            for (int y = detail::stripeBegin(height_, stripes, s); y < yEnd; ++y)
+            {
+                const unsigned char *row = data() + y * step_;
+                rowMinMax(row, width_, cn, rowMin.data(), rowMax.data());
+                // 只有行极值改善全局结果时才回头查找位置，通常只发生在前几行
+                for (int c = 0; c < cn; ++c)
+                {
+                    if (rowMin[c] < best[c].minValue)
+                    {
+                        best[c].minValue = rowMin[c];
+                        best[c].minX = findInRow(row, width_, cn, c, rowMin[c]);
+                        best[c].minY = y;
+                    }
+                    if (rowMax[c] > best[c].maxValue)
+                    {
+                        best[c].maxValue = rowMax[c];
+                        best[c].maxX = findInRow(row, width_, cn, c, rowMax[c]);
+                        best[c].maxY = y;
+                    }
+                }
+            }
+        }
+
+        std::vector<MinMaxLocation> result(partial.begin(), partial.begin() + cn);
+        for (int s = 1; s < stripes; ++s)
+        {
+            for (int c = 0; c < cn; ++c)
+            {
+                mergeMinMax(result[c], partial[static_cast<size_t>(s) * cn + c]);
+            }
+        }
+        return result;
+    }
+
+    double OptimalImage::norm(const OptimalImage &a, const OptimalImage &b, NormType type)
+    {
+        checkComparable(a, b, "norm");
+
+        uint64_t value = diffReduce(a, b, type);
+        return type == NormType::L2 ? std::sqrt(static_cast<double>(value)) : static_cast<double>(value);
+    }
+
+    double OptimalImage::psnr(const OptimalImage &a, const OptimalImage &b)
+    {
+        checkComparable(a, b, "PSNR");
+
+        uint64_t sse = diffReduce(a, b, NormType::L2);
+        if (sse == 0)
+        {
+            return std::numeric_limits<double>::infinity();
+        }
+        double mse = static_cast<double>(sse) / (static_cast<double>(a.width()) * a.height() * a.channels());
+        return 10.0 * std::log10(255.0 * 255.0 / mse);
+    }
+
+    double OptimalImage::ssim(const OptimalImage &a, const OptimalImage &b, int windowSize, bool gaussian)
+    {
+        checkComparable(a, b, "SSIM");
+
+        if (windowSize <= 0 || windowSize % 2 == 0)
+        {
+            std::stringstream ss;
+            ss << "SSIM window size must be a positive odd number, but got " << windowSize;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        // 归一化的一维窗口，二维窗口为其外积
+        int radius = windowSize / 2;
+        std::vector<float> kernel(windowSize);
+        double kernelSum = 0.0;
+        std::vector<double> weights(windowSize, 1.0);
+        if (gaussian)
+        {
+            for (int k = 0; k < windowSize; ++k)
+            {
+                double x = k - radius;
+                weights[k] = std::exp(-(x * x) / (2.0 * SSIM_SIGMA * SSIM_SIGMA));
+            }
+        }
+        for (double w : weights)
+        {
+            kernelSum += w;
+        }
+        for (int k = 0; k < windowSize; ++k)
+        {
+            kernel[k] = static_cast<float>(weights[k] / kernelSum);
+        }
+
+        int width = a.width();
+        int height = a.height();
+        int cn = a.channels();
+        int count = width * cn;
+        int paddedCount = (width + 2 * radius) * cn;
+        int pixelCount = width * height;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+        std::vector<double> partial(stripes, 0.0);
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            // 每个条带只分配一次：五个填充过的垂直结果行和五个窗口统计量行
+            std::vector<float> vertical(static_cast<size_t>(paddedCount) * 5);
+            std::vector<float> moments(static_cast<size_t>(count) * 5);
+            std::vector<const unsigned char *> rowsA(windowSize), rowsB(windowSize);
+            float *vRows[5], *mRows[5];
+            for (int q = 0; q < 5; ++q)
+            {
+                vRows[q] = vertical.data() + static_cast<size_t>(q) * paddedCount + radius * cn;
+                mRows[q] = moments.data() + static_cast<size_t>(q) * count;
+            }
+
+            double total = 0.0;
+            int yEnd = detail::stripeBegin(height, stripes, s + 1);
+            for (int y = detail::stripeBegin(height, stripes, s); y < yEnd; ++y)
+            {
+                for (int k = 0; k < windowSize; ++k)
+                {
+                    int sy = std::clamp(y - radius + k, 0, height - 1);
+                    rowsA[k] = a.data() + sy * a.step();
+                    rowsB[k] = b.data() + sy * b.step();
+                }
+                ssimVertical(rowsA.data(), rowsB.data(), kernel.data(), windowSize, vRows, count);
+
+                for (int q = 0; q < 5; ++q)
+                {
+                    float *body = vRows[q];
+                    for (int r = 1; r <= radius; ++r)
+                    {
+                        for (int c = 0; c < cn; ++c)
+                        {
+                            body[-r * cn + c] = body[c];
+                            body[(width - 1 + r) * cn + c] = body[(width - 1) * cn + c];
+                        }
+                    }
+                    ssimHorizontal(body - radius * cn, kernel.data(), windowSize, cn, mRows[q], count);
+                }
+
+                total += ssimRowSum(mRows, count);
+            }
+            partial[s] = total;
+        }
+
+        double total = 0.0;
+        for (double t : partial)
+        {
+            total += t;
+        }
+        return total / (static_cast<double>(pixelCount) * cn);
+    }
+
+} // namespace mylib
@@ -0,0 +1,437 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        /**
+         * @brief 一行固定阈值化，先得到src > thresh的字节掩码，再按类型与maxValue或原值组合
+         * thresh < 0时所有像素满足条件，thresh >= 255时没有像素满足条件
+         */
+        void thresholdRow(const unsigned char *src, unsigned char *dst, int count, int thresh,
+                          unsigned char maxValue, ThresholdType type)
+        {
+            const bool allTrue = thresh < 0;
+            const bool noneTrue = thresh >= 255;
+            const unsigned char above = static_cast<unsigned char>(std::clamp(thresh + 1, 0, 255));
+            const unsigned char trunc = static_cast<unsigned char>(std::clamp(thresh, 0, 255));
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i vAbove = _mm256_set1_epi8(static_cast<char>(above));
+            const __m256i vTrunc = _mm256_set1_epi8(static_cast<char>(trunc));
+            const __m256i vMax = _mm256_set1_epi8(static_cast<char>(maxValue));
+            const __m256i ones = _mm256_set1_epi8(-1);
+            const __m256i zero = _mm256_setzero_si256();
+            for (; i <= count - 32; i += 32)
+            {
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                // 无符号比较：s >= thresh + 1 等价于 max(s, thresh + 1) == s
+                __m256i m = allTrue ? ones : (noneTrue ? zero : _mm256_cmpeq_epi8(_mm256_max_epu8(s, vAbove), s));
+                __m256i r;
+                switch (type)
+                {
+                case ThresholdType::Binary:
+                    r = _mm256_and_si256(m, vMax);
+                    break;
+                case ThresholdType::BinaryInv:
+                    r = _mm256_andnot_si256(m, vMax);
+                    break;
+                case ThresholdType::Trunc:
+                    r = _mm256_min_epu8(s, vTrunc);
+                    break;
+                case ThresholdType::ToZero:
+                    r = _mm256_and_si256(m, s);
+                    break;
+                default:
+                    r = _mm256_andnot_si256(m, s);
+                    break;
+                }
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), r);
+            }
+#elif defined(__SSE2__)
+            const __m128i vAbove = _mm_set1_epi8(static_cast<char>(above));
+            const __m128i vTrunc = _mm_set1_epi8(static_cast<char>(trunc));
+            const __m128i vMax = _mm_set1_epi8(static_cast<char>(maxValue));
+            const __m128i ones = _mm_set1_epi8(-1);
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 16; i += 16)
+            {
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                __m128i m = allTrue ? ones : (noneTrue ? zero : _mm_cmpeq_epi8(_mm_max_epu8(s, vAbove), s));
+                __m128i r;
+                switch (type)
+                {
+                case ThresholdType::Binary:
+                    r = _mm_and_si128(m, vMax);
+                    break;
+                case ThresholdType::BinaryInv:
+                    r = _mm_andnot_si128(m, vMax);
+                    break;
+                case ThresholdType::Trunc:
+                    r = _mm_min_epu8(s, vTrunc);
+                    break;
+                case ThresholdType::ToZero:
+                    r = _mm_and_si128(m, s);
+                    break;
+                default:
+                    r = _mm_andnot_si128(m, s);
+                    break;
+                }
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), r);
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                unsigned char s = src[i];
+                bool m = static_cast<int>(s) > thresh;
+                switch (type)
+                {
+                case ThresholdType::Binary:
+                    dst[i] = m ? maxValue : 0;
+                    break;
+                case ThresholdType::BinaryInv:
+                    dst[i] = m ? 0 : maxValue;
+                    break;
+                case ThresholdType::Trunc:
+                    dst[i] = std::min(s, trunc);
+                    break;
+                case ThresholdType::ToZero:
+                    dst[i] = m ? s : 0;
+                    break;
+                default:
+                    dst[i] = m ? 0 : s;
+                    break;
+                }
+            }
+        }
+
+        /**
+         * @brief 一行自适应阈值化：src - mean > bias时输出onValue，否则输出offValue
+         * 差值范围为[-255, 255]，扩展到16位后做有符号比较
+         */
+        void adaptiveRow(const unsigned char *src, const unsigned char *mean, unsigned char *dst, int count,
+                         int bias, unsigned char onValue, unsigned char offValue)
+        {
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i vBias = _mm256_set1_epi16(static_cast<short>(bias));
+            const __m128i vOn = _mm_set1_epi8(static_cast<char>(onValue));
+            const __m128i vOff = _mm_set1_epi8(static_cast<char>(offValue));
+            for (; i <= count - 16; i += 16)
+            {
+                __m256i s = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+                __m256i m = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(mean + i)));
+                __m256i gt = _mm256_cmpgt_epi16(_mm256_sub_epi16(s, m), vBias);
+                gt = _mm256_permute4x64_epi64(_mm256_packs_epi16(gt, gt), 0x08);
+                __m128i mask = _mm256_castsi256_si128(gt);
+                __m128i r = _mm_or_si128(_mm_and_si128(mask, vOn), _mm_andnot_si128(mask, vOff));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), r);
+            }
+#elif defined(__SSE2__)
+            const __m128i vBias = _mm_set1_epi16(static_cast<short>(bias));
+            const __m128i vOn = _mm_set1_epi8(static_cast<char>(onValue));
+            const __m128i vOff = _mm_set1_epi8(static_cast<char>(offValue));
+            const __m128i zero = _mm_setzero_si128();
+            for (; i <= count - 8; i += 8)
+            {
+                __m128i s = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i)), zero);
+                __m128i m = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(mean + i)), zero);
+                __m128i gt = _mm_cmpgt_epi16(_mm_sub_epi16(s, m), vBias);
+                __m128i mask = _mm_packs_epi16(gt, gt);
+                __m128i r = _mm_or_si128(_mm_and_si128(mask, vOn), _mm_andnot_si128(mask, vOff));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), r);
+            }
+#endif
+#endif
+            for (; i < count; ++i)
+            {
+                dst[i] = src[i] - mean[i] > bias ? onValue : offValue;
+            }
+        }
+
+        /**
+         * @brief 把0/非0字节掩码按位打包，movemask的位序正好是低位在前
+         * @param bits 输出行，调用前需清零
+         */
+        void packRow(const unsigned char *mask, uint8_t *bits, int width)
+        {
+            int x = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            const __m256i zero = _mm256_setzero_si256();
+            for (; x <= width - 32; x += 32)
+            {
+                __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(mask + x));
+                uint32_t word = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(m, zero)));
+                std::memcpy(bits + x / 8, &word, 4);
+            }
+#elif defined(__SSE2__)
+            const __m128i zero = _mm_setzero_si128();
+            for (; x <= width - 16; x += 16)
+            {
+                __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i *>(mask + x));
+                uint16_t word = static_cast<uint16_t>(~_mm_movemask_epi8(_mm_cmpeq_epi8(m, zero)));
+                std::memcpy(bits + x / 8, &word, 2);
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                if (mask[x])
+                {
+                    bits[x >> 3] |= static_cast<uint8_t>(1u << (x & 7));
+                }
+            }
+        }
+
+        void checkSingleChannel(const OptimalImage &img, const char *operation)
+        {
+            if (img.empty())
+            {
+                std::stringstream ss;
+                ss << "Cannot apply " << operation << " to an empty image";
+                throw OperationFailedException(ss.str());
+            }
+
+            if (img.channels() != 1)
+            {
+                std::stringstream ss;
+                ss << operation << " requires a single-channel image, but got " << img.channels() << " channels";
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        void checkMaxValue(int maxValue)
+        {
+            if (maxValue < 0 || maxValue > 255)
+            {
+                std::stringstream ss;
+                ss << "Threshold max value must be in [0, 255], but got " << maxValue;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        /**
+         * @brief 计算自适应阈值使用的局部均值图像（8位，四舍五入）
+         */
+        OptimalImage adaptiveMean(const OptimalImage &img, AdaptiveMethod method, int blockSize)
+        {
+            if (blockSize < 3 || blockSize % 2 == 0)
+            {
+                std::stringstream ss;
+                ss << "Adaptive threshold block size must be an odd number greater than 1, but got " << blockSize;
+                throw InvalidArgumentException(ss.str());
+            }
+
+            if (method == AdaptiveMethod::Mean)
+            {
+                return img.boxFilter(blockSize, blockSize);
+            }
+
+            // 与OpenCV的getGaussianKernel相同的默认sigma
+            double sigma = 0.3 * ((blockSize - 1) * 0.5 - 1) + 0.8;
+            int radius = blockSize / 2;
+            std::vector<float> kernel(blockSize);
+            double kernelSum = 0.0;
+            std::vector<double> weights(blockSize);
+            for (int i = 0; i < blockSize; ++i)
+            {
+                double x = i - radius;
+                weights[i] = std::exp(-(x * x) / (2 * sigma * sigma));
+                kernelSum += weights[i];
+            }
+            for (int i = 0; i < blockSize; ++i)
+            {
+                kernel[i] = static_cast<float>(weights[i] / kernelSum);
+            }
+            return img.sepFilter2D(kernel, kernel);
+        }
+
+        /**
+         * @brief 把C转为整数比较偏置：Binary为src - mean > -ceil(C)，BinaryInv为src - mean <= -floor(C)（与OpenCV一致）
+         */
+        int adaptiveBias(double C, bool inverse)
+        {
+            double delta = inverse ? std::floor(C) : std::ceil(C);
+            return static_cast<int>(std::clamp(-delta, -256.0, 256.0));
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::threshold(int thresh, int maxValue, ThresholdType type) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot threshold an empty image");
+        }
+        checkMaxValue(maxValue);
+
+        OptimalImage result(width_, height_, channels_);
+        unsigned char *dstData = result.data();
+        size_t dstStep = result.step();
+        int count = width_ * channels_;
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            thresholdRow(data() + y * step_, dstData + y * dstStep, count, thresh,
+                         static_cast<unsigned char>(maxValue), type);
+        }
+
+        return result;
+    }
+
+    PackedMask OptimalImage::thresholdPacked(int thresh, bool invert) const
+    {
+        checkSingleChannel(*this, "packed threshold");
+
+        PackedMask mask(width_, height_);
+        ThresholdType type = invert ? ThresholdType::BinaryInv : ThresholdType::Binary;
+        int pixelCount = width_ * height_;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height_) : 1;
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<unsigned char> bytes(width_);
+            int yEnd = detail::stripeBegin(height_, stripes, s + 1);
+            for (int y = detail::stripeBegin(height_, stripes, s); y < yEnd; ++y)
+            {
+                thresholdRow(data() + y * step_, bytes.data(), width_, thresh, 255, type);
+                packRow(bytes.data(), mask.row(y), width_);
+            }
+        }
+
+        return mask;
+    }
+
+    int OptimalImage::otsuThreshold() const
+    {
+        checkSingleChannel(*this, "Otsu threshold");
+
+        std::vector<size_t> hist = calcHist(0);
+        double total = static_cast<double>(width_) * height_;
+        double sumAll = 0.0;
+        for (int i = 0; i < 256; ++i)
+        {
+            sumAll += static_cast<double>(i) * hist[i];
+        }
+
+        // 遍历所有阈值，取类间方差wB × wF × (mB - mF)²最大的一个
+        double sumBackground = 0.0;
+        double weightBackground = 0.0;
+        double bestVariance = -1.0;
+        int best = 0;
+        for (int t = 0; t < 256; ++t)
+        {
+            weightBackground += static_cast<double>(hist[t]);
+            if (weightBackground == 0.0)
+            {
+                continue;
+            }
+            double weightForeground = total - weightBackground;
+            if (weightForeground == 0.0)
+            {
+                break;
+            }
+            sumBackground += static_cast<double>(t) * hist[t];
+            double meanBackground = sumBackground / weightBackground;
+            double meanForeground = (sumAll - sumBackground) / weightForeground;
+            double diff = meanBackground - meanForeground;
+            double variance = weightBackground * weightForeground * diff * diff;
+            if (variance > bestVariance)
+            {
+                bestVariance = variance;
+                best = t;
+            }
+        }
+        return best;
+    }
+
+    OptimalImage OptimalImage::adaptiveThreshold(int maxValue, AdaptiveMethod method, ThresholdType type, int blockSize, double C) const
+    {
+        checkSingleChannel(*this, "adaptive threshold");
+        checkMaxValue(maxValue);
+
+        if (type != ThresholdType::Binary && type != ThresholdType::BinaryInv)
+        {
+            throw InvalidArgumentException("Adaptive threshold only supports Binary and BinaryInv types");
+        }
+
+        OptimalImage mean = adaptiveMean(*this, method, blockSize);
+        bool inverse = type == ThresholdType::BinaryInv;
+        int bias = adaptiveBias(C, inverse);
+        unsigned char onValue = inverse ? 0 : static_cast<unsigned char>(maxValue);
+        unsigned char offValue = inverse ? static_cast<unsigned char>(maxValue) : 0;
+
+        OptimalImage result(width_, height_, 1);
+        unsigned char *dstData = result.data();
+        size_t dstStep = result.step();
+        int pixelCount = width_ * height_;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+        for (int y = 0; y < height_; ++y)
+        {
+            adaptiveRow(data() + y * step_, mean.data() + y * mean.step(), dstData + y * dstStep, width_,
+                        bias, onValue, offValue);
+        }
+
+        return result;
+    }
+
+    PackedMask OptimalImage::adaptiveThresholdPacked(AdaptiveMethod method, int blockSize, double C, bool invert) const
+    {
+        checkSingleChannel(*this, "adaptive threshold");
+
+        OptimalImage mean = adaptiveMean(*this, method, blockSize);
+        int bias = adaptiveBias(C, invert);
+        unsigned char onValue = invert ? 0 : 255;
+        unsigned char offValue = invert ? 255 : 0;
+
+        PackedMask mask(width_, height_);
+        int pixelCount = width_ * height_;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height_) : 1;
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<unsigned char> bytes(width_);
+            int yEnd = detail::stripeBegin(height_, stripes, s + 1);
+            for (int y = detail::stripeBegin(height_, stripes, s); y < yEnd; ++y)
+            {
+                adaptiveRow(data() + y * step_, mean.data() + y * mean.step(), bytes.data(), width_,
+                            bias, onValue, offValue);
+                packRow(bytes.data(), mask.row(y), width_);
+            }
+        }
+
+        return mask;
+    }
+
+} // namespace mylib
@@ -0,0 +1,421 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <cstring>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 转置分块的边长（像素），源块和目标块都能放进L1缓存
+        constexpr int TRANSPOSE_BLOCK = 32;
+
+#ifdef USE_SIMD
+#if defined(__SSE2__)
+        /**
+         * @brief 寄存器内转置16x16字节块
+         * 对第i和i + 8个寄存器做unpacklo/hi_epi8，寄存器号与字节号拼成的8位下标每次循环左移一位，重复4次即完成转置
+         * @param srcRows 16个源行指针，第k行成为输出的第k个元素
+         * @param dstRows 16个目标行指针，第j列写入dstRows[j]
+         */
+        inline void transposeTile16x16(const unsigned char *const *srcRows, unsigned char *const *dstRows)
+        {
+            __m128i a[16];
+            __m128i b[16];
+            for (int i = 0; i < 16; ++i)
+            {
+                a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcRows[i]));
+            }
+            for (int stage = 0; stage < 4; ++stage)
+            {
+                for (int i = 0; i < 8; ++i)
+                {
+                    b[2 * i] = _mm_unpacklo_epi8(a[i], a[i + 8]);
+                    b[2 * i + 1] = _mm_unpackhi_epi8(a[i], a[i + 8]);
+                }
+                for (int i = 0; i < 16; ++i)
+                {
+                    a[i] = b[i];
+                }
+            }
+            for (int i = 0; i < 16; ++i)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dstRows[i]), a[i]);
+            }
+        }
+
+        /**
+         * @brief 寄存器内转置4x4个32位元素，原理与transposeTile16x16相同
+         */
+        inline void transpose4x4Epi32(__m128i *a)
+        {
+            for (int stage = 0; stage < 2; ++stage)
+            {
+                __m128i b0 = _mm_unpacklo_epi32(a[0], a[2]);
+                __m128i b1 = _mm_unpackhi_epi32(a[0], a[2]);
+                __m128i b2 = _mm_unpacklo_epi32(a[1], a[3]);
+                __m128i b3 = _mm_unpackhi_epi32(a[1], a[3]);
+                a[0] = b0;
+                a[1] = b1;
+                a[2] = b2;
+                a[3] = b3;
+            }
+        }
+
+        /**
+         * @brief 转置4x4个四通道像素块
+         */
+        inline void transposeTile4x4C4(const unsigned char *const *srcRows, unsigned char *const *dstRows)
+        {
+            __m128i a[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                a[i] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(srcRows[i]));
+            }
+            transpose4x4Epi32(a);
+            for (int i = 0; i < 4; ++i)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dstRows[i]), a[i]);
+            }
+        }
+#endif
+
+#if defined(__SSSE3__)
+        /**
+         * @brief 转置4x4个三通道像素块：先用pshufb扩展为四通道，按32位转置后再压缩回三通道
+         * 每个源行读取16字节（比像素数据多4字节），调用方需保证读取不越界
+         */
+        inline void transposeTile4x4C3(const unsigned char *const *srcRows, unsigned char *const *dstRows)
+        {
+            const __m128i expand = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            const __m128i compact = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+            __m128i a[4];
+            for (int i = 0; i < 4; ++i)
+            {
+                a[i] = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(srcRows[i])), expand);
+            }
+            transpose4x4Epi32(a);
+            for (int i = 0; i < 4; ++i)
+            {
+                __m128i v = _mm_shuffle_epi8(a[i], compact);
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(dstRows[i]), v);
+                int tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+                std::memcpy(dstRows[i] + 8, &tail, 4);
+            }
+        }
+#endif
+#endif
+
+        /**
+         * @brief 转置并可选地翻转结果：源像素(x, y)写到目标的第(flipRows ? W - 1 - x : x)行、
+         * 第(flipCols ? H - 1 - y : y)列。转置、顺时针90度和270度旋转都是它的特例
+         */
+        void transposeFlip(const OptimalImage &src, OptimalImage &dst, bool flipRows, bool flipCols)
+        {
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            size_t srcStep = src.step();
+            size_t dstStep = dst.step();
+            const unsigned char *srcData = src.data();
+            unsigned char *dstData = dst.data();
+
+            auto dstPixel = [&](int x, int y)
+            {
+                int row = flipRows ? width - 1 - x : x;
+                int col = flipCols ? height - 1 - y : y;
+                return dstData + row * dstStep + static_cast<size_t>(col) * cn;
+            };
+
+            int tile = 0;
+#ifdef USE_SIMD
+#if defined(__SSE2__)
+            if (cn == 1)
+            {
+                tile = 16;
+            }
+            else if (cn == 4)
+            {
+                tile = 4;
+            }
+#endif
+#if defined(__SSSE3__)
+            if (cn == 3)
+            {
+                tile = 4;
+            }
+#endif
+#endif
+
+            int blockRows = (height + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+            int blockCols = (width + TRANSPOSE_BLOCK - 1) / TRANSPOSE_BLOCK;
+            int blockCount = blockRows * blockCols;
+            int pixelCount = width * height;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int b = 0; b < blockCount; ++b)
+            {
+                int y0 = (b / blockCols) * TRANSPOSE_BLOCK;
+                int x0 = (b % blockCols) * TRANSPOSE_BLOCK;
+                int y1 = std::min(y0 + TRANSPOSE_BLOCK, height);
+                int x1 = std::min(x0 + TRANSPOSE_BLOCK, width);
+
+                // 整块的部分用寄存器内转置，剩余的边角逐像素处理
+                int yEnd = y0;
+                int xEnd = x0;
+#ifdef USE_SIMD
+#if defined(__SSE2__)
+                if (tile > 0)
+                {
+                    yEnd = y0 + (y1 - y0) / tile * tile;
+                    xEnd = x0 + (x1 - x0) / tile * tile;
+                    const unsigned char *srcRows[16];
+                    unsigned char *dstRows[16];
+                    for (int ty = y0; ty < yEnd; ty += tile)
+                    {
+                        for (int tx = x0; tx < xEnd; tx += tile)
+                        {
+                            for (int k = 0; k < tile; ++k)
+                            {
+                                int y = flipCols ? ty + tile - 1 - k : ty + k;
+                                srcRows[k] = srcData + y * srcStep + static_cast<size_t>(tx) * cn;
+                                dstRows[k] = dstPixel(tx + k, flipCols ? ty + tile - 1 : ty);
+                            }
+
+                            if (cn == 1)
+                            {
+                                transposeTile16x16(srcRows, dstRows);
+                            }
+                            else if (cn == 4)
+                            {
+                                transposeTile4x4C4(srcRows, dstRows);
+                            }
+#if defined(__SSSE3__)
+                            else if (tx + 6 <= width)
+                            {
+                                transposeTile4x4C3(srcRows, dstRows);
+                            }
+#endif
+                            else
+                            {
+                                for (int y = ty; y < ty + tile; ++y)
+                                {
+                                    for (int x = tx; x < tx + tile; ++x)
+                                    {
+                                        std::memcpy(dstPixel(x, y), srcData + y * srcStep + static_cast<size_t>(x) * cn, cn);
+                                    }
+                                }
+                            }
+                        }
+                    }
+                }
+#endif
+#endif
+
+                for (int y = y0; y < y1; ++y)
+                {
+                    const unsigned char *srcRow = srcData + y * srcStep;
+                    int xStart = y < yEnd ? xEnd : x0;
+                    if (cn == 1)
+                    {
+                        for (int x = xStart; x < x1; ++x)
+                        {
+                            *dstPixel(x, y) = srcRow[x];
+                        }
+                    }
+                    else
+                    {
+                        for (int x = xStart; x < x1; ++x)
+                        {
+                            std::memcpy(dstPixel(x, y), srcRow + static_cast<size_t>(x) * cn, cn);
+                        }
+                    }
+                }
+            }
+        }
+
+        /**
+         * @brief 按像素逆序复制一行：dst[x] = src[width - 1 - x]
+         */
+        void reverseRow(const unsigned char *src, unsigned char *dst, int width, int cn)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+            if (cn == 1)
+            {
+#if defined(__AVX2__)
+                const __m256i reverse = _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+                                                         15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+                for (; x <= width - 32; x += 32)
+                {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x));
+                    v = _mm256_shuffle_epi8(v, reverse);
+                    v = _mm256_permute2x128_si256(v, v, 0x01);
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + width - x - 32), v);
+                }
+#elif defined(__SSSE3__)
+                const __m128i reverse = _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+                for (; x <= width - 16; x += 16)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + width - x - 16), _mm_shuffle_epi8(v, reverse));
+                }
+#endif
+            }
+            else if (cn == 3)
+            {
+#if defined(__SSSE3__)
+                // 每次读16字节、逆序5个像素，写回时多出的1字节放在目标块前面，
+                // 它属于下一次迭代才写入的像素，会被正确的值覆盖
+                const __m128i reverse = _mm_setr_epi8(-1, 12, 13, 14, 9, 10, 11, 6, 7, 8, 3, 4, 5, 0, 1, 2);
+                for (; x + 6 <= width; x += 5)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 3));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (width - x - 5) * 3 - 1), _mm_shuffle_epi8(v, reverse));
+                }
+#endif
+            }
+            else if (cn == 4)
+            {
+#if defined(__AVX2__)
+                const __m256i reverse = _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0);
+                for (; x <= width - 8; x += 8)
+                {
+                    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + x * 4));
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + (width - x - 8) * 4), _mm256_permutevar8x32_epi32(v, reverse));
+                }
+#elif defined(__SSE2__)
+                for (; x <= width - 4; x += 4)
+                {
+                    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + x * 4));
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + (width - x - 4) * 4), _mm_shuffle_epi32(v, 0x1B));
+                }
+#endif
+            }
+#endif
+            for (; x < width; ++x)
+            {
+                std::memcpy(dst + static_cast<size_t>(width - 1 - x) * cn, src + static_cast<size_t>(x) * cn, cn);
+            }
+        }
+
+        /**
+         * @brief 逐行翻转/复制：目标第y行来自源的第(flipVertical ? H - 1 - y : y)行，flipHorizontal时行内逆序
+         */
+        void flipImage(const OptimalImage &src, OptimalImage &dst, bool flipHorizontal, bool flipVertical)
+        {
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            int pixelCount = width * height;
+
+#pragma omp parallel for if (pixelCount > OPTIMIZATION_THRESHOLD)
+            for (int y = 0; y < height; ++y)
+            {
+                const unsigned char *srcRow = src.data() + (flipVertical ? height - 1 - y : y) * src.step();
+                unsigned char *dstRow = dst.data() + y * dst.step();
+                if (flipHorizontal)
+                {
+                    reverseRow(srcRow, dstRow, width, cn);
+                }
+                else
+                {
+                    std::memcpy(dstRow, srcRow, static_cast<size_t>(width) * cn);
+                }
+            }
+        }
+    } // namespace
+
+    void detail::transposeImage(const OptimalImage &src, OptimalImage &dst)
+    {
+        transposeFlip(src, dst, false, false);
+    }
+
+    OptimalImage OptimalImage::transpose() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot transpose an empty image");
+        }
+
+        OptimalImage result(height_, width_, channels_);
+        transposeFlip(*this, result, false, false);
+        return result;
+    }
+
+    OptimalImage OptimalImage::rotate90() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot rotate an empty image");
+        }
+
+        // 顺时针90度：源(x, y)到目标(H - 1 - y, x)
+        OptimalImage result(height_, width_, channels_);
+        transposeFlip(*this, result, false, true);
+        return result;
+    }
+
+    OptimalImage OptimalImage::rotate180() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot rotate an empty image");
+        }
+
+        OptimalImage result(width_, height_, channels_);
+        flipImage(*this, result, true, true);
+        return result;
+    }
+
+    OptimalImage OptimalImage::rotate270() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot rotate an empty image");
+        }
+
+        // 顺时针270度：源(x, y)到目标(y, W - 1 - x)
+        OptimalImage result(height_, width_, channels_);
+        transposeFlip(*this, result, true, false);
+        return result;
+    }
+
+    OptimalImage OptimalImage::flipH() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot flip an empty image");
+        }
+
+        OptimalImage result(width_, height_, channels_);
+        flipImage(*this, result, true, false);
+        return result;
+    }
+
+    OptimalImage OptimalImage::flipV() const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot flip an empty image");
+        }
+
+        OptimalImage result(width_, height_, channels_);
+        flipImage(*this, result, false, true);
+        return result;
+    }
+
+} // namespace mylib
@@ -0,0 +1,485 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <sstream>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // 源坐标的小数位数：双线性插值的权重为(32 - f)和f，两维相乘后总和为1024
+        constexpr int WARP_BITS = 5;
+        constexpr int WARP_ONE = 1 << WARP_BITS;
+        constexpr int WARP_MASK = WARP_ONE - 1;
+
+        // 仿射变换按列累加时使用的中间精度
+        constexpr int AFFINE_BITS = 10;
+
+        // 定点坐标的取值范围，保证后续运算不溢出；超出范围的点一定落在图像之外
+        constexpr double WARP_COORD_LIMIT = static_cast<double>(1 << 20);
+
+        // 输出分块：同一块内的目标像素在源图像中也相互靠近
+        constexpr int WARP_TILE_WIDTH = 128;
+        constexpr int WARP_TILE_HEIGHT = 32;
+
+        inline int32_t toFixed(double v)
+        {
+            if (!(v > -WARP_COORD_LIMIT))
+            {
+                v = -WARP_COORD_LIMIT;
+            }
+            else if (v > WARP_COORD_LIMIT)
+            {
+                v = WARP_COORD_LIMIT;
+            }
+            return static_cast<int32_t>(std::lrint(v * WARP_ONE));
+        }
+
+        /**
+         * @brief 采样一个像素，超出源图像的采样点按0处理
+         */
+        inline void samplePixel(const OptimalImage &src, int32_t fx, int32_t fy, bool bilinear, unsigned char *dst)
+        {
+            int width = src.width();
+            int height = src.height();
+            int cn = src.channels();
+            size_t step = src.step();
+            const unsigned char *data = src.data();
+
+            if (!bilinear)
+            {
+                int x = (fx + WARP_ONE / 2) >> WARP_BITS;
+                int y = (fy + WARP_ONE / 2) >> WARP_BITS;
+                if (x >= 0 && y >= 0 && x < width && y < height)
+                {
+                    std::memcpy(dst, data + y * step + static_cast<size_t>(x) * cn, cn);
+                }
+                else
+                {
+                    std::memset(dst, 0, cn);
+                }
+                return;
+            }
+
+            int x = fx >> WARP_BITS;
+            int y = fy >> WARP_BITS;
+            int ax = fx & WARP_MASK;
+            int ay = fy & WARP_MASK;
+
+            const unsigned char *rows[2] = {nullptr, nullptr};
+            int cols[2] = {-1, -1};
+            for (int k = 0; k < 2; ++k)
+            {
+                if (y + k >= 0 && y + k < height)
+                {
+                    rows[k] = data + (y + k) * step;
+                }
+                if (x + k >= 0 && x + k < width)
+                {
+                    cols[k] = (x + k) * cn;
+                }
+            }
+
+            for (int c = 0; c < cn; ++c)
+            {
+                int tap[2][2];
+                for (int j = 0; j < 2; ++j)
+                {
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        tap[j][i] = (rows[j] && cols[i] >= 0) ? rows[j][cols[i] + c] : 0;
+                    }
+                }
+                int top = tap[0][0] * (WARP_ONE - ax) + tap[0][1] * ax;
+                int bottom = tap[1][0] * (WARP_ONE - ax) + tap[1][1] * ax;
+                dst[c] = static_cast<unsigned char>((top * (WARP_ONE - ay) + bottom * ay + (1 << (2 * WARP_BITS - 1))) >> (2 * WARP_BITS));
+            }
+        }
+
+        /**
+         * @brief 按定点坐标采样一段连续的目标像素
+         * AVX2下单通道和四通道每次处理8个像素：整组都落在图像内部时用gather读取，否则逐像素处理
+         */
+        void sampleSpan(const OptimalImage &src, const int32_t *xs, const int32_t *ys, int n, bool bilinear, unsigned char *dst)
+        {
+            int cn = src.channels();
+            int i = 0;
+
+#ifdef USE_SIMD
+#if defined(__AVX2__)
+            if (cn == 1 || cn == 4)
+            {
+                int width = src.width();
+                int height = src.height();
+                int step = static_cast<int>(src.step());
+                const int *base = reinterpret_cast<const int *>(src.data());
+                const int *nextRow = reinterpret_cast<const int *>(src.data() + step);
+
+                // gather每次读4字节：单通道时要求读取不越过行尾（最后一行没有下一行可借用）
+                int xLimit = bilinear ? width - 2 : width - 1;
+                if (cn == 1)
+                {
+                    xLimit = std::min(xLimit, step - 4);
+                }
+                int yLimit = bilinear ? height - 2 : height - 1;
+
+                __m256i vStep = _mm256_set1_epi32(step);
+                __m256i vXLimit = _mm256_set1_epi32(xLimit + 1);
+                __m256i vYLimit = _mm256_set1_epi32(yLimit + 1);
+                __m256i vMinusOne = _mm256_set1_epi32(-1);
+                __m256i vMask = _mm256_set1_epi32(WARP_MASK);
+                __m256i vOne = _mm256_set1_epi32(WARP_ONE);
+                __m256i vHalf = _mm256_set1_epi32(WARP_ONE / 2);
+                __m256i vRound = _mm256_set1_epi32(1 << (2 * WARP_BITS - 1));
+                __m256i vCompact = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+                const __m256i spread = _mm256_setr_epi8(0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1,
+                                                        0, -1, 1, -1, 4, -1, 5, -1, 8, -1, 9, -1, 12, -1, 13, -1);
+
+                for (; i <= n - 8; i += 8)
+                {
+                    __m256i fx = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(xs + i));
+                    __m256i fy = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(ys + i));
+                    if (!bilinear)
+                    {
+                        fx = _mm256_add_epi32(fx, vHalf);
+                        fy = _mm256_add_epi32(fy, vHalf);
+                    }
+                    __m256i x = _mm256_srai_epi32(fx, WARP_BITS);
+                    __m256i y = _mm256_srai_epi32(fy, WARP_BITS);
+
+                    __m256i inside = _mm256_and_si256(
+                        _mm256_and_si256(_mm256_cmpgt_epi32(x, vMinusOne), _mm256_cmpgt_epi32(vXLimit, x)),
+                        _mm256_and_si256(_mm256_cmpgt_epi32(y, vMinusOne), _mm256_cmpgt_epi32(vYLimit, y)));
+                    if (_mm256_movemask_epi8(inside) != -1)
+                    {
+                        for (int k = i; k < i + 8; ++k)
+                        {
+                            samplePixel(src, xs[k], ys[k], bilinear, dst + static_cast<size_t>(k) * cn);
+                        }
+                        continue;
+                    }
+
+                    __m256i offset = _mm256_add_epi32(_mm256_mullo_epi32(y, vStep), cn == 1 ? x : _mm256_slli_epi32(x, 2));
+
+                    if (!bilinear)
+                    {
+                        __m256i p = _mm256_i32gather_epi32(base, offset, 1);
+                        if (cn == 4)
+                        {
+                            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), p);
+                        }
+                        else
+                        {
+                            p = _mm256_and_si256(p, _mm256_set1_epi32(0xFF));
+                            p = _mm256_packus_epi32(p, p);
+                            p = _mm256_packus_epi16(p, p);
+                            p = _mm256_permutevar8x32_epi32(p, vCompact);
+                            _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(p));
+                        }
+                        continue;
+                    }
+
+                    __m256i ax = _mm256_and_si256(fx, vMask);
+                    __m256i ay = _mm256_and_si256(fy, vMask);
+                    __m256i wy = _mm256_or_si256(_mm256_sub_epi32(vOne, ay), _mm256_slli_epi32(ay, 16));
+
+                    if (cn == 1)
+                    {
+                        // 一次gather读到同一行相邻的两个像素，展开为16位后用madd完成水平插值
+                        __m256i wx = _mm256_or_si256(_mm256_sub_epi32(vOne, ax), _mm256_slli_epi32(ax, 16));
+                        __m256i p0 = _mm256_shuffle_epi8(_mm256_i32gather_epi32(base, offset, 1), spread);
+                        __m256i p1 = _mm256_shuffle_epi8(_mm256_i32gather_epi32(nextRow, offset, 1), spread);
+                        __m256i top = _mm256_madd_epi16(p0, wx);
+                        __m256i bottom = _mm256_madd_epi16(p1, wx);
+                        __m256i r = _mm256_madd_epi16(_mm256_or_si256(top, _mm256_slli_epi32(bottom, 16)), wy);
+                        r = _mm256_srli_epi32(_mm256_add_epi32(r, vRound), 2 * WARP_BITS);
+                        r = _mm256_packus_epi32(r, r);
+                        r = _mm256_packus_epi16(r, r);
+                        r = _mm256_permutevar8x32_epi32(r, vCompact);
+                        _mm_storel_epi64(reinterpret_cast<__m128i *>(dst + i), _mm256_castsi256_si128(r));
+                    }
+                    else
+                    {
+                        // 四通道：字节交错后用maddubs做水平插值，再按像素广播垂直权重用madd做垂直插值
+                        __m256i offsetRight = _mm256_add_epi32(offset, _mm256_set1_epi32(4));
+                        __m256i p00 = _mm256_i32gather_epi32(base, offset, 1);
+                        __m256i p01 = _mm256_i32gather_epi32(base, offsetRight, 1);
+                        __m256i p10 = _mm256_i32gather_epi32(nextRow, offset, 1);
+                        __m256i p11 = _mm256_i32gather_epi32(nextRow, offsetRight, 1);
+
+                        __m256i wxPair = _mm256_or_si256(_mm256_sub_epi32(vOne, ax), _mm256_slli_epi32(ax, 8));
+                        wxPair = _mm256_or_si256(wxPair, _mm256_slli_epi32(wxPair, 16));
+                        __m256i wxLo = _mm256_unpacklo_epi32(wxPair, wxPair);
+                        __m256i wxHi = _mm256_unpackhi_epi32(wxPair, wxPair);
+
+                        __m256i topLo = _mm256_maddubs_epi16(_mm256_unpacklo_epi8(p00, p01), wxLo);
+                        __m256i topHi = _mm256_maddubs_epi16(_mm256_unpackhi_epi8(p00, p01), wxHi);
+                        __m256i bottomLo = _mm256_maddubs_epi16(_mm256_unpacklo_epi8(p10, p11), wxLo);
+                        __m256i bottomHi = _mm256_maddubs_epi16(_mm256_unpackhi_epi8(p10, p11), wxHi);
+
+                        __m256i r0 = _mm256_madd_epi16(_mm256_unpacklo_epi16(topLo, bottomLo), _mm256_shuffle_epi32(wy, 0x00));
+                        __m256i r1 = _mm256_madd_epi16(_mm256_unpackhi_epi16(topLo, bottomLo), _mm256_shuffle_epi32(wy, 0x55));
+                        __m256i r2 = _mm256_madd_epi16(_mm256_unpacklo_epi16(topHi, bottomHi), _mm256_shuffle_epi32(wy, 0xAA));
+                        __m256i r3 = _mm256_madd_epi16(_mm256_unpackhi_epi16(topHi, bottomHi), _mm256_shuffle_epi32(wy, 0xFF));
+                        r0 = _mm256_srli_epi32(_mm256_add_epi32(r0, vRound), 2 * WARP_BITS);
+                        r1 = _mm256_srli_epi32(_mm256_add_epi32(r1, vRound), 2 * WARP_BITS);
+                        r2 = _mm256_srli_epi32(_mm256_add_epi32(r2, vRound), 2 * WARP_BITS);
+                        r3 = _mm256_srli_epi32(_mm256_add_epi32(r3, vRound), 2 * WARP_BITS);
+
+                        __m256i r = _mm256_packus_epi16(_mm256_packus_epi32(r0, r1), _mm256_packus_epi32(r2, r3));
+                        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i * 4), r);
+                    }
+                }
+            }
+#endif
+#endif
+            for (; i < n; ++i)
+            {
+                samplePixel(src, xs[i], ys[i], bilinear, dst + static_cast<size_t>(i) * cn);
+            }
+        }
+
+        bool checkInterpolation(Interpolation interpolation)
+        {
+            if (interpolation != Interpolation::Nearest && interpolation != Interpolation::Bilinear)
+            {
+                throw InvalidArgumentException("Only nearest and bilinear interpolation are supported for warping");
+            }
+            return interpolation == Interpolation::Bilinear;
+        }
+
+        void checkWarpArguments(const OptimalImage &img, const std::vector<double> &matrix, size_t expected,
+                                int dstWidth, int dstHeight, const char *operation)
+        {
+            if (img.empty())
+            {
+                std::stringstream ss;
+                ss << "Cannot apply " << operation << " to an empty image";
+                throw OperationFailedException(ss.str());
+            }
+
+            if (matrix.size() != expected)
+            {
+                std::stringstream ss;
+                ss << operation << " matrix must have " << expected << " elements, but got " << matrix.size();
+                throw InvalidArgumentException(ss.str());
+            }
+
+            if (dstWidth <= 0 || dstHeight <= 0)
+            {
+                std::stringstream ss;
+                ss << "Invalid output size for " << operation << ": " << dstWidth << "x" << dstHeight;
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        /**
+         * @brief 按块遍历目标图像：每块的每一行先由coordFn生成定点源坐标，再整段采样
+         * @param coordFn 签名为void(int x0, int y, int n, int32_t *xs, int32_t *ys)
+         */
+        template <typename CoordFn>
+        void warpTiled(const OptimalImage &src, OptimalImage &dst, bool bilinear, CoordFn coordFn)
+        {
+            int width = dst.width();
+            int height = dst.height();
+            int cn = dst.channels();
+            int tilesX = (width + WARP_TILE_WIDTH - 1) / WARP_TILE_WIDTH;
+            int tilesY = (height + WARP_TILE_HEIGHT - 1) / WARP_TILE_HEIGHT;
+            int tileCount = tilesX * tilesY;
+            int pixelCount = width * height;
+
+#pragma omp parallel if (pixelCount > OPTIMIZATION_THRESHOLD)
+            {
+                std::vector<int32_t> xs(WARP_TILE_WIDTH);
+                std::vector<int32_t> ys(WARP_TILE_WIDTH);
+
+#pragma omp for
+                for (int t = 0; t < tileCount; ++t)
+                {
+                    int x0 = (t % tilesX) * WARP_TILE_WIDTH;
+                    int y0 = (t / tilesX) * WARP_TILE_HEIGHT;
+                    int n = std::min(WARP_TILE_WIDTH, width - x0);
+                    int y1 = std::min(y0 + WARP_TILE_HEIGHT, height);
+                    for (int y = y0; y < y1; ++y)
+                    {
+                        coordFn(x0, y, n, xs.data(), ys.data());
+                        sampleSpan(src, xs.data(), ys.data(), n, bilinear, dst.data() + y * dst.step() + static_cast<size_t>(x0) * cn);
+                    }
+                }
+            }
+        }
+    } // namespace
+
+    OptimalImage OptimalImage::warpAffine(const std::vector<double> &matrix, int dstWidth, int dstHeight,
+                                          Interpolation interpolation) const
+    {
+        checkWarpArguments(*this, matrix, 6, dstWidth, dstHeight, "affine warp");
+        bool bilinear = checkInterpolation(interpolation);
+
+        // 求逆矩阵，得到目标坐标到源坐标的映射
+        double det = matrix[0] * matrix[4] - matrix[1] * matrix[3];
+        if (std::fabs(det) < 1e-12)
+        {
+            throw InvalidArgumentException("Affine matrix is singular");
+        }
+        double a = matrix[4] / det;
+        double b = -matrix[1] / det;
+        double d = -matrix[3] / det;
+        double e = matrix[0] / det;
+        double c = -(a * matrix[2] + b * matrix[5]);
+        double f = -(d * matrix[2] + e * matrix[5]);
+
+        // 源坐标 = 列项 + 行项：列项每列只算一次，每个像素只需两次整数加法
+        auto toAffineFixed = [](double v)
+        {
+            // 列项与行项各自限制在2^29以内，相加不会溢出
+            constexpr double limit = static_cast<double>(1 << 29);
+            v *= 1 << AFFINE_BITS;
+            v = std::max(-limit, std::min(limit, v));
+            return static_cast<int32_t>(std::lrint(v));
+        };
+        std::vector<int32_t> colX(dstWidth), colY(dstWidth);
+        for (int x = 0; x < dstWidth; ++x)
+        {
+            colX[x] = toAffineFixed(a * x);
+            colY[x] = toAffineFixed(d * x);
+        }
+
+        OptimalImage result(dstWidth, dstHeight, channels_);
+        constexpr int shift = AFFINE_BITS - WARP_BITS;
+        constexpr int round = 1 << (shift - 1);
+        warpTiled(*this, result, bilinear, [&](int x0, int y, int n, int32_t *xs, int32_t *ys)
+                  {
+                      int32_t rowX = toAffineFixed(b * y + c) + round;
+                      int32_t rowY = toAffineFixed(e * y + f) + round;
+                      const int32_t *cx = colX.data() + x0;
+                      const int32_t *cy = colY.data() + x0;
+                      for (int i = 0; i < n; ++i)
+                      {
+                          xs[i] = (cx[i] + rowX) >> shift;
+                          ys[i] = (cy[i] + rowY) >> shift;
+                      } });
+        return result;
+    }
+
+    OptimalImage OptimalImage::warpPerspective(const std::vector<double> &matrix, int dstWidth, int dstHeight,
+                                               Interpolation interpolation) const
+    {
+        checkWarpArguments(*this, matrix, 9, dstWidth, dstHeight, "perspective warp");
+        bool bilinear = checkInterpolation(interpolation);
+
+        // 伴随矩阵求逆
+        const std::vector<double> &m = matrix;
+        double inv[9] = {
+            m[4] * m[8] - m[5] * m[7], m[2] * m[7] - m[1] * m[8], m[1] * m[5] - m[2] * m[4],
+            m[5] * m[6] - m[3] * m[8], m[0] * m[8] - m[2] * m[6], m[2] * m[3] - m[0] * m[5],
+            m[3] * m[7] - m[4] * m[6], m[1] * m[6] - m[0] * m[7], m[0] * m[4] - m[1] * m[3]};
+        double det = m[0] * inv[0] + m[1] * inv[3] + m[2] * inv[6];
+        if (std::fabs(det) < 1e-12)
+        {
+            throw InvalidArgumentException("Perspective matrix is singular");
+        }
+        for (double &v : inv)
+        {
+            v /= det;
+        }
+
+        OptimalImage result(dstWidth, dstHeight, channels_);
+        warpTiled(*this, result, bilinear, [&](int x0, int y, int n, int32_t *xs, int32_t *ys)
+                  {
+                      // 分子分母都是x的线性函数，沿行增量累加
+                      double X = inv[0] * x0 + inv[1] * y + inv[2];
+                      double Y = inv[3] * x0 + inv[4] * y + inv[5];
+                      double W = inv[6] * x0 + inv[7] * y + inv[8];
+                      for (int i = 0; i < n; ++i)
+                      {
+                          double w = std::fabs(W) > 1e-12 ? 1.0 / W : 0.0;
+                          xs[i] = w != 0.0 ? toFixed(X * w) : toFixed(-WARP_COORD_LIMIT);
+                          ys[i] = w != 0.0 ? toFixed(Y * w) : toFixed(-WARP_COORD_LIMIT);
+                          X += inv[0];
+                          Y += inv[3];
+                          W += inv[6];
+                      } });
+        return result;
+    }
+
+    RemapTable OptimalImage::buildRemapTable(const ImageBuffer<float> &mapX, const ImageBuffer<float> &mapY)
+    {
+        if (mapX.width <= 0 || mapX.height <= 0 || mapX.channels != 1 || mapY.channels != 1 ||
+            mapX.width != mapY.width || mapX.height != mapY.height)
+        {
+            std::stringstream ss;
+            ss << "Remap coordinates must be two single-channel maps of the same size, but got "
+               << mapX.width << "x" << mapX.height << "x" << mapX.channels << " and "
+               << mapY.width << "x" << mapY.height << "x" << mapY.channels;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        RemapTable table;
+        table.width = mapX.width;
+        table.height = mapX.height;
+        size_t total = static_cast<size_t>(table.width) * table.height;
+        table.mapX.resize(total);
+        table.mapY.resize(total);
+        int count = static_cast<int>(total);
+
+#pragma omp parallel for if (count > OPTIMIZATION_THRESHOLD)
+        for (int i = 0; i < count; ++i)
+        {
+            table.mapX[i] = toFixed(mapX.data[i]);
+            table.mapY[i] = toFixed(mapY.data[i]);
+        }
+        return table;
+    }
+
+    OptimalImage OptimalImage::remap(const RemapTable &table, Interpolation interpolation) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot remap an empty image");
+        }
+
+        size_t total = static_cast<size_t>(table.width) * table.height;
+        if (table.width <= 0 || table.height <= 0 || table.mapX.size() != total || table.mapY.size() != total)
+        {
+            throw InvalidArgumentException("Remap table is empty or inconsistent with its size");
+        }
+        bool bilinear = checkInterpolation(interpolation);
+
+        OptimalImage result(table.width, table.height, channels_);
+        warpTiled(*this, result, bilinear, [&](int x0, int y, int n, int32_t *xs, int32_t *ys)
+                  {
+                      size_t offset = static_cast<size_t>(y) * table.width + x0;
+                      std::memcpy(xs, table.mapX.data() + offset, n * sizeof(int32_t));
+                      std::memcpy(ys, table.mapY.data() + offset, n * sizeof(int32_t)); });
+        return result;
+    }
+
+    OptimalImage OptimalImage::remap(const ImageBuffer<float> &mapX, const ImageBuffer<float> &mapY,
+                                     Interpolation interpolation) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot remap an empty image");
+        }
+        return remap(buildRemapTable(mapX, mapY), interpolation);
+    }
+
+} // namespace mylib
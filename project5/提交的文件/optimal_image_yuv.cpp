@@ -0,0 +1,448 @@
+#include "optimal_image.h"
+#include "optimal_image_internal.h"
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <vector>
+
+// OpenMP支持
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// SIMD支持通用处理
+#if defined(OPT_WINDOWS) || defined(OPT_UNIX)
+#define USE_SIMD
+#endif
+
+// 数据量较大时才启用加速策略的阈值
+#define OPTIMIZATION_THRESHOLD 10000
+
+namespace mylib
+{
+    namespace
+    {
+        // BT.601有限范围YUV转RGB的系数，13位定点数：
+        // R = 1.164(Y - 16) + 1.596(V - 128)
+        // G = 1.164(Y - 16) - 0.392(U - 128) - 0.813(V - 128)
+        // B = 1.164(Y - 16) + 2.017(U - 128)
+        constexpr int YUV_SHIFT = 13;
+        constexpr int YUV_CY = 9539;
+        constexpr int YUV_CVR = 13075;
+        constexpr int YUV_CUG = -3209;
+        constexpr int YUV_CVG = -6660;
+        constexpr int YUV_CUB = 16525;
+
+        inline unsigned char yuvClamp(int value)
+        {
+            return static_cast<unsigned char>(std::clamp((value + (1 << (YUV_SHIFT - 1))) >> YUV_SHIFT, 0, 255));
+        }
+
+        /**
+         * @brief 一行YUV转为R、G、B三个平面行，每个色度样本用于相邻两个像素
+         * @param uRow NV12时为U、V交错的色度行，I420时为U行
+         * @param vRow I420时为V行，NV12时不使用
+         */
+        void yuvToRgbRow(const unsigned char *yRow, const unsigned char *uRow, const unsigned char *vRow, bool interleaved,
+                         int width, unsigned char *red, unsigned char *green, unsigned char *blue)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__SSE2__)
+            // 每次16个像素、8个色度样本。色度项对每个样本算一次（madd同时乘U、V两个系数），
+            // 再用unpack_epi32复制到两个像素上与亮度项相加
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i c16 = _mm_set1_epi16(16);
+            const __m128i c128 = _mm_set1_epi16(128);
+            const __m128i lowByte = _mm_set1_epi16(0x00FF);
+            const __m128i half = _mm_set1_epi32(1 << (YUV_SHIFT - 1));
+            const __m128i kY = _mm_setr_epi16(YUV_CY, 0, YUV_CY, 0, YUV_CY, 0, YUV_CY, 0);
+            const __m128i kR = _mm_setr_epi16(0, YUV_CVR, 0, YUV_CVR, 0, YUV_CVR, 0, YUV_CVR);
+            const __m128i kG = _mm_setr_epi16(YUV_CUG, YUV_CVG, YUV_CUG, YUV_CVG, YUV_CUG, YUV_CVG, YUV_CUG, YUV_CVG);
+            const __m128i kB = _mm_setr_epi16(YUV_CUB, 0, YUV_CUB, 0, YUV_CUB, 0, YUV_CUB, 0);
+            for (; x + 16 <= width; x += 16)
+            {
+                __m128i u, v;
+                if (interleaved)
+                {
+                    __m128i uv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(uRow + x));
+                    u = _mm_and_si128(uv, lowByte);
+                    v = _mm_srli_epi16(uv, 8);
+                }
+                else
+                {
+                    u = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(uRow + x / 2)), zero);
+                    v = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(vRow + x / 2)), zero);
+                }
+                __m128i uvLo = _mm_unpacklo_epi16(_mm_sub_epi16(u, c128), _mm_sub_epi16(v, c128));
+                __m128i uvHi = _mm_unpackhi_epi16(_mm_sub_epi16(u, c128), _mm_sub_epi16(v, c128));
+
+                __m128i yv = _mm_loadu_si128(reinterpret_cast<const __m128i *>(yRow + x));
+                __m128i yLo = _mm_max_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(yv, zero), c16), zero);
+                __m128i yHi = _mm_max_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(yv, zero), c16), zero);
+                __m128i luma[4] = {
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(yLo, zero), kY), half),
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(yLo, zero), kY), half),
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(yHi, zero), kY), half),
+                    _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(yHi, zero), kY), half)};
+
+                auto channel = [&](__m128i k)
+                {
+                    __m128i lo = _mm_madd_epi16(uvLo, k);
+                    __m128i hi = _mm_madd_epi16(uvHi, k);
+                    __m128i p0 = _mm_srai_epi32(_mm_add_epi32(luma[0], _mm_unpacklo_epi32(lo, lo)), YUV_SHIFT);
+                    __m128i p1 = _mm_srai_epi32(_mm_add_epi32(luma[1], _mm_unpackhi_epi32(lo, lo)), YUV_SHIFT);
+                    __m128i p2 = _mm_srai_epi32(_mm_add_epi32(luma[2], _mm_unpacklo_epi32(hi, hi)), YUV_SHIFT);
+                    __m128i p3 = _mm_srai_epi32(_mm_add_epi32(luma[3], _mm_unpackhi_epi32(hi, hi)), YUV_SHIFT);
+                    return _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3));
+                };
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(red + x), channel(kR));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(green + x), channel(kG));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(blue + x), channel(kB));
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                int c = x / 2;
+                int u = (interleaved ? uRow[c * 2] : uRow[c]) - 128;
+                int v = (interleaved ? uRow[c * 2 + 1] : vRow[c]) - 128;
+                int luma = std::max(yRow[x] - 16, 0) * YUV_CY;
+                red[x] = yuvClamp(luma + YUV_CVR * v);
+                green[x] = yuvClamp(luma + YUV_CUG * u + YUV_CVG * v);
+                blue[x] = yuvClamp(luma + YUV_CUB * u);
+            }
+        }
+
+        /**
+         * @brief R、G、B平面行计算亮度：Y = ((66R + 129G + 25B + 128) >> 8) + 16
+         */
+        void rgbToLumaRow(const unsigned char *red, const unsigned char *green, const unsigned char *blue, int width, unsigned char *dst)
+        {
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__SSE2__)
+            // 加权和最大为56228，按无符号16位计算不会溢出
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i kR = _mm_set1_epi16(66);
+            const __m128i kG = _mm_set1_epi16(129);
+            const __m128i kB = _mm_set1_epi16(25);
+            const __m128i c128 = _mm_set1_epi16(128);
+            const __m128i c16 = _mm_set1_epi16(16);
+            auto luma = [&](__m128i r, __m128i g, __m128i b)
+            {
+                __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, kR), _mm_mullo_epi16(g, kG)),
+                                            _mm_add_epi16(_mm_mullo_epi16(b, kB), c128));
+                return _mm_add_epi16(_mm_srli_epi16(sum, 8), c16);
+            };
+            for (; x + 16 <= width; x += 16)
+            {
+                __m128i r = _mm_loadu_si128(reinterpret_cast<const __m128i *>(red + x));
+                __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i *>(green + x));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(blue + x));
+                __m128i lo = luma(_mm_unpacklo_epi8(r, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(b, zero));
+                __m128i hi = luma(_mm_unpackhi_epi8(r, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(b, zero));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + x), _mm_packus_epi16(lo, hi));
+            }
+#endif
+#endif
+            for (; x < width; ++x)
+            {
+                dst[x] = static_cast<unsigned char>(((66 * red[x] + 129 * green[x] + 25 * blue[x] + 128) >> 8) + 16);
+            }
+        }
+
+        /**
+         * @brief 两行R、G、B平面计算一行色度，每个样本取2x2像素的平均（宽度为奇数时最后一列与自身配对）：
+         * U = ((-38R - 74G + 112B + 128) >> 8) + 128，V = ((112R - 94G - 18B + 128) >> 8) + 128
+         * @param rows 第一行的R、G、B和第二行的R、G、B，共6个平面行
+         */
+        void rgbToChromaRow(const unsigned char *const *rows, int width, bool interleaved, unsigned char *uRow, unsigned char *vRow)
+        {
+            const unsigned char *r0 = rows[0];
+            const unsigned char *g0 = rows[1];
+            const unsigned char *b0 = rows[2];
+            const unsigned char *r1 = rows[3];
+            const unsigned char *g1 = rows[4];
+            const unsigned char *b1 = rows[5];
+            int x = 0;
+#ifdef USE_SIMD
+#if defined(__SSE2__)
+            // 中间结果都在int16范围内：-38R - 74G最小为-28305，112R - 94G - 18B最小为-28560
+            const __m128i lowByte = _mm_set1_epi16(0x00FF);
+            const __m128i two = _mm_set1_epi16(2);
+            const __m128i c128 = _mm_set1_epi16(128);
+            auto average = [&](const unsigned char *a, const unsigned char *b)
+            {
+                __m128i va = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a));
+                __m128i vb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b));
+                __m128i even = _mm_add_epi16(_mm_and_si128(va, lowByte), _mm_and_si128(vb, lowByte));
+                __m128i odd = _mm_add_epi16(_mm_srli_epi16(va, 8), _mm_srli_epi16(vb, 8));
+                return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(even, odd), two), 2);
+            };
+            auto chroma = [&](__m128i r, __m128i g, __m128i b, int kr, int kg, int kb)
+            {
+                __m128i sum = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(static_cast<short>(kr))),
+                                                          _mm_mullo_epi16(g, _mm_set1_epi16(static_cast<short>(kg)))),
+                                            _mm_add_epi16(_mm_mullo_epi16(b, _mm_set1_epi16(static_cast<short>(kb))), c128));
+                __m128i value = _mm_add_epi16(_mm_srai_epi16(sum, 8), c128);
+                return _mm_packus_epi16(value, value);
+            };
+            for (; x + 16 <= width; x += 16)
+            {
+                __m128i r = average(r0 + x, r1 + x);
+                __m128i g = average(g0 + x, g1 + x);
+                __m128i b = average(b0 + x, b1 + x);
+                __m128i u = chroma(r, g, b, -38, -74, 112);
+                __m128i v = chroma(r, g, b, 112, -94, -18);
+                if (interleaved)
+                {
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(uRow + x), _mm_unpacklo_epi8(u, v));
+                }
+                else
+                {
+                    _mm_storel_epi64(reinterpret_cast<__m128i *>(uRow + x / 2), u);
+                    _mm_storel_epi64(reinterpret_cast<__m128i *>(vRow + x / 2), v);
+                }
+            }
+#endif
+#endif
+            for (; x < width; x += 2)
+            {
+                int xr = std::min(x + 1, width - 1);
+                int r = (r0[x] + r0[xr] + r1[x] + r1[xr] + 2) >> 2;
+                int g = (g0[x] + g0[xr] + g1[x] + g1[xr] + 2) >> 2;
+                int b = (b0[x] + b0[xr] + b1[x] + b1[xr] + 2) >> 2;
+                auto u = static_cast<unsigned char>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                auto v = static_cast<unsigned char>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+                if (interleaved)
+                {
+                    uRow[x] = u;
+                    uRow[x + 1] = v;
+                }
+                else
+                {
+                    uRow[x / 2] = u;
+                    vRow[x / 2] = v;
+                }
+            }
+        }
+
+        /**
+         * @brief 检查YUV图像的平面是否与格式一致
+         */
+        void checkYUV(const YUVImage &yuv)
+        {
+            if (yuv.y.empty() || yuv.y.channels() != 1)
+            {
+                throw InvalidArgumentException("YUV image must have a non-empty single-channel Y plane");
+            }
+
+            int cw = (yuv.width() + 1) / 2;
+            int ch = (yuv.height() + 1) / 2;
+            bool valid;
+            if (yuv.format == YUVFormat::NV12)
+            {
+                valid = yuv.u.width() == cw && yuv.u.height() == ch && yuv.u.channels() == 2;
+            }
+            else
+            {
+                valid = yuv.u.width() == cw && yuv.u.height() == ch && yuv.u.channels() == 1 &&
+                        yuv.v.width() == cw && yuv.v.height() == ch && yuv.v.channels() == 1;
+            }
+            if (!valid)
+            {
+                std::stringstream ss;
+                ss << "Chroma planes do not match a " << yuv.width() << "x" << yuv.height() << " "
+                   << (yuv.format == YUVFormat::NV12 ? "NV12" : "I420") << " image";
+                throw InvalidArgumentException(ss.str());
+            }
+        }
+
+        /**
+         * @brief 按格式创建各平面（不初始化数据）
+         */
+        YUVImage createYUV(int width, int height, YUVFormat format)
+        {
+            YUVImage yuv;
+            yuv.format = format;
+            yuv.y = OptimalImage(width, height, 1);
+            int cw = (width + 1) / 2;
+            int ch = (height + 1) / 2;
+            if (format == YUVFormat::NV12)
+            {
+                yuv.u = OptimalImage(cw, ch, 2);
+            }
+            else
+            {
+                yuv.u = OptimalImage(cw, ch, 1);
+                yuv.v = OptimalImage(cw, ch, 1);
+            }
+            return yuv;
+        }
+
+        /**
+         * @brief 在平面和紧密排列的缓冲区之间逐行复制
+         */
+        void copyPlane(OptimalImage &plane, const unsigned char *src)
+        {
+            size_t rowBytes = static_cast<size_t>(plane.width()) * plane.channels();
+            for (int y = 0; y < plane.height(); ++y)
+            {
+                std::memcpy(plane.data() + y * plane.step(), src + y * rowBytes, rowBytes);
+            }
+        }
+
+        void copyPlane(const OptimalImage &plane, unsigned char *dst)
+        {
+            size_t rowBytes = static_cast<size_t>(plane.width()) * plane.channels();
+            for (int y = 0; y < plane.height(); ++y)
+            {
+                std::memcpy(dst + y * rowBytes, plane.data() + y * plane.step(), rowBytes);
+            }
+        }
+    } // namespace
+
+    YUVImage OptimalImage::toYUV420(YUVFormat format) const
+    {
+        if (empty())
+        {
+            throw OperationFailedException("Cannot convert an empty image to YUV");
+        }
+
+        if (channels_ != 3 && channels_ != 4)
+        {
+            std::stringstream ss;
+            ss << "YUV conversion requires an RGB or RGBA image, but got " << channels_ << " channels";
+            throw InvalidArgumentException(ss.str());
+        }
+
+        YUVImage yuv = createYUV(width_, height_, format);
+        bool interleaved = format == YUVFormat::NV12;
+        int chromaHeight = yuv.u.height();
+        int pixelCount = width_ * height_;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(chromaHeight) : 1;
+
+        // 每次处理一个色度行对应的两行像素：先拆成平面，再分别计算两行亮度和一行色度
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<unsigned char> buffer(static_cast<size_t>(8) * width_);
+            unsigned char *planes[8];
+            for (int k = 0; k < 8; ++k)
+            {
+                planes[k] = buffer.data() + static_cast<size_t>(k) * width_;
+            }
+            // planes[0..3]为第一行的R、G、B、A，planes[4..7]为第二行
+            const unsigned char *chromaRows[6] = {planes[0], planes[1], planes[2], planes[4], planes[5], planes[6]};
+
+            int c0 = detail::stripeBegin(chromaHeight, stripes, s);
+            int c1 = detail::stripeBegin(chromaHeight, stripes, s + 1);
+            for (int cy = c0; cy < c1; ++cy)
+            {
+                int y0 = cy * 2;
+                int y1 = std::min(y0 + 1, height_ - 1);
+                detail::splitRow(data() + y0 * step(), planes, width_, channels_);
+                detail::splitRow(data() + y1 * step(), planes + 4, width_, channels_);
+
+                rgbToLumaRow(planes[0], planes[1], planes[2], width_, yuv.y.data() + y0 * yuv.y.step());
+                if (y1 != y0)
+                {
+                    rgbToLumaRow(planes[4], planes[5], planes[6], width_, yuv.y.data() + y1 * yuv.y.step());
+                }
+                rgbToChromaRow(chromaRows, width_, interleaved, yuv.u.data() + cy * yuv.u.step(),
+                               interleaved ? nullptr : yuv.v.data() + cy * yuv.v.step());
+            }
+        }
+
+        return yuv;
+    }
+
+    OptimalImage OptimalImage::fromYUV420(const YUVImage &yuv)
+    {
+        checkYUV(yuv);
+
+        int width = yuv.width();
+        int height = yuv.height();
+        bool interleaved = yuv.format == YUVFormat::NV12;
+        OptimalImage result(width, height, 3);
+        int pixelCount = width * height;
+        int stripes = pixelCount > OPTIMIZATION_THRESHOLD ? detail::stripeCount(height) : 1;
+
+#pragma omp parallel for if (stripes > 1)
+        for (int s = 0; s < stripes; ++s)
+        {
+            std::vector<unsigned char> buffer(static_cast<size_t>(3) * width);
+            unsigned char *planes[3] = {buffer.data(), buffer.data() + width, buffer.data() + 2 * width};
+            const unsigned char *planeRows[3] = {planes[0], planes[1], planes[2]};
+
+            int y0 = detail::stripeBegin(height, stripes, s);
+            int y1 = detail::stripeBegin(height, stripes, s + 1);
+            for (int y = y0; y < y1; ++y)
+            {
+                int cy = y / 2;
+                yuvToRgbRow(yuv.y.data() + y * yuv.y.step(), yuv.u.data() + cy * yuv.u.step(),
+                            interleaved ? nullptr : yuv.v.data() + cy * yuv.v.step(), interleaved, width,
+                            planes[0], planes[1], planes[2]);
+                detail::mergeRow(planeRows, result.data() + y * result.step(), width, 3);
+            }
+        }
+
+        return result;
+    }
+
+    YUVImage YUVImage::fromBuffer(const unsigned char *data, int width, int height, YUVFormat format)
+    {
+        if (data == nullptr)
+        {
+            throw InvalidArgumentException("YUV buffer is null");
+        }
+
+        if (width <= 0 || height <= 0)
+        {
+            std::stringstream ss;
+            ss << "YUV image size must be positive, but got " << width << "x" << height;
+            throw InvalidArgumentException(ss.str());
+        }
+
+        YUVImage yuv = createYUV(width, height, format);
+        size_t lumaSize = static_cast<size_t>(width) * height;
+        size_t chromaSize = static_cast<size_t>(yuv.u.width()) * yuv.u.height();
+        copyPlane(yuv.y, data);
+        copyPlane(yuv.u, data + lumaSize);
+        if (format == YUVFormat::I420)
+        {
+            copyPlane(yuv.v, data + lumaSize + chromaSize);
+        }
+        return yuv;
+    }
+
+    std::vector<unsigned char> YUVImage::toBuffer() const
+    {
+        checkYUV(*this);
+
+        size_t lumaSize = static_cast<size_t>(width()) * height();
+        size_t chromaSize = static_cast<size_t>(u.width()) * u.height();
+        std::vector<unsigned char> buffer(lumaSize + 2 * chromaSize);
+        copyPlane(y, buffer.data());
+        copyPlane(u, buffer.data() + lumaSize);
+        if (format == YUVFormat::I420)
+        {
+            copyPlane(v, buffer.data() + lumaSize + chromaSize);
+        }
+        return buffer;
+    }
+
+    void YUVImage::adjustBrightness(int delta)
+    {
+        y.adjustBrightness(delta);
+    }
+
+    YUVImage YUVImage::gaussianBlur(int kernelSize, double sigma) const
+    {
+        YUVImage result = *this;
+        result.y = y.gaussianBlur(kernelSize, sigma);
+        return result;
+    }
+
+} // namespace mylib